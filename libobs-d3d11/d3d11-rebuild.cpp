@@ -121,6 +121,13 @@ inline void gs_stage_surface::Rebuild(ID3D11Device *dev)
 	HRESULT hr = dev->CreateTexture2D(&td, nullptr, &texture);
 	if (FAILED(hr))
 		throw HRError("Failed to create staging surface", hr);
+
+	D3D11_QUERY_DESC qd = {D3D11_QUERY_EVENT, 0};
+	hr = dev->CreateQuery(&qd, &query);
+	if (FAILED(hr))
+		throw HRError("Failed to create staging surface query", hr);
+
+	staged = false;
 }
 
 inline void gs_sampler_state::Rebuild(ID3D11Device *dev)
@@ -40,4 +40,15 @@ gs_stage_surface::gs_stage_surface(gs_device_t *device, uint32_t width,
 	hr = device->device->CreateTexture2D(&td, NULL, texture.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to create staging surface", hr);
+
+	D3D11_QUERY_DESC qd = {D3D11_QUERY_EVENT, 0};
+	hr = device->device->CreateQuery(&qd, query.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to create staging surface query", hr);
+}
+
+void gs_stage_surface::Staged()
+{
+	device->context->End(query);
+	staged = true;
 }
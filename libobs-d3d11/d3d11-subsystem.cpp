@@ -1435,6 +1435,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 			      "dimensions";
 
 		device->CopyTex(dst->texture, 0, 0, src, 0, 0, 0, 0);
+		dst->Staged();
 
 	} catch (const char *error) {
 		blog(LOG_ERROR, "device_copy_texture (D3D11): %s", error);
@@ -1461,6 +1462,7 @@ void device_stage_texture_region(gs_device_t *dev, gs_stagesurf_t *dst,
 			throw "Source height is too small for given src_y and destination height";
 
 		dev->CopyTex(dst->texture, 0, 0, src, src_x, src_y, dst->width, dst->height);
+		dst->Staged();
 
 	} catch (const char *error) {
 		blog(LOG_ERROR, "device_stage_texture_region (D3D11): %s", error);
@@ -2068,6 +2070,22 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 	return true;
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf->staged)
+		return true;
+
+	/* the graphics thread flushes every frame, so the query completes
+	 * without a flush here */
+	HRESULT hr = stagesurf->device->context->GetData(stagesurf->query,
+			nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	if (hr == S_FALSE)
+		return false;
+
+	stagesurf->staged = false;
+	return true;
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	stagesurf->device->context->Unmap(stagesurf->texture, 0);
@@ -425,6 +425,10 @@ struct gs_stage_surface : gs_obj {
 	ComPtr<ID3D11Texture2D> texture;
 	D3D11_TEXTURE2D_DESC td = {};
 
+	/* signaled when the last copy to the surface has completed */
+	ComPtr<ID3D11Query>     query;
+	bool                    staged = false;
+
 	uint32_t        width, height;
 	gs_color_format format;
 	DXGI_FORMAT     dxgiFormat;
@@ -434,8 +438,11 @@ struct gs_stage_surface : gs_obj {
 	inline void Release()
 	{
 		texture.Release();
+		query.Release();
 	}
 
+	void Staged();
+
 	gs_stage_surface(gs_device_t *device, uint32_t width, uint32_t height,
 			gs_color_format colorFormat);
 };
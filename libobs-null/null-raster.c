@@ -0,0 +1,859 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include "null-subsystem.h"
+
+/* same value as format_conversion.effect */
+#define PRECISION_OFFSET 0.2f
+
+struct raster_vert {
+	double      x, y;
+	struct vec2 uv;
+	struct vec4 color;
+};
+
+/* pixel shader inputs, looked up once per draw */
+struct ps_context {
+	enum null_pixel_func         func;
+	const int                    *args;
+
+	const struct gs_texture      *image;
+	const struct gs_sampler_info *sampler;
+
+	struct matrix4               color_matrix;
+	struct vec3                  color_range_min;
+	struct vec3                  color_range_max;
+	struct vec4                  color;
+
+	float u_plane_offset, v_plane_offset;
+	float width, height, width_i, height_i;
+	float width_d2, height_d2, width_d2_i, height_d2_i;
+	float input_width, input_height, input_width_i, input_height_i;
+	float input_width_i_d2, input_height_i_d2;
+};
+
+/* ------------------------------------------------------------------------- */
+/* sampling */
+
+static inline bool filter_is_point(enum gs_sample_filter filter)
+{
+	/* only the top level exists, so only the mag filter matters */
+	return filter == GS_FILTER_POINT ||
+	       filter == GS_FILTER_MIN_MAG_POINT_MIP_LINEAR ||
+	       filter == GS_FILTER_MIN_LINEAR_MAG_MIP_POINT ||
+	       filter == GS_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
+}
+
+/* returns -1 for texels outside of a border addressed texture */
+static inline int address_texel(int coord, int size,
+		enum gs_address_mode mode)
+{
+	switch (mode) {
+	case GS_ADDRESS_WRAP:
+		coord %= size;
+		return coord < 0 ? coord + size : coord;
+
+	case GS_ADDRESS_MIRROR:
+		coord %= size * 2;
+		if (coord < 0)
+			coord += size * 2;
+		return coord < size ? coord : size * 2 - 1 - coord;
+
+	case GS_ADDRESS_BORDER:
+		return (coord < 0 || coord >= size) ? -1 : coord;
+
+	case GS_ADDRESS_MIRRORONCE:
+		if (coord < 0)
+			coord = -coord - 1;
+		/* fall through */
+	case GS_ADDRESS_CLAMP:
+		break;
+	}
+
+	return coord < 0 ? 0 : (coord >= size ? size - 1 : coord);
+}
+
+static inline void fetch_texel(const struct gs_texture *tex,
+		const struct gs_sampler_info *info, int x, int y,
+		struct vec4 *val)
+{
+	const uint8_t *ptr;
+	uint32_t bpp = gs_get_format_bpp(tex->format) / 8;
+
+	x = address_texel(x, (int)tex->width,  info->address_u);
+	y = address_texel(y, (int)tex->height, info->address_v);
+
+	if (x < 0 || y < 0) {
+		vec4_from_rgba(val, info->border_color);
+		return;
+	}
+
+	ptr = tex->data + (size_t)tex->linesize * y + (size_t)bpp * x;
+	null_read_texel(tex->format, ptr, val);
+}
+
+static inline void lerp_texel(struct vec4 *dst, const struct vec4 *v1,
+		const struct vec4 *v2, float t)
+{
+	struct vec4 delta;
+	vec4_sub(&delta, v2, v1);
+	vec4_mulf(&delta, &delta, t);
+	vec4_add(dst, v1, &delta);
+}
+
+static void sample_texture(const struct ps_context *ctx, float u, float v,
+		struct vec4 *out)
+{
+	const struct gs_texture      *tex  = ctx->image;
+	const struct gs_sampler_info *info = ctx->sampler;
+	struct vec4 t00, t10, t01, t11, top, bottom;
+	float x, y, fx, fy;
+	int   x0, y0;
+
+	if (!tex || tex->type != GS_TEXTURE_2D) {
+		vec4_zero(out);
+		return;
+	}
+
+	x = u * (float)tex->width;
+	y = v * (float)tex->height;
+
+	if (filter_is_point(info->filter)) {
+		fetch_texel(tex, info, (int)floorf(x), (int)floorf(y), out);
+		return;
+	}
+
+	x -= 0.5f;
+	y -= 0.5f;
+	x0 = (int)floorf(x);
+	y0 = (int)floorf(y);
+	fx = x - (float)x0;
+	fy = y - (float)y0;
+
+	fetch_texel(tex, info, x0,     y0,     &t00);
+	fetch_texel(tex, info, x0 + 1, y0,     &t10);
+	fetch_texel(tex, info, x0,     y0 + 1, &t01);
+	fetch_texel(tex, info, x0 + 1, y0 + 1, &t11);
+
+	lerp_texel(&top,    &t00, &t10, fx);
+	lerp_texel(&bottom, &t01, &t11, fx);
+	lerp_texel(out,     &top, &bottom, fy);
+}
+
+/* ------------------------------------------------------------------------- */
+/* format_conversion.effect */
+
+static void ps_nv12(const struct ps_context *ctx, const struct vec2 *uv,
+		struct vec4 *out)
+{
+	float v_mul = floorf(uv->y * ctx->input_height);
+	float byte_offset = floorf((v_mul + uv->x) * ctx->width) * 4.0f;
+	struct vec4 texel, texel2;
+	byte_offset += PRECISION_OFFSET;
+
+	if (byte_offset < ctx->u_plane_offset) {
+		float lum_u = floorf(fmodf(byte_offset, ctx->width)) *
+			ctx->width_i;
+		float lum_v = floorf(byte_offset * ctx->width_i) *
+			ctx->height_i;
+
+		lum_u += ctx->width_i  * 0.5f;
+		lum_v += ctx->height_i * 0.5f;
+
+		for (int i = 0; i < 4; i++) {
+			sample_texture(ctx, lum_u, lum_v, &texel);
+			out->ptr[i] = texel.y;
+			lum_u += ctx->width_i;
+		}
+	} else {
+		float new_offset = byte_offset - ctx->u_plane_offset;
+		float ch_u = floorf(fmodf(new_offset, ctx->width)) *
+			ctx->width_i;
+		float ch_v = floorf(new_offset * ctx->width_i) *
+			ctx->height_d2_i;
+
+		ch_u += ctx->width_i;
+		ch_v += ctx->height_i;
+
+		sample_texture(ctx, ch_u, ch_v, &texel);
+		sample_texture(ctx, ch_u + ctx->width_i * 2.0f, ch_v, &texel2);
+		vec4_set(out, texel.x, texel.z, texel2.x, texel2.z);
+	}
+}
+
+static void ps_nv12_linewise(const struct ps_context *ctx,
+		const struct vec2 *uv, struct vec4 *out)
+{
+	float x = floorf(uv->x * ctx->input_width) / ctx->input_width;
+	struct vec4 texel, texel2;
+
+	if (uv->y * ctx->input_height < ctx->height) {
+		float lum_v = floorf(uv->y * ctx->input_height) / ctx->height;
+		float lum_u = x;
+
+		lum_u += ctx->width_i  * 0.5f;
+		lum_v += ctx->height_i * 0.5f;
+
+		for (int i = 0; i < 4; i++) {
+			sample_texture(ctx, lum_u, lum_v, &texel);
+			out->ptr[i] = texel.y;
+			lum_u += ctx->width_i;
+		}
+	} else {
+		float ch_u = x;
+		float ch_v = floorf(uv->y * ctx->input_height - ctx->height) /
+			ctx->height * 2.0f;
+
+		ch_u += ctx->width_i;
+		ch_v += ctx->height_i;
+
+		sample_texture(ctx, ch_u, ch_v, &texel);
+		sample_texture(ctx, ch_u + ctx->width_i * 2.0f, ch_v, &texel2);
+		vec4_set(out, texel.x, texel.z, texel2.x, texel2.z);
+	}
+}
+
+static inline void select_plane(const struct ps_context *ctx,
+		float byte_offset, const struct vec4 *texels,
+		struct vec4 *out)
+{
+	int channel;
+
+	if (byte_offset < ctx->u_plane_offset)
+		channel = 1;
+	else if (byte_offset < ctx->v_plane_offset)
+		channel = 0;
+	else
+		channel = 2;
+
+	for (int i = 0; i < 4; i++)
+		out->ptr[i] = texels[i].ptr[channel];
+}
+
+static void ps_planar420(const struct ps_context *ctx, const struct vec2 *uv,
+		struct vec4 *out)
+{
+	float v_mul = floorf(uv->y * ctx->input_height);
+	float byte_offset = floorf((v_mul + uv->x) * ctx->width) * 4.0f;
+	struct vec2 sample_pos[4];
+	struct vec4 texels[4];
+
+	memset(sample_pos, 0, sizeof(sample_pos));
+	byte_offset += PRECISION_OFFSET;
+
+	if (byte_offset < ctx->u_plane_offset) {
+		float lum_u = floorf(fmodf(byte_offset, ctx->width)) *
+			ctx->width_i;
+		float lum_v = floorf(byte_offset * ctx->width_i) *
+			ctx->height_i;
+
+		lum_u += ctx->width_i  * 0.5f;
+		lum_v += ctx->height_i * 0.5f;
+
+		for (int i = 0; i < 4; i++) {
+			vec2_set(&sample_pos[i], lum_u, lum_v);
+			lum_u += ctx->width_i;
+		}
+	} else {
+		float new_offset = byte_offset -
+			((byte_offset < ctx->v_plane_offset) ?
+			 ctx->u_plane_offset : ctx->v_plane_offset);
+		float ch_u = floorf(fmodf(new_offset, ctx->width_d2)) *
+			ctx->width_d2_i;
+		float ch_v = floorf(new_offset * ctx->width_d2_i) *
+			ctx->height_d2_i;
+		float width_i2 = ctx->width_i * 2.0f;
+		float ch_u_n, ch_v_n;
+
+		ch_u += ctx->width_i;
+		ch_v += ctx->height_i;
+
+		ch_u_n = 0.0f + ctx->width_i;
+		ch_v_n = ch_v + ctx->height_i * 3.0f;
+
+		vec2_set(&sample_pos[0], ch_u, ch_v);
+		vec2_set(&sample_pos[1], ch_u += width_i2, ch_v);
+
+		ch_u += width_i2;
+
+		/* the effect assigns sample_pos[2] twice here and leaves
+		 * sample_pos[3] unset, which is reproduced as is */
+		if (ch_u > 1.0f) {
+			vec2_set(&sample_pos[2], ch_u_n + width_i2, ch_v_n);
+		} else {
+			vec2_set(&sample_pos[2], ch_u,            ch_v);
+			vec2_set(&sample_pos[3], ch_u + width_i2, ch_v);
+		}
+	}
+
+	for (int i = 0; i < 4; i++)
+		sample_texture(ctx, sample_pos[i].x, sample_pos[i].y,
+				&texels[i]);
+
+	select_plane(ctx, byte_offset, texels, out);
+}
+
+static void ps_planar444(const struct ps_context *ctx, const struct vec2 *uv,
+		struct vec4 *out)
+{
+	float v_mul = floorf(uv->y * ctx->input_height);
+	float byte_offset = floorf((v_mul + uv->x) * ctx->width) * 4.0f;
+	float new_byte_offset, u_val, v_val;
+	struct vec4 texels[4];
+
+	byte_offset += PRECISION_OFFSET;
+	new_byte_offset = byte_offset;
+
+	if (byte_offset >= ctx->v_plane_offset)
+		new_byte_offset -= ctx->v_plane_offset;
+	else if (byte_offset >= ctx->u_plane_offset)
+		new_byte_offset -= ctx->u_plane_offset;
+
+	u_val = floorf(fmodf(new_byte_offset, ctx->width)) * ctx->width_i;
+	v_val = floorf(new_byte_offset * ctx->width_i) * ctx->height_i;
+
+	u_val += ctx->width_i  * 0.5f;
+	v_val += ctx->height_i * 0.5f;
+
+	for (int i = 0; i < 4; i++) {
+		sample_texture(ctx, u_val, v_val, &texels[i]);
+		u_val += ctx->width_i;
+	}
+
+	select_plane(ctx, byte_offset, texels, out);
+}
+
+static void ps_packed422_reverse(const struct ps_context *ctx,
+		const struct vec2 *uv, struct vec4 *out)
+{
+	int u_pos  = ctx->args[0] & 3;
+	int v_pos  = ctx->args[1] & 3;
+	int y0_pos = ctx->args[2] & 3;
+	int y1_pos = ctx->args[3] & 3;
+	float odd = floorf(fmodf(ctx->width * uv->x + PRECISION_OFFSET, 2.0f));
+	float x = floorf(ctx->width_d2 * uv->x + PRECISION_OFFSET) *
+		ctx->width_d2_i;
+	struct vec4 texel;
+
+	x += ctx->input_width_i_d2;
+
+	sample_texture(ctx, x, uv->y, &texel);
+	vec4_set(out, odd > 0.5f ? texel.ptr[y1_pos] : texel.ptr[y0_pos],
+			texel.ptr[u_pos], texel.ptr[v_pos], 1.0f);
+}
+
+static float get_offset_color(const struct ps_context *ctx, float offset)
+{
+	struct vec4 texel;
+	float u, v;
+
+	offset += PRECISION_OFFSET;
+	u = floorf(fmodf(offset, ctx->input_width)) * ctx->input_width_i;
+	v = floorf(offset * ctx->input_width_i) * ctx->input_height_i;
+
+	u += ctx->input_width_i_d2;
+	v += ctx->input_height_i_d2;
+
+	sample_texture(ctx, u, v, &texel);
+	return texel.x;
+}
+
+static void ps_planar420_reverse(const struct ps_context *ctx,
+		const struct vec2 *uv, struct vec4 *out)
+{
+	float x_offset = floorf(uv->x * ctx->width  + PRECISION_OFFSET);
+	float y_offset = floorf(uv->y * ctx->height + PRECISION_OFFSET);
+	float lum_offset, ch_offset;
+
+	lum_offset = floorf(y_offset * ctx->width + x_offset +
+			PRECISION_OFFSET);
+	ch_offset  = floorf(floorf(y_offset * 0.5f + PRECISION_OFFSET) *
+			ctx->width_d2 + x_offset * 0.5f + PRECISION_OFFSET);
+
+	vec4_set(out,
+			get_offset_color(ctx, lum_offset),
+			get_offset_color(ctx, ctx->u_plane_offset + ch_offset),
+			get_offset_color(ctx, ctx->v_plane_offset + ch_offset),
+			1.0f);
+}
+
+static void ps_nv12_reverse(const struct ps_context *ctx,
+		const struct vec2 *uv, struct vec4 *out)
+{
+	float x_offset = floorf(uv->x * ctx->width  + PRECISION_OFFSET);
+	float y_offset = floorf(uv->y * ctx->height + PRECISION_OFFSET);
+	float lum_offset, ch_offset;
+
+	lum_offset = floorf(y_offset * ctx->width + x_offset +
+			PRECISION_OFFSET);
+	ch_offset  = floorf(y_offset * 0.5f + PRECISION_OFFSET) *
+		ctx->width_d2 + x_offset * 0.5f;
+	ch_offset  = floorf(ch_offset * 2.0f + PRECISION_OFFSET);
+
+	vec4_set(out,
+			get_offset_color(ctx, lum_offset),
+			get_offset_color(ctx, ctx->u_plane_offset + ch_offset),
+			get_offset_color(ctx,
+				ctx->u_plane_offset + ch_offset + 1.0f),
+			1.0f);
+}
+
+/* ------------------------------------------------------------------------- */
+/* other effects */
+
+static inline float saturate(float val)
+{
+	return val < 0.0f ? 0.0f : (val > 1.0f ? 1.0f : val);
+}
+
+static void ps_draw_matrix(const struct ps_context *ctx, const struct vec2 *uv,
+		struct vec4 *out)
+{
+	struct vec4 yuv;
+
+	sample_texture(ctx, uv->x, uv->y, &yuv);
+	for (int i = 0; i < 3; i++) {
+		float min_val = ctx->color_range_min.ptr[i];
+		float max_val = ctx->color_range_max.ptr[i];
+		yuv.ptr[i] = yuv.ptr[i] < min_val ? min_val :
+			(yuv.ptr[i] > max_val ? max_val : yuv.ptr[i]);
+	}
+	yuv.w = 1.0f;
+
+	out->x = saturate(vec4_dot(&yuv, &ctx->color_matrix.x));
+	out->y = saturate(vec4_dot(&yuv, &ctx->color_matrix.y));
+	out->z = saturate(vec4_dot(&yuv, &ctx->color_matrix.z));
+	out->w = saturate(vec4_dot(&yuv, &ctx->color_matrix.t));
+}
+
+static void run_pixel_shader(const struct ps_context *ctx,
+		const struct raster_vert *in, struct vec4 *out)
+{
+	switch (ctx->func) {
+	case NULL_PS_DRAW_BARE:
+		sample_texture(ctx, in->uv.x, in->uv.y, out);
+		break;
+	case NULL_PS_DRAW_OPAQUE:
+		sample_texture(ctx, in->uv.x, in->uv.y, out);
+		out->w = 1.0f;
+		break;
+	case NULL_PS_DRAW_MATRIX:
+		ps_draw_matrix(ctx, &in->uv, out);
+		break;
+	case NULL_PS_SOLID:
+		vec4_copy(out, &ctx->color);
+		break;
+	case NULL_PS_SOLID_COLORED:
+		vec4_mul(out, &in->color, &ctx->color);
+		break;
+	case NULL_PS_NV12:
+		ps_nv12(ctx, &in->uv, out);
+		break;
+	case NULL_PS_NV12_LINEWISE:
+		ps_nv12_linewise(ctx, &in->uv, out);
+		break;
+	case NULL_PS_PLANAR420:
+		ps_planar420(ctx, &in->uv, out);
+		break;
+	case NULL_PS_PLANAR444:
+		ps_planar444(ctx, &in->uv, out);
+		break;
+	case NULL_PS_PACKED422_REVERSE:
+		ps_packed422_reverse(ctx, &in->uv, out);
+		break;
+	case NULL_PS_PLANAR420_REVERSE:
+		ps_planar420_reverse(ctx, &in->uv, out);
+		break;
+	case NULL_PS_NV12_REVERSE:
+		ps_nv12_reverse(ctx, &in->uv, out);
+		break;
+	case NULL_PS_UNKNOWN:
+		vec4_set(out, 0.0f, 0.0f, 0.0f, 1.0f);
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* parameters */
+
+static void get_param_data(gs_shader_t *shader, const char *name,
+		void *data, size_t size)
+{
+	struct gs_shader_param *param;
+
+	param = gs_shader_get_param_by_name(shader, name);
+	if (param && param->cur_value.num >= size)
+		memcpy(data, param->cur_value.array, size);
+}
+
+static inline float get_param_float(gs_shader_t *shader, const char *name)
+{
+	float val = 0.0f;
+	get_param_data(shader, name, &val, sizeof(val));
+	return val;
+}
+
+static void init_ps_context(gs_device_t *device, struct ps_context *ctx)
+{
+	gs_shader_t *ps = device->cur_pixel_shader;
+	struct gs_shader_param *image;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->func    = ps->func;
+	ctx->args    = ps->func_args;
+	ctx->image   = device->cur_textures[0];
+	ctx->sampler = &device->default_sampler;
+
+	image = gs_shader_get_param_by_name(ps, "image");
+	if (image) {
+		gs_samplerstate_t *sampler = image->next_sampler ?
+			image->next_sampler : image->sampler;
+
+		ctx->image = image->texture;
+		if (sampler)
+			ctx->sampler = &sampler->info;
+	} else if (device->cur_samplers[0]) {
+		ctx->sampler = &device->cur_samplers[0]->info;
+	}
+
+	matrix4_identity(&ctx->color_matrix);
+	vec3_set(&ctx->color_range_max, 1.0f, 1.0f, 1.0f);
+	vec4_set(&ctx->color, 1.0f, 1.0f, 1.0f, 1.0f);
+
+	get_param_data(ps, "color_matrix", &ctx->color_matrix,
+			sizeof(struct matrix4));
+	get_param_data(ps, "color_range_min", ctx->color_range_min.ptr,
+			sizeof(float) * 3);
+	get_param_data(ps, "color_range_max", ctx->color_range_max.ptr,
+			sizeof(float) * 3);
+	get_param_data(ps, "color", ctx->color.ptr, sizeof(float) * 4);
+
+	ctx->u_plane_offset    = get_param_float(ps, "u_plane_offset");
+	ctx->v_plane_offset    = get_param_float(ps, "v_plane_offset");
+	ctx->width             = get_param_float(ps, "width");
+	ctx->height            = get_param_float(ps, "height");
+	ctx->width_i           = get_param_float(ps, "width_i");
+	ctx->height_i          = get_param_float(ps, "height_i");
+	ctx->width_d2          = get_param_float(ps, "width_d2");
+	ctx->height_d2         = get_param_float(ps, "height_d2");
+	ctx->width_d2_i        = get_param_float(ps, "width_d2_i");
+	ctx->height_d2_i       = get_param_float(ps, "height_d2_i");
+	ctx->input_width       = get_param_float(ps, "input_width");
+	ctx->input_height      = get_param_float(ps, "input_height");
+	ctx->input_width_i     = get_param_float(ps, "input_width_i");
+	ctx->input_height_i    = get_param_float(ps, "input_height_i");
+	ctx->input_width_i_d2  = get_param_float(ps, "input_width_i_d2");
+	ctx->input_height_i_d2 = get_param_float(ps, "input_height_i_d2");
+}
+
+/* ------------------------------------------------------------------------- */
+/* blending */
+
+static inline float blend_factor(enum gs_blend_type type, int channel,
+		const struct vec4 *src, const struct vec4 *dst)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:        return 0.0f;
+	case GS_BLEND_ONE:         return 1.0f;
+	case GS_BLEND_SRCCOLOR:    return src->ptr[channel];
+	case GS_BLEND_INVSRCCOLOR: return 1.0f - src->ptr[channel];
+	case GS_BLEND_SRCALPHA:    return src->w;
+	case GS_BLEND_INVSRCALPHA: return 1.0f - src->w;
+	case GS_BLEND_DSTCOLOR:    return dst->ptr[channel];
+	case GS_BLEND_INVDSTCOLOR: return 1.0f - dst->ptr[channel];
+	case GS_BLEND_DSTALPHA:    return dst->w;
+	case GS_BLEND_INVDSTALPHA: return 1.0f - dst->w;
+	case GS_BLEND_SRCALPHASAT:
+		if (channel == 3)
+			return 1.0f;
+		return src->w < 1.0f - dst->w ? src->w : 1.0f - dst->w;
+	}
+
+	return 1.0f;
+}
+
+static void write_pixel(const gs_device_t *device, enum gs_color_format format,
+		uint8_t *ptr, const struct vec4 *src)
+{
+	struct vec4 dst, result;
+
+	if (!device->blend_enabled &&
+	    device->color_mask[0] && device->color_mask[1] &&
+	    device->color_mask[2] && device->color_mask[3]) {
+		null_write_texel(format, ptr, src);
+		return;
+	}
+
+	null_read_texel(format, ptr, &dst);
+
+	for (int i = 0; i < 4; i++) {
+		enum gs_blend_type src_type = i < 3 ?
+			device->blend_src_c : device->blend_src_a;
+		enum gs_blend_type dst_type = i < 3 ?
+			device->blend_dest_c : device->blend_dest_a;
+
+		if (!device->color_mask[i])
+			result.ptr[i] = dst.ptr[i];
+		else if (!device->blend_enabled)
+			result.ptr[i] = src->ptr[i];
+		else
+			result.ptr[i] =
+				src->ptr[i] * blend_factor(src_type, i, src,
+						&dst) +
+				dst.ptr[i] * blend_factor(dst_type, i, src,
+						&dst);
+	}
+
+	null_write_texel(format, ptr, &result);
+}
+
+/* ------------------------------------------------------------------------- */
+/* rasterization */
+
+struct raster_target {
+	gs_texture_t   *tex;
+	uint8_t        *data;
+	uint32_t       bpp;
+	int            min_x, min_y;
+	int            max_x, max_y;
+};
+
+static inline double edge_func(const struct raster_vert *a,
+		const struct raster_vert *b, double x, double y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/* pixels exactly on an edge belong to the triangle on its top or left side */
+static inline bool is_top_left(const struct raster_vert *a,
+		const struct raster_vert *b)
+{
+	double dx = b->x - a->x;
+	double dy = b->y - a->y;
+	return dy < 0.0 || (dy == 0.0 && dx > 0.0);
+}
+
+static inline bool edge_inside(double edge, bool top_left)
+{
+	return edge > 0.0 || (edge == 0.0 && top_left);
+}
+
+/*
+ * libobs only draws with orthographic projections, so vertex attributes are
+ * interpolated linearly in screen space.
+ */
+static void draw_triangle(gs_device_t *device, const struct ps_context *ctx,
+		const struct raster_target *target,
+		const struct raster_vert *a, const struct raster_vert *b,
+		const struct raster_vert *c)
+{
+	double area = edge_func(a, b, c->x, c->y);
+	bool tl_ab, tl_bc, tl_ca;
+	int min_x, min_y, max_x, max_y;
+
+	if (area == 0.0)
+		return;
+
+	if (area < 0.0) {
+		const struct raster_vert *temp = b;
+		b    = c;
+		c    = temp;
+		area = -area;
+	}
+
+	tl_ab = is_top_left(a, b);
+	tl_bc = is_top_left(b, c);
+	tl_ca = is_top_left(c, a);
+
+	min_x = (int)floor(fmin(a->x, fmin(b->x, c->x)));
+	min_y = (int)floor(fmin(a->y, fmin(b->y, c->y)));
+	max_x = (int)ceil(fmax(a->x, fmax(b->x, c->x)));
+	max_y = (int)ceil(fmax(a->y, fmax(b->y, c->y)));
+
+	if (min_x < target->min_x) min_x = target->min_x;
+	if (min_y < target->min_y) min_y = target->min_y;
+	if (max_x > target->max_x) max_x = target->max_x;
+	if (max_y > target->max_y) max_y = target->max_y;
+
+	for (int y = min_y; y < max_y; y++) {
+		uint8_t *row = target->data +
+			(size_t)target->tex->linesize * y;
+		double py = (double)y + 0.5;
+
+		for (int x = min_x; x < max_x; x++) {
+			double px = (double)x + 0.5;
+			double w_a = edge_func(b, c, px, py);
+			double w_b = edge_func(c, a, px, py);
+			double w_c = edge_func(a, b, px, py);
+			struct raster_vert in;
+			struct vec4 out;
+
+			if (!edge_inside(w_a, tl_bc) ||
+			    !edge_inside(w_b, tl_ca) ||
+			    !edge_inside(w_c, tl_ab))
+				continue;
+
+			w_a /= area;
+			w_b /= area;
+			w_c /= area;
+
+			in.uv.x = (float)(a->uv.x * w_a + b->uv.x * w_b +
+					c->uv.x * w_c);
+			in.uv.y = (float)(a->uv.y * w_a + b->uv.y * w_b +
+					c->uv.y * w_c);
+
+			for (int i = 0; i < 4; i++)
+				in.color.ptr[i] = (float)(
+						a->color.ptr[i] * w_a +
+						b->color.ptr[i] * w_b +
+						c->color.ptr[i] * w_c);
+
+			run_pixel_shader(ctx, &in, &out);
+			write_pixel(device, target->tex->format,
+					row + (size_t)target->bpp * x, &out);
+		}
+	}
+}
+
+static bool init_target(gs_device_t *device, struct raster_target *target)
+{
+	const struct gs_rect *vp = &device->cur_viewport;
+
+	target->tex = null_get_target(device);
+	if (!target->tex)
+		return false;
+
+	target->data  = null_texture_face(target->tex,
+			target->tex->type == GS_TEXTURE_CUBE ?
+			device->cur_render_side : 0);
+	target->bpp   = gs_get_format_bpp(target->tex->format) / 8;
+	target->min_x = vp->x > 0 ? vp->x : 0;
+	target->min_y = vp->y > 0 ? vp->y : 0;
+	target->max_x = vp->x + vp->cx;
+	target->max_y = vp->y + vp->cy;
+
+	if (target->max_x > (int)target->tex->width)
+		target->max_x = (int)target->tex->width;
+	if (target->max_y > (int)target->tex->height)
+		target->max_y = (int)target->tex->height;
+
+	if (device->scissor_enabled) {
+		const struct gs_rect *sc = &device->cur_scissor;
+		if (target->min_x < sc->x) target->min_x = sc->x;
+		if (target->min_y < sc->y) target->min_y = sc->y;
+		if (target->max_x > sc->x + sc->cx)
+			target->max_x = sc->x + sc->cx;
+		if (target->max_y > sc->y + sc->cy)
+			target->max_y = sc->y + sc->cy;
+	}
+
+	return target->bpp && target->min_x < target->max_x &&
+		target->min_y < target->max_y;
+}
+
+static void transform_vert(const gs_device_t *device,
+		const struct gs_vb_data *data, size_t idx,
+		struct raster_vert *vert)
+{
+	const struct gs_rect *vp = &device->cur_viewport;
+	struct vec4 pos;
+
+	vec4_set(&pos, data->points[idx].x, data->points[idx].y,
+			data->points[idx].z, 1.0f);
+	vec4_transform(&pos, &pos, &device->cur_viewproj);
+
+	if (pos.w != 0.0f) {
+		pos.x /= pos.w;
+		pos.y /= pos.w;
+	}
+
+	vert->x = ((double)pos.x + 1.0) * 0.5 * vp->cx + vp->x;
+	vert->y = (1.0 - (double)pos.y) * 0.5 * vp->cy + vp->y;
+
+	vec2_zero(&vert->uv);
+	if (data->num_tex && data->tvarray[0].width >= 2) {
+		const float *uv = (const float*)data->tvarray[0].array +
+			data->tvarray[0].width * idx;
+		vec2_set(&vert->uv, uv[0], uv[1]);
+	}
+
+	if (data->colors)
+		vec4_from_rgba(&vert->color, data->colors[idx]);
+	else
+		vec4_set(&vert->color, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+static inline size_t get_index(const struct gs_index_buffer *ib, size_t i)
+{
+	if (!ib)
+		return i;
+
+	return ib->type == GS_UNSIGNED_LONG ?
+		((const uint32_t*)ib->data)[i] :
+		((const uint16_t*)ib->data)[i];
+}
+
+void null_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	const struct gs_index_buffer *ib = device->cur_index_buffer;
+	const struct gs_vb_data *data = device->cur_vertex_buffer->data;
+	struct raster_target target;
+	struct raster_vert verts[3];
+	struct ps_context ctx;
+	size_t total = ib ? ib->num : data->num;
+
+	/* points and lines are not rasterized */
+	if (draw_mode != GS_TRIS && draw_mode != GS_TRISTRIP)
+		return;
+	if (!init_target(device, &target))
+		return;
+
+	if (!num_verts || start_vert + num_verts > total)
+		num_verts = start_vert < total ? (uint32_t)total - start_vert : 0;
+	if (num_verts < 3)
+		return;
+
+	init_ps_context(device, &ctx);
+
+	if (draw_mode == GS_TRIS) {
+		for (uint32_t i = 0; i + 2 < num_verts; i += 3) {
+			for (uint32_t j = 0; j < 3; j++) {
+				size_t idx = get_index(ib, start_vert + i + j);
+				if (idx >= data->num)
+					return;
+				transform_vert(device, data, idx, &verts[j]);
+			}
+
+			draw_triangle(device, &ctx, &target,
+					&verts[0], &verts[1], &verts[2]);
+		}
+	} else {
+		for (uint32_t i = 0; i < num_verts; i++) {
+			size_t idx = get_index(ib, start_vert + i);
+			if (idx >= data->num)
+				return;
+
+			transform_vert(device, data, idx, &verts[i % 3]);
+			if (i >= 2)
+				draw_triangle(device, &ctx, &target,
+						&verts[0], &verts[1],
+						&verts[2]);
+		}
+	}
+}
@@ -0,0 +1,412 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+#include <ctype.h>
+
+#include <util/dstr.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include <graphics/matrix3.h>
+#include <graphics/shader-parser.h>
+#include "null-subsystem.h"
+
+struct pixel_func_name {
+	const char           *name;
+	enum null_pixel_func func;
+};
+
+/* pixel shader entry points of the effects shipped with libobs */
+static const struct pixel_func_name pixel_funcs[] = {
+	{"PSDrawBare",                 NULL_PS_DRAW_BARE},
+	{"PSDrawBicubicRGBA",          NULL_PS_DRAW_BARE},
+	{"PSDrawLanczosRGBA",          NULL_PS_DRAW_BARE},
+	{"PSDrawLowresBilinearRGBA",   NULL_PS_DRAW_BARE},
+	{"PSDrawMatrix",               NULL_PS_DRAW_MATRIX},
+	{"PSDrawBicubicMatrix",        NULL_PS_DRAW_MATRIX},
+	{"PSDrawLanczosMatrix",        NULL_PS_DRAW_MATRIX},
+	{"PSDrawLowresBilinearMatrix", NULL_PS_DRAW_MATRIX},
+	{"PSDraw",                     NULL_PS_DRAW_OPAQUE},
+	{"PSSolid",                    NULL_PS_SOLID},
+	{"PSSolidColored",             NULL_PS_SOLID_COLORED},
+	{"PSNV12",                     NULL_PS_NV12},
+	{"PSNV12LineWise",             NULL_PS_NV12_LINEWISE},
+	{"PSPlanar420",                NULL_PS_PLANAR420},
+	{"PSPlanar444",                NULL_PS_PLANAR444},
+	{"PSPacked422_Reverse",        NULL_PS_PACKED422_REVERSE},
+	{"PSPlanar420_Reverse",        NULL_PS_PLANAR420_REVERSE},
+	{"PSNV12_Reverse",             NULL_PS_NV12_REVERSE},
+};
+
+#define NUM_PIXEL_FUNCS (sizeof(pixel_funcs) / sizeof(pixel_funcs[0]))
+
+static inline void shader_param_free(struct gs_shader_param *param)
+{
+	bfree(param->name);
+	da_free(param->cur_value);
+	da_free(param->def_value);
+}
+
+static inline const char *skip_space(const char *str)
+{
+	while (*str && isspace((unsigned char)*str))
+		str++;
+	return str;
+}
+
+static inline const char *read_ident(const char *str, struct dstr *ident)
+{
+	const char *start = str;
+	while (*str && (isalnum((unsigned char)*str) || *str == '_'))
+		str++;
+
+	dstr_ncopy(ident, start, str - start);
+	return str;
+}
+
+/*
+ * The effect parser generates a main() for every pass that does nothing but
+ * return the pass's pixel function, along with any constant arguments, so
+ * that call identifies what the shader computes.
+ */
+static void null_identify_pixel_func(struct gs_shader *shader,
+		const char *shader_str)
+{
+	struct dstr name = {0};
+	const char *pos = strstr(shader_str, " main(");
+	int arg = 0;
+
+	if (pos)
+		pos = strstr(pos, "return");
+	if (!pos)
+		return;
+
+	pos = read_ident(skip_space(pos + 6), &name);
+
+	for (size_t i = 0; i < NUM_PIXEL_FUNCS; i++) {
+		if (dstr_cmp(&name, pixel_funcs[i].name) == 0) {
+			shader->func = pixel_funcs[i].func;
+			break;
+		}
+	}
+
+	/* the first argument is the vertex input, the rest are constants */
+	pos = strchr(pos, ',');
+	while (pos && arg < 4) {
+		pos = skip_space(pos + 1);
+		if (!isdigit((unsigned char)*pos))
+			break;
+
+		shader->func_args[arg++] = atoi(pos);
+		pos = strchr(pos, ',');
+	}
+
+	dstr_free(&name);
+}
+
+/* finds the sampler state a texture is sampled with, "tex.Sample(sampler" */
+static gs_samplerstate_t *null_find_sampler(struct gs_shader *shader,
+		struct shader_parser *parser, const char *shader_str,
+		const char *tex_name)
+{
+	struct dstr search = {0};
+	struct dstr name = {0};
+	gs_samplerstate_t *sampler = NULL;
+	const char *pos;
+
+	dstr_printf(&search, "%s.Sample(", tex_name);
+	pos = strstr(shader_str, search.array);
+
+	if (pos) {
+		read_ident(skip_space(pos + search.len), &name);
+
+		for (size_t i = 0; i < parser->samplers.num; i++) {
+			if (dstr_cmp(&name, parser->samplers.array[i].name) == 0) {
+				sampler = shader->samplers.array[i];
+				break;
+			}
+		}
+	}
+
+	if (!sampler && shader->samplers.num)
+		sampler = shader->samplers.array[0];
+
+	dstr_free(&search);
+	dstr_free(&name);
+	return sampler;
+}
+
+static void null_add_params(struct gs_shader *shader,
+		struct shader_parser *parser, const char *shader_str)
+{
+	for (size_t i = 0; i < parser->samplers.num; i++) {
+		struct gs_sampler_info info;
+		gs_samplerstate_t *sampler;
+
+		shader_sampler_convert(parser->samplers.array+i, &info);
+		sampler = device_samplerstate_create(shader->device, &info);
+		da_push_back(shader->samplers, &sampler);
+	}
+
+	for (size_t i = 0; i < parser->params.num; i++) {
+		struct shader_var *var = parser->params.array+i;
+		struct gs_shader_param param = {0};
+
+		param.array_count = var->array_count;
+		param.name        = bstrdup(var->name);
+		param.shader      = shader;
+		param.type        = get_shader_param_type(var->type);
+
+		if (param.type == GS_SHADER_PARAM_TEXTURE)
+			param.sampler = null_find_sampler(shader, parser,
+					shader_str, var->name);
+
+		da_move(param.def_value, var->default_val);
+		da_copy(param.cur_value, param.def_value);
+
+		da_push_back(shader->params, &param);
+	}
+
+	shader->viewproj = gs_shader_get_param_by_name(shader, "ViewProj");
+	shader->world    = gs_shader_get_param_by_name(shader, "World");
+}
+
+static void null_identify_unknown(struct gs_shader *shader, const char *file)
+{
+	if (gs_shader_get_param_by_name(shader, "image"))
+		shader->func = NULL_PS_DRAW_BARE;
+	else if (gs_shader_get_param_by_name(shader, "color"))
+		shader->func = NULL_PS_SOLID;
+
+	blog(LOG_DEBUG, "Null graphics: pixel shader in '%s' is not known, "
+	                "drawing it as %s", file ? file : "(unnamed)",
+	                shader->func == NULL_PS_DRAW_BARE ? "a texture" :
+	                shader->func == NULL_PS_SOLID     ? "a solid color" :
+	                                                    "black");
+}
+
+static struct gs_shader *shader_create(gs_device_t *device,
+		enum gs_shader_type type, const char *shader_str,
+		const char *file, char **error_string)
+{
+	struct gs_shader *shader = bzalloc(sizeof(struct gs_shader));
+	struct shader_parser parser;
+
+	shader->device = device;
+	shader->type   = type;
+
+	shader_parser_init(&parser);
+	if (!shader_parse(&parser, shader_str, file)) {
+		if (error_string)
+			*error_string = shader_parser_geterrors(&parser);
+
+		shader_parser_free(&parser);
+		gs_shader_destroy(shader);
+		return NULL;
+	}
+
+	null_add_params(shader, &parser, shader_str);
+
+	if (type == GS_SHADER_PIXEL) {
+		null_identify_pixel_func(shader, shader_str);
+		if (shader->func == NULL_PS_UNKNOWN)
+			null_identify_unknown(shader, file);
+	}
+
+	shader_parser_free(&parser);
+	return shader;
+}
+
+gs_shader_t *device_vertexshader_create(gs_device_t *device,
+		const char *shader, const char *file,
+		char **error_string)
+{
+	struct gs_shader *ptr;
+	ptr = shader_create(device, GS_SHADER_VERTEX, shader, file,
+			error_string);
+	if (!ptr)
+		blog(LOG_ERROR, "device_vertexshader_create (null) failed");
+	return ptr;
+}
+
+gs_shader_t *device_pixelshader_create(gs_device_t *device,
+		const char *shader, const char *file,
+		char **error_string)
+{
+	struct gs_shader *ptr;
+	ptr = shader_create(device, GS_SHADER_PIXEL, shader, file,
+			error_string);
+	if (!ptr)
+		blog(LOG_ERROR, "device_pixelshader_create (null) failed");
+	return ptr;
+}
+
+void gs_shader_destroy(gs_shader_t *shader)
+{
+	size_t i;
+
+	if (!shader)
+		return;
+
+	if (shader->device->cur_vertex_shader == shader)
+		shader->device->cur_vertex_shader = NULL;
+	if (shader->device->cur_pixel_shader == shader)
+		shader->device->cur_pixel_shader = NULL;
+
+	for (i = 0; i < shader->samplers.num; i++)
+		gs_samplerstate_destroy(shader->samplers.array[i]);
+
+	for (i = 0; i < shader->params.num; i++)
+		shader_param_free(shader->params.array+i);
+
+	da_free(shader->samplers);
+	da_free(shader->params);
+	bfree(shader);
+}
+
+int gs_shader_get_num_params(const gs_shader_t *shader)
+{
+	return (int)shader->params.num;
+}
+
+gs_sparam_t *gs_shader_get_param_by_idx(gs_shader_t *shader, uint32_t param)
+{
+	assert(param < shader->params.num);
+	return shader->params.array+param;
+}
+
+gs_sparam_t *gs_shader_get_param_by_name(gs_shader_t *shader, const char *name)
+{
+	size_t i;
+	for (i = 0; i < shader->params.num; i++) {
+		struct gs_shader_param *param = shader->params.array+i;
+
+		if (strcmp(param->name, name) == 0)
+			return param;
+	}
+
+	return NULL;
+}
+
+gs_sparam_t *gs_shader_get_viewproj_matrix(const gs_shader_t *shader)
+{
+	return shader->viewproj;
+}
+
+gs_sparam_t *gs_shader_get_world_matrix(const gs_shader_t *shader)
+{
+	return shader->world;
+}
+
+void gs_shader_get_param_info(const gs_sparam_t *param,
+		struct gs_shader_param_info *info)
+{
+	info->type = param->type;
+	info->name = param->name;
+}
+
+void gs_shader_set_bool(gs_sparam_t *param, bool val)
+{
+	int int_val = val;
+	da_copy_array(param->cur_value, &int_val, sizeof(int_val));
+}
+
+void gs_shader_set_float(gs_sparam_t *param, float val)
+{
+	da_copy_array(param->cur_value, &val, sizeof(val));
+}
+
+void gs_shader_set_int(gs_sparam_t *param, int val)
+{
+	da_copy_array(param->cur_value, &val, sizeof(val));
+}
+
+void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
+{
+	struct matrix4 mat;
+	matrix4_from_matrix3(&mat, val);
+
+	da_copy_array(param->cur_value, &mat, sizeof(mat));
+}
+
+void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
+{
+	da_copy_array(param->cur_value, val, sizeof(*val));
+}
+
+void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
+{
+	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+}
+
+void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
+{
+	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+}
+
+void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
+{
+	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+}
+
+void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
+{
+	param->texture = val;
+}
+
+void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
+{
+	int count = param->array_count;
+	size_t expected_size = 0;
+	if (!count)
+		count = 1;
+
+	switch ((uint32_t)param->type) {
+	case GS_SHADER_PARAM_FLOAT:     expected_size = sizeof(float); break;
+	case GS_SHADER_PARAM_BOOL:
+	case GS_SHADER_PARAM_INT:       expected_size = sizeof(int); break;
+	case GS_SHADER_PARAM_VEC2:      expected_size = sizeof(float)*2; break;
+	case GS_SHADER_PARAM_VEC3:      expected_size = sizeof(float)*3; break;
+	case GS_SHADER_PARAM_VEC4:      expected_size = sizeof(float)*4; break;
+	case GS_SHADER_PARAM_MATRIX4X4: expected_size = sizeof(float)*4*4;break;
+	case GS_SHADER_PARAM_TEXTURE:   expected_size = sizeof(void*); break;
+	default:                        expected_size = 0;
+	}
+
+	expected_size *= count;
+	if (!expected_size)
+		return;
+
+	if (expected_size != size) {
+		blog(LOG_ERROR, "gs_shader_set_val (null): Size of shader "
+		                "param does not match the size of the input");
+		return;
+	}
+
+	if (param->type == GS_SHADER_PARAM_TEXTURE)
+		gs_shader_set_texture(param, *(gs_texture_t**)val);
+	else
+		da_copy_array(param->cur_value, val, size);
+}
+
+void gs_shader_set_default(gs_sparam_t *param)
+{
+	gs_shader_set_val(param, param->def_value.array, param->def_value.num);
+}
+
+void gs_shader_set_next_sampler(gs_sparam_t *param, gs_samplerstate_t *sampler)
+{
+	param->next_sampler = sampler;
+}
@@ -0,0 +1,900 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include "null-subsystem.h"
+
+static void clear_textures(struct gs_device *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+gs_texture_t *null_get_target(const gs_device_t *device)
+{
+	if (device->cur_render_target)
+		return device->cur_render_target;
+	return device->cur_swap ? device->cur_swap->target : NULL;
+}
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_NULL;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	device->cur_cull_mode = GS_BACK;
+	device->blend_enabled = true;
+	device->blend_src_c   = GS_BLEND_SRCALPHA;
+	device->blend_dest_c  = GS_BLEND_INVSRCALPHA;
+	device->blend_src_a   = GS_BLEND_ONE;
+	device->blend_dest_a  = GS_BLEND_INVSRCALPHA;
+
+	for (size_t i = 0; i < 4; i++)
+		device->color_mask[i] = true;
+
+	device->default_sampler.filter         = GS_FILTER_LINEAR;
+	device->default_sampler.address_u      = GS_ADDRESS_CLAMP;
+	device->default_sampler.address_v      = GS_ADDRESS_CLAMP;
+	device->default_sampler.address_w      = GS_ADDRESS_CLAMP;
+	device->default_sampler.max_anisotropy = 1;
+
+	matrix4_identity(&device->cur_proj);
+	matrix4_identity(&device->cur_view);
+	matrix4_identity(&device->cur_viewproj);
+
+	blog(LOG_INFO, "Null graphics device created, all rendering is done "
+	               "on the CPU");
+
+	*p_device = device;
+	return GS_SUCCESS;
+
+	UNUSED_PARAMETER(adapter);
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (device) {
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+static inline enum gs_color_format get_swap_format(
+		const struct gs_init_data *info)
+{
+	return info->format == GS_UNKNOWN ? GS_RGBA : info->format;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	swap->target = null_texture_create(device, GS_TEXTURE_2D,
+			info->cx ? info->cx : 1, info->cy ? info->cy : 1,
+			get_swap_format(info), 1, NULL, GS_RENDER_TARGET);
+
+	if (!swap->target) {
+		blog(LOG_ERROR, "device_swapchain_create (null) failed");
+		bfree(swap);
+		return NULL;
+	}
+
+	return swap;
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	struct gs_swap_chain *swap = device->cur_swap;
+	gs_texture_t *target;
+
+	if (!swap) {
+		blog(LOG_ERROR, "device_resize (null): No active swap");
+		return;
+	}
+
+	target = null_texture_create(device, GS_TEXTURE_2D,
+			cx ? cx : 1, cy ? cy : 1, get_swap_format(&swap->info),
+			1, NULL, GS_RENDER_TARGET);
+	if (!target) {
+		blog(LOG_ERROR, "device_resize (null) failed");
+		return;
+	}
+
+	gs_texture_destroy(swap->target);
+	swap->target  = target;
+	swap->info.cx = cx;
+	swap->info.cy = cy;
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_size (null): No active swap");
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cx;
+	} else {
+		blog(LOG_ERROR, "device_get_width (null): No active swap");
+		return 0;
+	}
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_height (null): No active swap");
+		return 0;
+	}
+}
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs;
+
+	/* depth and stencil tests are not emulated, only the size is kept */
+	zs = bzalloc(sizeof(struct gs_zstencil_buffer));
+	zs->device = device;
+	zs->width  = width;
+	zs->height = height;
+	zs->format = format;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zs)
+{
+	if (zs) {
+		if (zs->device->cur_zstencil_buffer == zs)
+			zs->device->cur_zstencil_buffer = NULL;
+		bfree(zs);
+	}
+}
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+		const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler;
+
+	sampler = bzalloc(sizeof(struct gs_sampler_state));
+	sampler->device = device;
+	sampler->info   = *info;
+	return sampler;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (samplerstate->device->cur_samplers[i] == samplerstate)
+			samplerstate->device->cur_samplers[i] = NULL;
+	}
+
+	bfree(samplerstate);
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertex and index buffers, the data is read directly when drawing */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+		struct gs_vb_data *data, uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device  = device;
+	vb->data    = data;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (vb) {
+		if (vb->device->cur_vertex_buffer == vb)
+			vb->device->cur_vertex_buffer = NULL;
+
+		gs_vbdata_destroy(vb->data);
+		bfree(vb);
+	}
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	if (!vb->dynamic)
+		blog(LOG_ERROR, "vertex buffer is not dynamic");
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+		enum gs_index_type type, void *indices, size_t num,
+		uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	ib->device  = device;
+	ib->data    = indices;
+	ib->type    = type;
+	ib->num     = num;
+	ib->width   = type == GS_UNSIGNED_LONG ? 4 : 2;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (ib) {
+		if (ib->device->cur_index_buffer == ib)
+			ib->device->cur_index_buffer = NULL;
+
+		bfree(ib->data);
+		bfree(ib);
+	}
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	if (!ib->dynamic)
+		blog(LOG_ERROR, "index buffer is not dynamic");
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+/* ------------------------------------------------------------------------- */
+/* state */
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit < 0 || unit >= GS_MAX_TEXTURES) {
+		blog(LOG_ERROR, "device_load_texture (null) failed");
+		return;
+	}
+
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device, gs_samplerstate_t *ss,
+		int unit)
+{
+	if (unit < 0 || unit >= GS_MAX_TEXTURES) {
+		blog(LOG_ERROR, "device_load_samplerstate (null) failed");
+		return;
+	}
+
+	device->cur_samplers[unit] = ss;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		blog(LOG_ERROR, "device_load_vertexshader (null) failed");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (device->cur_pixel_shader == pixelshader)
+		return;
+
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		blog(LOG_ERROR, "device_load_pixelshader (null) failed");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+	clear_textures(device);
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = NULL;
+
+	UNUSED_PARAMETER(b_3d);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "Texture is not a 2D texture");
+			goto fail;
+		}
+
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = 0;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_render_target (null) failed");
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "Texture is not a cube texture");
+			goto fail;
+		}
+
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+
+		if (side < 0 || side > 5) {
+			blog(LOG_ERROR, "Invalid cube texture side %d", side);
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = cubetex;
+	device->cur_render_side     = cubetex ? side : 0;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_cube_render_target (null) failed");
+}
+
+/* ------------------------------------------------------------------------- */
+/* copies, all of them complete before returning */
+
+static void copy_rows(uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize,
+		uint32_t row_bytes, uint32_t rows)
+{
+	for (uint32_t y = 0; y < rows; y++)
+		memcpy(dst + (size_t)dst_linesize * y,
+				src + (size_t)src_linesize * y, row_bytes);
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bpp, nw, nh;
+
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination texture is NULL");
+		goto fail;
+	}
+
+	if (dst->type != GS_TEXTURE_2D || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source and destination textures must be 2D "
+		                "textures");
+		goto fail;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	nw = src_w ? src_w : (src->width - src_x);
+	nh = src_h ? src_h : (src->height - src_y);
+
+	if (src->width - src_x < nw || src->height - src_y < nh) {
+		blog(LOG_ERROR, "Source texture region is out of bounds");
+		goto fail;
+	}
+
+	if (dst->width - dst_x < nw || dst->height - dst_y < nh) {
+		blog(LOG_ERROR, "Destination texture region is not big "
+		                "enough to hold the source region");
+		goto fail;
+	}
+
+	bpp = gs_get_format_bpp(src->format) / 8;
+	if (!bpp) {
+		blog(LOG_ERROR, "Compressed textures can not be copied");
+		goto fail;
+	}
+
+	copy_rows(dst->data + (size_t)dst->linesize * dst_y + bpp * dst_x,
+			dst->linesize,
+			src->data + (size_t)src->linesize * src_y + bpp * src_x,
+			src->linesize, bpp * nw, nh);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_copy_texture (null) failed");
+	UNUSED_PARAMETER(device);
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+static bool can_stage(const struct gs_stage_surface *dst,
+		const struct gs_texture *src, uint32_t src_x, uint32_t src_y)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		return false;
+	}
+
+	if (src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source texture must be a 2D texture");
+		return false;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination surface is NULL");
+		return false;
+	}
+
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		return false;
+	}
+
+	if (src->width < src_x + dst->width ||
+	    src->height < src_y + dst->height) {
+		blog(LOG_ERROR, "Source texture is too small for the "
+		                "destination surface");
+		return false;
+	}
+
+	return true;
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	if (src && dst && (src->width != dst->width ||
+	                   src->height != dst->height)) {
+		blog(LOG_ERROR, "Source and destination must have the same "
+		                "dimensions");
+		blog(LOG_ERROR, "device_stage_texture (null) failed");
+		return;
+	}
+
+	device_stage_texture_region(device, dst, src, 0, 0);
+}
+
+void device_stage_texture_region(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y)
+{
+	uint32_t bpp;
+
+	if (!can_stage(dst, src, src_x, src_y)) {
+		blog(LOG_ERROR, "device_stage_texture_region (null) failed");
+		return;
+	}
+
+	bpp = gs_get_format_bpp(src->format) / 8;
+	copy_rows(dst->data, dst->linesize,
+			src->data + (size_t)src->linesize * src_y + bpp * src_x,
+			src->linesize, (dst->width * bpp * 8 + 7) / 8,
+			dst->height);
+
+	UNUSED_PARAMETER(device);
+}
+
+/* ------------------------------------------------------------------------- */
+/* drawing */
+
+void device_begin_scene(gs_device_t *device)
+{
+	clear_textures(device);
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+	struct matrix4 transposed;
+
+	gs_matrix_get(&device->cur_view);
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+			&device->cur_proj);
+
+	/* vertices are transformed with cur_viewproj, the parameter is only
+	 * kept up to date for parity with the other subsystems */
+	matrix4_transpose(&transposed, &device->cur_viewproj);
+	if (vs->viewproj)
+		gs_shader_set_matrix4(vs->viewproj, &transposed);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	gs_effect_t *effect = gs_get_effect();
+
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		goto fail;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		goto fail;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		goto fail;
+	}
+
+	if (!null_get_target(device)) {
+		blog(LOG_ERROR, "No render target or swap chain to render to");
+		goto fail;
+	}
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	update_viewproj_matrix(device);
+	null_draw(device, draw_mode, start_vert, num_verts);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_draw (null) failed");
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	/* does nothing */
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	gs_texture_t *target = null_get_target(device);
+	uint8_t *data;
+	uint32_t bpp;
+
+	if (!(clear_flags & GS_CLEAR_COLOR) || !target)
+		return;
+
+	bpp = gs_get_format_bpp(target->format) / 8;
+	if (!bpp)
+		return;
+
+	data = null_texture_face(target, target->type == GS_TEXTURE_CUBE ?
+			device->cur_render_side : 0);
+
+	null_write_texel(target->format, data, color);
+	for (uint32_t x = 1; x < target->width; x++)
+		memcpy(data + bpp * x, data, bpp);
+	for (uint32_t y = 1; y < target->height; y++)
+		memcpy(data + (size_t)target->linesize * y, data,
+				(size_t)bpp * target->width);
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	/* triangles are rasterized regardless of their winding */
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->blend_enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	device->color_mask[0] = red;
+	device->color_mask[1] = green;
+	device->color_mask[2] = blue;
+	device->color_mask[3] = alpha;
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	device->blend_src_c  = src_c;
+	device->blend_dest_c = dest_c;
+	device->blend_src_a  = src_a;
+	device->blend_dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	device->scissor_enabled = rect != NULL;
+	if (rect)
+		device->cur_scissor = *rect;
+}
+
+/* depth maps to [0, 1] like Direct3D, targets are stored top-down */
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = far-near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =         1.0f /  fmn;
+	dst->t.z =         near / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float bmt    = bottom-top;
+	float fmn    = far-near;
+	float nearx2 = 2.0f*near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =       nearx2 / rml;
+	dst->z.x = (left+right) / -rml;
+
+	dst->y.y =       nearx2 / -bmt;
+	dst->z.y = (bottom+top) / bmt;
+
+	dst->z.z =          far / fmn;
+	dst->t.z = (near * far) / -fmn;
+
+	dst->z.w = 1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	gs_texture_destroy(swapchain->target);
+	bfree(swapchain);
+}
+
+#ifdef _WIN32
+
+EXPORT bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+EXPORT bool device_shared_texture_available(void)
+{
+	return false;
+}
+
+#endif
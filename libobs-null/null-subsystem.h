@@ -0,0 +1,197 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+#include <graphics/vec4.h>
+
+/*
+ * Null graphics subsystem.  Every resource lives in system memory and draws
+ * are rasterized on the CPU, so the render/convert/download pipeline can run
+ * without a GPU.  Shader code is not executed: pixel shaders are recognized
+ * by the function the effect pass calls, and the ones libobs itself uses
+ * (default, opaque, solid, scaling and format conversion effects) are
+ * emulated.  Anything else samples its "image" texture if it has one.
+ */
+
+enum null_pixel_func {
+	NULL_PS_UNKNOWN,
+	NULL_PS_DRAW_BARE,
+	NULL_PS_DRAW_OPAQUE,
+	NULL_PS_DRAW_MATRIX,
+	NULL_PS_SOLID,
+	NULL_PS_SOLID_COLORED,
+	NULL_PS_NV12,
+	NULL_PS_NV12_LINEWISE,
+	NULL_PS_PLANAR420,
+	NULL_PS_PLANAR444,
+	NULL_PS_PACKED422_REVERSE,
+	NULL_PS_PLANAR420_REVERSE,
+	NULL_PS_NV12_REVERSE
+};
+
+struct gs_sampler_state {
+	gs_device_t            *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char                 *name;
+	gs_shader_t          *shader;
+	gs_samplerstate_t    *next_sampler;
+	gs_samplerstate_t    *sampler;
+	int                  array_count;
+
+	struct gs_texture    *texture;
+
+	DARRAY(uint8_t)      cur_value;
+	DARRAY(uint8_t)      def_value;
+};
+
+struct gs_shader {
+	gs_device_t          *device;
+	enum gs_shader_type  type;
+
+	enum null_pixel_func func;
+	int                  func_args[4];
+
+	struct gs_shader_param  *viewproj;
+	struct gs_shader_param  *world;
+
+	DARRAY(struct gs_shader_param) params;
+	DARRAY(gs_samplerstate_t*)      samplers;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	bool                 dynamic;
+	struct gs_vb_data    *data;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	size_t               width;
+	bool                 dynamic;
+};
+
+/* cube textures keep their six faces one after another in data */
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint32_t             levels;
+	bool                 is_dynamic;
+	bool                 is_render_target;
+
+	uint8_t              *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t             *device;
+	uint32_t                width;
+	uint32_t                height;
+	enum gs_zstencil_format format;
+};
+
+struct gs_swap_chain {
+	gs_device_t          *device;
+	struct gs_init_data  info;
+	gs_texture_t         *target;
+};
+
+struct gs_device {
+	gs_texture_t         *cur_render_target;
+	int                  cur_render_side;
+	gs_zstencil_t        *cur_zstencil_buffer;
+	gs_texture_t         *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t    *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t      *cur_vertex_buffer;
+	gs_indexbuffer_t     *cur_index_buffer;
+	gs_shader_t          *cur_vertex_shader;
+	gs_shader_t          *cur_pixel_shader;
+	gs_swapchain_t       *cur_swap;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_rect       cur_viewport;
+	struct gs_rect       cur_scissor;
+	bool                 scissor_enabled;
+
+	bool                 blend_enabled;
+	enum gs_blend_type   blend_src_c;
+	enum gs_blend_type   blend_dest_c;
+	enum gs_blend_type   blend_src_a;
+	enum gs_blend_type   blend_dest_a;
+	bool                 color_mask[4];
+
+	struct matrix4       cur_proj;
+	struct matrix4       cur_view;
+	struct matrix4       cur_viewproj;
+
+	DARRAY(struct matrix4) proj_stack;
+
+	struct gs_sampler_info default_sampler;
+};
+
+/* rows are padded to 4 bytes, like the unpack buffers of the GL backend */
+static inline uint32_t null_get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	uint32_t linesize = (width * gs_get_format_bpp(format) + 7) / 8;
+	return (linesize + 3) & 0xFFFFFFFC;
+}
+
+static inline uint8_t *null_texture_face(const struct gs_texture *tex,
+		int side)
+{
+	return tex->data + (size_t)tex->linesize * tex->height * side;
+}
+
+extern void null_read_texel(enum gs_color_format format, const uint8_t *ptr,
+		struct vec4 *val);
+extern void null_write_texel(enum gs_color_format format, uint8_t *ptr,
+		const struct vec4 *val);
+
+extern gs_texture_t *null_texture_create(gs_device_t *device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		enum gs_color_format format, uint32_t levels,
+		const uint8_t **data, uint32_t flags);
+
+extern gs_texture_t *null_get_target(const gs_device_t *device);
+
+extern void null_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts);
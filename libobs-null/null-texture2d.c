@@ -0,0 +1,489 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <util/bmem.h>
+#include "null-subsystem.h"
+
+/* ------------------------------------------------------------------------- */
+/* texel conversion */
+
+static float half_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp  = (h >> 10) & 0x1F;
+	uint32_t mant = h & 0x3FF;
+	uint32_t bits;
+	float    val;
+
+	if (exp == 0) {
+		val = ldexpf((float)mant, -24);
+		return sign ? -val : val;
+	} else if (exp == 31) {
+		bits = sign | 0x7F800000 | (mant << 13);
+	} else {
+		bits = sign | ((exp + 112) << 23) | (mant << 13);
+	}
+
+	memcpy(&val, &bits, sizeof(val));
+	return val;
+}
+
+static uint16_t float_to_half(float val)
+{
+	uint32_t bits;
+	uint32_t sign;
+	int      exp;
+
+	memcpy(&bits, &val, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	exp  = (int)((bits >> 23) & 0xFF) - 127 + 15;
+
+	/* subnormals are flushed to zero and NaN becomes infinity */
+	if (exp <= 0)
+		return (uint16_t)sign;
+	if (exp >= 31)
+		return (uint16_t)(sign | 0x7C00);
+
+	/* a rounding carry out of the mantissa correctly bumps the exponent */
+	return (uint16_t)(sign + ((uint32_t)exp << 10) +
+			(((bits & 0x7FFFFF) + 0x1000) >> 13));
+}
+
+static inline float unorm(uint32_t val, float max)
+{
+	return (float)val / max;
+}
+
+static inline uint32_t to_unorm(float val, float max)
+{
+	if (!(val > 0.0f))
+		return 0;
+	if (val >= 1.0f)
+		return (uint32_t)max;
+	return (uint32_t)(val * max + 0.5f);
+}
+
+void null_read_texel(enum gs_color_format format, const uint8_t *ptr,
+		struct vec4 *val)
+{
+	const uint16_t *p16 = (const uint16_t*)ptr;
+	const float    *pf  = (const float*)ptr;
+	uint32_t       packed;
+
+	switch (format) {
+	case GS_A8:
+		vec4_set(val, 0.0f, 0.0f, 0.0f, unorm(ptr[0], 255.0f));
+		break;
+	case GS_R8:
+		vec4_set(val, unorm(ptr[0], 255.0f), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_RGBA:
+		vec4_set(val, unorm(ptr[0], 255.0f), unorm(ptr[1], 255.0f),
+				unorm(ptr[2], 255.0f), unorm(ptr[3], 255.0f));
+		break;
+	case GS_BGRX:
+		vec4_set(val, unorm(ptr[2], 255.0f), unorm(ptr[1], 255.0f),
+				unorm(ptr[0], 255.0f), 1.0f);
+		break;
+	case GS_BGRA:
+		vec4_set(val, unorm(ptr[2], 255.0f), unorm(ptr[1], 255.0f),
+				unorm(ptr[0], 255.0f), unorm(ptr[3], 255.0f));
+		break;
+	case GS_R10G10B10A2:
+		memcpy(&packed, ptr, sizeof(packed));
+		vec4_set(val,
+				unorm(packed & 0x3FF, 1023.0f),
+				unorm((packed >> 10) & 0x3FF, 1023.0f),
+				unorm((packed >> 20) & 0x3FF, 1023.0f),
+				unorm(packed >> 30, 3.0f));
+		break;
+	case GS_RGBA16:
+		vec4_set(val, unorm(p16[0], 65535.0f), unorm(p16[1], 65535.0f),
+				unorm(p16[2], 65535.0f),
+				unorm(p16[3], 65535.0f));
+		break;
+	case GS_R16:
+		vec4_set(val, unorm(p16[0], 65535.0f), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_RGBA16F:
+		vec4_set(val, half_to_float(p16[0]), half_to_float(p16[1]),
+				half_to_float(p16[2]), half_to_float(p16[3]));
+		break;
+	case GS_RGBA32F:
+		vec4_set(val, pf[0], pf[1], pf[2], pf[3]);
+		break;
+	case GS_RG16F:
+		vec4_set(val, half_to_float(p16[0]), half_to_float(p16[1]),
+				0.0f, 1.0f);
+		break;
+	case GS_RG32F:
+		vec4_set(val, pf[0], pf[1], 0.0f, 1.0f);
+		break;
+	case GS_R16F:
+		vec4_set(val, half_to_float(p16[0]), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_R32F:
+		vec4_set(val, pf[0], 0.0f, 0.0f, 1.0f);
+		break;
+
+	/* block compressed textures are stored, but not decoded */
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		vec4_zero(val);
+		break;
+	}
+}
+
+void null_write_texel(enum gs_color_format format, uint8_t *ptr,
+		const struct vec4 *val)
+{
+	uint16_t *p16 = (uint16_t*)ptr;
+	float    *pf  = (float*)ptr;
+	uint32_t packed;
+
+	switch (format) {
+	case GS_A8:
+		ptr[0] = (uint8_t)to_unorm(val->w, 255.0f);
+		break;
+	case GS_R8:
+		ptr[0] = (uint8_t)to_unorm(val->x, 255.0f);
+		break;
+	case GS_RGBA:
+		ptr[0] = (uint8_t)to_unorm(val->x, 255.0f);
+		ptr[1] = (uint8_t)to_unorm(val->y, 255.0f);
+		ptr[2] = (uint8_t)to_unorm(val->z, 255.0f);
+		ptr[3] = (uint8_t)to_unorm(val->w, 255.0f);
+		break;
+	case GS_BGRX:
+	case GS_BGRA:
+		ptr[0] = (uint8_t)to_unorm(val->z, 255.0f);
+		ptr[1] = (uint8_t)to_unorm(val->y, 255.0f);
+		ptr[2] = (uint8_t)to_unorm(val->x, 255.0f);
+		ptr[3] = format == GS_BGRX ? 0xFF :
+			(uint8_t)to_unorm(val->w, 255.0f);
+		break;
+	case GS_R10G10B10A2:
+		packed =  to_unorm(val->x, 1023.0f)        |
+			 (to_unorm(val->y, 1023.0f) << 10) |
+			 (to_unorm(val->z, 1023.0f) << 20) |
+			 (to_unorm(val->w, 3.0f)    << 30);
+		memcpy(ptr, &packed, sizeof(packed));
+		break;
+	case GS_RGBA16:
+		p16[0] = (uint16_t)to_unorm(val->x, 65535.0f);
+		p16[1] = (uint16_t)to_unorm(val->y, 65535.0f);
+		p16[2] = (uint16_t)to_unorm(val->z, 65535.0f);
+		p16[3] = (uint16_t)to_unorm(val->w, 65535.0f);
+		break;
+	case GS_R16:
+		p16[0] = (uint16_t)to_unorm(val->x, 65535.0f);
+		break;
+	case GS_RGBA16F:
+		p16[0] = float_to_half(val->x);
+		p16[1] = float_to_half(val->y);
+		p16[2] = float_to_half(val->z);
+		p16[3] = float_to_half(val->w);
+		break;
+	case GS_RGBA32F:
+		pf[0] = val->x;
+		pf[1] = val->y;
+		pf[2] = val->z;
+		pf[3] = val->w;
+		break;
+	case GS_RG16F:
+		p16[0] = float_to_half(val->x);
+		p16[1] = float_to_half(val->y);
+		break;
+	case GS_RG32F:
+		pf[0] = val->x;
+		pf[1] = val->y;
+		break;
+	case GS_R16F:
+		p16[0] = float_to_half(val->x);
+		break;
+	case GS_R32F:
+		pf[0] = val->x;
+		break;
+
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* textures */
+
+gs_texture_t *null_texture_create(gs_device_t *device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		enum gs_color_format format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex;
+	size_t            face_size;
+	int               faces = type == GS_TEXTURE_CUBE ? 6 : 1;
+
+	if (!width || !height || format == GS_UNKNOWN)
+		return NULL;
+
+	tex = bzalloc(sizeof(struct gs_texture));
+	tex->device           = device;
+	tex->type             = type;
+	tex->format           = format;
+	tex->width            = width;
+	tex->height           = height;
+	tex->linesize         = null_get_linesize(format, width);
+	tex->levels           = levels;
+	tex->is_dynamic       = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+
+	face_size = (size_t)tex->linesize * height;
+	tex->data = bzalloc(face_size * faces);
+
+	/* only the top mip level is kept, the rest of the chain is skipped */
+	if (data) {
+		uint32_t src_linesize = (width * gs_get_format_bpp(format) + 7) / 8;
+		uint32_t num_levels = levels ? levels :
+			gs_get_total_levels(width, height);
+		if (!num_levels)
+			num_levels = 1;
+
+		for (int side = 0; side < faces; side++) {
+			const uint8_t *src = data[side * num_levels];
+			uint8_t       *dst = null_texture_face(tex, side);
+
+			if (!src)
+				continue;
+
+			for (uint32_t y = 0; y < height; y++)
+				memcpy(dst + (size_t)tex->linesize * y,
+						src + (size_t)src_linesize * y,
+						src_linesize);
+		}
+	}
+
+	return tex;
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	gs_texture_t *tex = null_texture_create(device, GS_TEXTURE_2D, width,
+			height, color_format, levels, data, flags);
+	if (!tex)
+		blog(LOG_ERROR, "device_texture_create (null) failed");
+	return tex;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	gs_texture_t *tex = null_texture_create(device, GS_TEXTURE_CUBE, size,
+			size, color_format, levels, data, flags);
+	if (!tex)
+		blog(LOG_ERROR, "device_cubetexture_create (null) failed");
+	return tex;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	/* not supported by the GL backend either */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->type == GS_TEXTURE_2D ? tex->width : 0;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->type == GS_TEXTURE_2D ? tex->height : 0;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (tex->type != GS_TEXTURE_2D || !tex->is_dynamic) {
+		blog(LOG_ERROR, "gs_texture_map (null) failed: texture is "
+		                "not a dynamic 2D texture");
+		return false;
+	}
+
+	*ptr      = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	gs_texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	return cubetex->type == GS_TEXTURE_CUBE ? cubetex->width : 0;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	gs_texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(
+		const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+/* stage surfaces */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device,
+		uint32_t width, uint32_t height,
+		enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf;
+
+	if (!width || !height || color_format == GS_UNKNOWN) {
+		blog(LOG_ERROR, "device_stagesurface_create (null) failed");
+		return NULL;
+	}
+
+	surf = bzalloc(sizeof(struct gs_stage_surface));
+	surf->device   = device;
+	surf->format   = color_format;
+	surf->width    = width;
+	surf->height   = height;
+	surf->linesize = null_get_linesize(color_format, width);
+	surf->data     = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	bfree(stagesurf->data);
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format gs_stagesurface_get_color_format(
+		const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	*data     = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* copies are done synchronously, so staged data is always ready */
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+	return true;
+}
@@ -65,9 +65,35 @@ gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
 	return surf;
 }
 
+static inline bool fences_available(void)
+{
+	return GLAD_GL_VERSION_3_2 || GLAD_GL_ARB_sync;
+}
+
+static void delete_fence(struct gs_stage_surface *surf)
+{
+	if (surf->sync) {
+		glDeleteSync(surf->sync);
+		surf->sync = NULL;
+	}
+}
+
+/* inserted after each readback so gs_stagesurface_ready can tell whether
+ * mapping the pack buffer would wait on the GPU */
+static void insert_fence(struct gs_stage_surface *surf)
+{
+	if (!fences_available())
+		return;
+
+	delete_fence(surf);
+	surf->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	gl_success("glFenceSync");
+}
+
 void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 {
 	if (stagesurf) {
+		delete_fence(stagesurf);
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
 
@@ -141,6 +167,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	insert_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -172,6 +199,8 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	insert_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -222,6 +251,22 @@ fail:
 	return false;
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	GLenum status;
+
+	if (!stagesurf->sync)
+		return true;
+
+	status = glClientWaitSync(stagesurf->sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+			0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	delete_fence(stagesurf);
+	return true;
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
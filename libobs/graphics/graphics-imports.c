@@ -135,6 +135,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_stagesurface_get_color_format);
 	GRAPHICS_IMPORT(gs_stagesurface_map);
 	GRAPHICS_IMPORT(gs_stagesurface_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_stagesurface_ready);
 
 	GRAPHICS_IMPORT(gs_zstencil_destroy);
 
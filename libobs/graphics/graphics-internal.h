@@ -184,6 +184,7 @@ struct gs_exports {
 	bool     (*gs_stagesurface_map)(gs_stagesurf_t *stagesurf,
 			uint8_t **data, uint32_t *linesize);
 	void     (*gs_stagesurface_unmap)(gs_stagesurf_t *stagesurf);
+	bool     (*gs_stagesurface_ready)(gs_stagesurf_t *stagesurf);
 
 	void (*gs_zstencil_destroy)(gs_zstencil_t *zstencil);
 
@@ -449,6 +449,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_NULL        3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -711,6 +712,13 @@ EXPORT bool     gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize);
 EXPORT void     gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/**
+ * Returns true once the last copy staged to the surface has completed, so
+ * that mapping it will not wait on the GPU.  Always returns true on devices
+ * that can't tell.
+ */
+EXPORT bool     gs_stagesurface_ready(gs_stagesurf_t *stagesurf);
+
 EXPORT void     gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void     gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
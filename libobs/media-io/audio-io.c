@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <math.h>
+#include <limits.h>
 #include <inttypes.h>
 
 #include "../util/threading.h"
@@ -23,9 +24,13 @@
 #include "../util/circlebuf.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
+#include "../util/cpu-features.h"
 
 #include "audio-io.h"
 #include "audio-resampler.h"
+#include "audio-mix-avx.h"
+
+#include <xmmintrin.h>
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
@@ -46,13 +51,52 @@ static inline void audio_input_free(struct audio_input *input)
 	audio_resampler_destroy(input->resampler);
 }
 
+/* number of packets a line can hold until the audio thread picks them up.
+ * the audio thread empties the rings every time it mixes (every 25 ms at
+ * most unless it's stalled), which most sources fill with a few packets of
+ * 10-20 ms each.  every slot keeps its buffers, so this stays small; sources
+ * sending smaller packets (e.g. 64 frames from JACK) spill over into the
+ * line's overflow queue */
+#define AUDIO_LINE_RING_SIZE 16
+
+/* a packet as given to audio_line_output, with the volume already applied */
+struct audio_line_packet {
+	DARRAY(uint8_t)            data[MAX_AV_PLANES];
+	uint32_t                   frames;
+	uint64_t                   timestamp;
+};
+
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
+
+	/* single producer (the thread calling audio_line_output), single
+	 * consumer (the audio thread) ring of packets.  a slot belongs to the
+	 * audio thread while it's counted in ring_count, and to the producer
+	 * otherwise, so neither side ever waits on the other */
+	struct audio_line_packet   ring[AUDIO_LINE_RING_SIZE];
+	size_t                     ring_write_idx;
+	size_t                     ring_read_idx;
+	volatile long              ring_count;
+
+	/* packets that didn't fit into the ring.  once a packet is queued
+	 * here, the following ones are too until the audio thread takes them,
+	 * so they stay in order.  the queue is limited to the maximum
+	 * buffering time, its slots keep their buffers like the ring's */
+	pthread_mutex_t            overflow_mutex;
+	DARRAY(struct audio_line_packet) overflow;
+	size_t                     overflow_used;
+	uint64_t                   overflow_frames;
+	volatile long              overflow_count;
+
+	/* set by the producer when the overflow queue was full and packets
+	 * had to be dropped */
+	bool                       ring_full;
+	volatile long              ring_dropped_frames;
+
+	/* everything below belongs to the audio thread */
 	struct circlebuf           buffers[MAX_AV_PLANES];
-	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 	uint64_t                   required_buffering;
@@ -64,9 +108,12 @@ struct audio_line {
 	/* specifies which mixes this line applies to via bits */
 	uint32_t                   mixers;
 
+	/* mixes the line was added to during the current mix */
+	uint32_t                   mixed_mask;
+
 	/* states whether this line is still being used.  if not, then when the
 	 * buffer is depleted, it's destroyed */
-	bool                       alive;
+	volatile bool              alive;
 
 	/* gets set when audio is getting cut off in the front of the buffer */
 	bool                       audio_getting_cut_off;
@@ -75,18 +122,41 @@ struct audio_line {
 	 * the circular buffer */
 	bool                       audio_data_out_of_bounds;
 
+	/* counted by whichever thread mixes the line, and published to stats
+	 * by the audio thread under the output's stats_mutex */
+	uint64_t                   smoothed_timestamps;
+	uint64_t                   max_ts_correction;
+	uint64_t                   tick_ts_correction;
+	uint64_t                   out_of_bounds_frames;
+	uint64_t                   cut_off_frames;
+	struct audio_line_stats    stats;
+
+	const char                 *buffered_name;
+	const char                 *required_name;
+	const char                 *ts_correction_name;
+	const char                 *dropped_name;
+
 	struct audio_line          **prev_next;
 	struct audio_line          *next;
 };
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
+
+	for (size_t i = 0; i < AUDIO_LINE_RING_SIZE; i++) {
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			da_free(line->ring[i].data[j]);
+	}
+
+	for (size_t i = 0; i < line->overflow.num; i++) {
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			da_free(line->overflow.array[i].data[j]);
 	}
 
-	pthread_mutex_destroy(&line->mutex);
+	da_free(line->overflow);
+	pthread_mutex_destroy(&line->overflow_mutex);
 	bfree(line->name);
 	bfree(line);
 }
@@ -96,6 +166,63 @@ struct audio_mix {
 	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
 };
 
+/* where the planes of each mix are being mixed to */
+struct audio_mix_dest {
+	float                      *data[MAX_AUDIO_MIXES][MAX_AV_PLANES];
+};
+
+/* ------------------------------------------------------------------------- */
+/* mix thread pool */
+
+#define MAX_AUDIO_MIX_THREADS 16
+
+enum audio_mix_task_type {
+	AUDIO_MIX_TASK_MIX,
+	AUDIO_MIX_TASK_REDUCE,
+	AUDIO_MIX_TASK_OUTPUT
+};
+
+enum audio_mix_task_state {
+	AUDIO_MIX_TASK_PENDING,
+	AUDIO_MIX_TASK_RUNNING,
+	AUDIO_MIX_TASK_CANCELED
+};
+
+/* mixing a chunk of lines, adding the chunks to a range of samples of one
+ * mix plane, or outputting a mix to one input.  output tasks work on a copy
+ * of the input, so inputs can be connected while the mix threads output,
+ * and are canceled if their input is disconnected before they start */
+struct audio_mix_task {
+	enum audio_mix_task_type   type;
+	size_t                     chunk;
+	size_t                     mix_idx;
+	size_t                     plane;
+	size_t                     start;
+	size_t                     end;
+	struct audio_input         input;
+	volatile long              state;
+	uint64_t                   output_ns;
+};
+
+/* a contiguous range of lines, mixed into buffers of its own */
+struct audio_mix_chunk {
+	size_t                     first_line;
+	size_t                     end_line;
+	uint32_t                   mixed_mask;
+	DARRAY(uint8_t)            buffers[MAX_AUDIO_MIXES][MAX_AV_PLANES];
+};
+
+struct audio_mix_pool {
+	DARRAY(pthread_t)              threads;
+	os_sem_t                       *work_sem;
+	os_sem_t                       *done_sem;
+	volatile bool                  stop;
+
+	DARRAY(struct audio_mix_chunk) chunks;
+	DARRAY(struct audio_mix_task)  tasks;
+	volatile long                  next_task;
+};
+
 struct audio_output {
 	struct audio_output_info   info;
 	size_t                     block_size;
@@ -105,6 +232,13 @@ struct audio_output {
 	pthread_t                  thread;
 	os_event_t                 *stop_event;
 
+	uint64_t                   tick_ns;
+	volatile long              ticks;
+	volatile long              late_ticks;
+	volatile long              skipped_ticks;
+	volatile long              last_tick_error_us;
+	volatile long              max_tick_error_us;
+
 	bool                       initialized;
 
 	bool                       catching_up;
@@ -118,7 +252,34 @@ struct audio_output {
 
 	pthread_mutex_t            input_mutex;
 
+	/* set while the mix threads output without holding input_mutex.
+	 * disconnects made by other threads wait for output_idle_event, the
+	 * mix threads themselves can't, so the inputs they disconnect are only
+	 * freed once every output task is done */
+	bool                       outputting;
+	os_event_t                 *output_idle_event;
+	DARRAY(struct audio_input) removed_inputs;
+
 	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+
+	/* the mix in progress, shared with the mix threads */
+	DARRAY(struct audio_line*) mix_lines;
+	size_t                     mix_bytes;
+	uint32_t                   mix_frames;
+	uint64_t                   mix_timestamp;
+	uint64_t                   mix_end_time;
+	uint32_t                   active_mixes;
+	uint32_t                   mix_inputs[MAX_AUDIO_MIXES];
+	uint64_t                   mix_output_ns[MAX_AUDIO_MIXES];
+
+	struct audio_mix_pool      mix_pool;
+
+	/* published once per mix by the audio thread */
+	pthread_mutex_t            stats_mutex;
+	struct audio_output_stats  stats;
+	struct audio_mix_stats     mix_stats[MAX_AUDIO_MIXES];
+
+	const char                 *output_mix_names[MAX_AUDIO_MIXES];
 };
 
 static inline void audio_output_removeline(struct audio_output *audio,
@@ -201,6 +362,10 @@ static inline void clear_excess_audio_data(struct audio_line *line,
 		size_t clear_size = (size < line->buffers[i].size) ?
 			size : line->buffers[i].size;
 
+		if (i == 0)
+			line->cut_off_frames += clear_size /
+				line->audio->block_size;
+
 		circlebuf_pop_front(&line->buffers[i], NULL, clear_size);
 	}
 }
@@ -220,43 +385,157 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-#define MIX_BUFFER_SIZE 256
+/* ------------------------------------------------------------------------- */
+/* mixing kernels.  each line is added to every mix it's enabled in with a
+ * single pass over its data, and the last line added to a mix clamps the
+ * result to -1.0..1.0 while storing it, so the mixes don't need a separate
+ * clamping pass.  SSE is always available, AVX is used when the CPU and OS
+ * support it */
+
+/* the operand order keeps NaNs the same as the scalar clamp */
+static inline __m128 clamp_ps(__m128 val, __m128 min_val, __m128 max_val)
+{
+	return _mm_max_ps(min_val, _mm_min_ps(max_val, val));
+}
+
+static inline float clamp_float(float val)
+{
+	val = (val >  1.0f) ?  1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
 
-/* TODO: optimize mixing */
-static void mix_float(struct audio_output *audio, struct audio_line *line,
-		size_t size, size_t time_offset, size_t plane)
+static void mix_float(float *const mixes[], size_t num_add, size_t num_clamp,
+		const float *src, size_t count)
 {
-	float *mixes[MAX_AUDIO_MIXES];
-	float vals[MIX_BUFFER_SIZE];
+	size_t num_mixes = num_add + num_clamp;
+	size_t i         = 0;
+	size_t end       = count & ~(size_t)3;
+
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	__m128 max_val = _mm_set1_ps(1.0f);
+
+	if (os_cpu_has_avx())
+		i = mix_float_avx(mixes, num_add, num_clamp, src, count);
+
+	for (; i < end; i += 4) {
+		__m128 val = _mm_loadu_ps(src + i);
+		size_t mix_idx = 0;
+
+		for (; mix_idx < num_add; mix_idx++) {
+			float *dst = mixes[mix_idx] + i;
+			_mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), val));
+		}
+
+		for (; mix_idx < num_mixes; mix_idx++) {
+			float *dst = mixes[mix_idx] + i;
+			__m128 sum = _mm_add_ps(_mm_loadu_ps(dst), val);
+			_mm_storeu_ps(dst, clamp_ps(sum, min_val, max_val));
+		}
+	}
 
+	for (; i < count; i++) {
+		size_t mix_idx = 0;
+
+		for (; mix_idx < num_add; mix_idx++)
+			mixes[mix_idx][i] += src[i];
+		for (; mix_idx < num_mixes; mix_idx++)
+			mixes[mix_idx][i] = clamp_float(mixes[mix_idx][i] +
+					src[i]);
+	}
+}
+
+static void clamp_float_array(float *data, size_t count)
+{
+	size_t i   = 0;
+	size_t end = count & ~(size_t)3;
+
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	__m128 max_val = _mm_set1_ps(1.0f);
+
+	if (os_cpu_has_avx())
+		i = clamp_float_avx(data, count);
+
+	for (; i < end; i += 4) {
+		__m128 val = _mm_loadu_ps(data + i);
+		_mm_storeu_ps(data + i, clamp_ps(val, min_val, max_val));
+	}
+
+	for (; i < count; i++)
+		data[i] = clamp_float(data[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline float *mix_plane_data(struct audio_output *audio,
+		size_t mix_idx, size_t plane)
+{
+	return (float*)audio->mixes[mix_idx].mix_buffers[plane].array;
+}
+
+/* clamps the parts of the mix around the span the last line was added to */
+static inline void clamp_mix_outside(float *data, size_t total,
+		size_t start, size_t count)
+{
+	clamp_float_array(data, start);
+	clamp_float_array(data + start + count, total - start - count);
+}
+
+static void mix_line_plane(struct audio_line *line, struct audio_mix_dest *dest,
+		size_t plane, size_t size, size_t time_offset, size_t total_size,
+		uint32_t mix_mask, uint32_t clamp_mask)
+{
+	struct circlebuf *buf = &line->buffers[plane];
+	float  *mixes[MAX_AUDIO_MIXES];
+	size_t num_add       = 0;
+	size_t num_clamp     = 0;
+	size_t start_sample  = time_offset / sizeof(float);
+	size_t count         = size / sizeof(float);
+	size_t total_samples = total_size / sizeof(float);
+
+	/* mixes that are clamped go after the ones that are only added to */
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mix_mask & (1 << mix_idx)) == 0)
+			continue;
+		if ((clamp_mask & (1 << mix_idx)) == 0)
+			mixes[num_add++] = dest->data[mix_idx][plane];
+	}
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		uint8_t *bytes = audio->mixes[mix_idx].mix_buffers[plane].array;
-		mixes[mix_idx] = (float*)&bytes[time_offset];
+		if ((clamp_mask & (1 << mix_idx)) == 0)
+			continue;
+
+		float *data = dest->data[mix_idx][plane];
+		clamp_mix_outside(data, total_samples, start_sample, count);
+		mixes[num_add + num_clamp++] = data;
 	}
 
+	for (size_t i = 0; i < num_add + num_clamp; i++)
+		mixes[i] += start_sample;
+
+	/* mix straight out of the circular buffer, which has at most two
+	 * contiguous regions */
 	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+		uint8_t *data = (uint8_t*)buf->data + buf->start_pos;
+		size_t region = min_size(size, buf->capacity - buf->start_pos);
+		size_t region_count = region / sizeof(float);
 
-		circlebuf_pop_front(&line->buffers[plane], vals, pop_count);
-		pop_count /= sizeof(float);
+		mix_float(mixes, num_add, num_clamp, (const float*)data,
+				region_count);
 
-		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-			/* only include this audio line in this mix if it's set
-			 * via the line's 'mixes' variable */
-			if ((line->mixers & (1 << mix_idx)) == 0)
-				continue;
+		for (size_t i = 0; i < num_add + num_clamp; i++)
+			mixes[i] += region_count;
 
-			for (size_t i = 0; i < pop_count; i++) {
-				*(mixes[mix_idx]++) += vals[i];
-			}
-		}
+		circlebuf_pop_front(buf, NULL, region);
+		size -= region;
 	}
 }
 
 static inline bool mix_audio_line(struct audio_output *audio,
-		struct audio_line *line, size_t size, uint64_t timestamp)
+		struct audio_line *line, struct audio_mix_dest *dest,
+		size_t size, uint64_t timestamp,
+		uint32_t mix_mask, uint32_t clamp_mask)
 {
+	size_t total_size = size;
 	size_t time_offset = (size_t)ts_diff_bytes(audio,
 			line->base_timestamp, timestamp);
 	if (time_offset > size)
@@ -271,7 +550,8 @@ static inline bool mix_audio_line(struct audio_output *audio,
 	for (size_t i = 0; i < audio->planes; i++) {
 		size_t pop_size = min_size(size, line->buffers[i].size);
 
-		mix_float(audio, line, pop_size, time_offset, i);
+		mix_line_plane(line, dest, i, pop_size, time_offset,
+				total_size, mix_mask, clamp_mask);
 	}
 
 	return true;
@@ -303,8 +583,10 @@ static bool resample_audio_output(struct audio_input *input,
 	return success;
 }
 
-static inline void do_audio_output(struct audio_output *audio,
-		size_t mix_idx, uint64_t timestamp, uint32_t frames)
+/* each input gets the mix as it is, not the previous input's resampled
+ * data */
+static void output_to_input(struct audio_output *audio, size_t mix_idx,
+		struct audio_input *input)
 {
 	struct audio_mix *mix = &audio->mixes[mix_idx];
 	struct audio_data data;
@@ -312,61 +594,603 @@ static inline void do_audio_output(struct audio_output *audio,
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		data.data[i] = mix->mix_buffers[i].array;
 
-	data.frames = frames;
-	data.timestamp = timestamp;
+	data.frames = audio->mix_frames;
+	data.timestamp = audio->mix_timestamp;
 	data.volume = 1.0f;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	if (resample_audio_output(input, &data))
+		input->callback(input->param, mix_idx, &data);
+}
+
+/* must be called with input_mutex locked */
+static inline void do_audio_output(struct audio_output *audio, size_t mix_idx)
+{
+	struct audio_mix *mix = &audio->mixes[mix_idx];
+
+	for (size_t i = mix->inputs.num; i > 0; i--)
+		output_to_input(audio, mix_idx, mix->inputs.array+(i-1));
+}
+
+/* clamps the mixes that no line was the last to be added to */
+static inline void clamp_audio_output(struct audio_output *audio, size_t bytes,
+		uint32_t mix_mask)
+{
+	size_t float_size = bytes / sizeof(float);
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mix_mask & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			clamp_float_array(mix_plane_data(audio, mix_idx, plane),
+					float_size);
+	}
+}
+
+/* alive is checked first, a line's last packet is queued before it's
+ * marked as no longer alive */
+static inline bool line_is_dead(struct audio_line *line)
+{
+	return !os_atomic_load_bool(&line->alive) &&
+	       !os_atomic_load_long(&line->ring_count) &&
+	       !os_atomic_load_long(&line->overflow_count) &&
+	       !line->buffers[0].size;
+}
+
+static void audio_line_insert(struct audio_line *line,
+		const struct audio_line_packet *packet);
+
+/* places every packet queued by the producer, then hands the slots back.
+ * packets in the overflow queue came after the ones in the ring */
+static void audio_line_drain(struct audio_line *line)
+{
+	long count = os_atomic_load_long(&line->ring_count);
+
+	while (count--) {
+		audio_line_insert(line, &line->ring[line->ring_read_idx]);
+
+		if (++line->ring_read_idx == AUDIO_LINE_RING_SIZE)
+			line->ring_read_idx = 0;
+
+		os_atomic_dec_long(&line->ring_count);
+	}
+
+	if (!os_atomic_load_long(&line->overflow_count))
+		return;
+
+	pthread_mutex_lock(&line->overflow_mutex);
+
+	for (size_t i = 0; i < line->overflow_used; i++)
+		audio_line_insert(line, line->overflow.array + i);
+
+	line->overflow_used   = 0;
+	line->overflow_frames = 0;
+	os_atomic_set_long(&line->overflow_count, 0);
+
+	pthread_mutex_unlock(&line->overflow_mutex);
+}
+
+static uint64_t round_to_ms(uint64_t ts)
+{
+	return (ts + 999999ULL) / 1000000ULL * 1000000ULL;
+}
+
+/* takes in the packets queued since the last mix and adds the line to dest,
+ * returns whether the line was mixed */
+static bool mix_line(struct audio_output *audio, struct audio_line *line,
+		struct audio_mix_dest *dest, uint32_t clamp_mask)
+{
+	uint64_t prev_time = audio->mix_timestamp;
+
+	audio_line_drain(line);
+
+	if (line->buffers[0].size && line->base_timestamp < prev_time) {
+		clear_excess_audio_data(line, prev_time);
+		line->base_timestamp = prev_time;
+
+	} else if (line->audio_getting_cut_off) {
+		line->audio_getting_cut_off = false;
+		blog(LOG_WARNING, "Audio line '%s' audio data no "
+		                  "longer getting cut off.",
+		                  line->name);
+	}
+
+	uint32_t mix_mask = line->mixers & audio->active_mixes;
 
-	for (size_t i = mix->inputs.num; i > 0; i--) {
-		struct audio_input *input = mix->inputs.array+(i-1);
+	if (mix_audio_line(audio, line, dest, audio->mix_bytes, prev_time,
+				mix_mask, clamp_mask & mix_mask)) {
+		line->base_timestamp = audio->mix_end_time;
+		line->mixed_mask = mix_mask;
+		return true;
+	}
+
+	line->mixed_mask = 0;
+	return false;
+}
+
+static inline void get_mix_dest(struct audio_output *audio,
+		struct audio_mix_dest *dest)
+{
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++)
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			dest->data[mix_idx][plane] =
+				mix_plane_data(audio, mix_idx, plane);
+}
+
+/* ------------------------------------------------------------------------- */
+/* serial mixing, the last line added to each mix clamps it */
+
+static void mix_lines_serial(struct audio_output *audio)
+{
+	struct audio_line *last_lines[MAX_AUDIO_MIXES] = {0};
+	struct audio_mix_dest dest;
+
+	get_mix_dest(audio, &dest);
+
+	for (size_t i = 0; i < audio->mix_lines.num; i++) {
+		struct audio_line *line = audio->mix_lines.array[i];
+
+		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+			if ((line->mixers & (1 << mix_idx)) != 0)
+				last_lines[mix_idx] = line;
+		}
+	}
+
+	/* cleared mixes are in range, and stay clamped as long as the last
+	 * line added to them clamped them */
+	uint32_t clamped_mixes = audio->active_mixes;
+
+	for (size_t i = 0; i < audio->mix_lines.num; i++) {
+		struct audio_line *line = audio->mix_lines.array[i];
+		uint32_t clamp_mask = 0;
+
+		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+			if (last_lines[mix_idx] == line)
+				clamp_mask |= 1 << mix_idx;
+		}
+
+		if (mix_line(audio, line, &dest, clamp_mask))
+			clamped_mixes = (clamped_mixes & ~line->mixed_mask) |
+				(clamp_mask & line->mixed_mask);
+	}
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, mix_idx, &data);
+	/* clamps audio data to -1.0..1.0 */
+	clamp_audio_output(audio, audio->mix_bytes,
+			audio->active_mixes & ~clamped_mixes);
+}
+
+static void output_serial(struct audio_output *audio)
+{
+	pthread_mutex_lock(&audio->input_mutex);
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if ((audio->active_mixes & (1 << i)) != 0) {
+			uint64_t start = os_gettime_ns();
+			do_audio_output(audio, i);
+			audio->mix_output_ns[i] = os_gettime_ns() - start;
+		}
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
-static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
+/* ------------------------------------------------------------------------- */
+/* parallel mixing.  the lines are split into one contiguous chunk per mix
+ * thread, each chunk is mixed into its own buffers, and the chunks are then
+ * added to the mixes in order while clamping.  which lines end up in which
+ * chunk, and the order everything is added in, only depend on the lines
+ * and the thread count, so the output doesn't depend on scheduling */
+
+/* samples per reduce task, so short mixes aren't split too finely */
+#define MIN_REDUCE_SAMPLES 1024
+
+static void mix_chunk(struct audio_output *audio, size_t chunk_idx)
 {
-	size_t float_size = bytes / sizeof(float);
+	struct audio_mix_chunk *chunk = audio->mix_pool.chunks.array+chunk_idx;
+	struct audio_mix_dest dest;
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		struct audio_mix *mix = &audio->mixes[mix_idx];
+	/* the first chunk is mixed straight into the mixes */
+	if (chunk_idx == 0) {
+		get_mix_dest(audio, &dest);
+	} else {
+		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+			if ((audio->active_mixes & (1 << mix_idx)) == 0)
+				continue;
 
-		/* do not process mixing if a specific mix is inactive */
-		if (!mix->inputs.num)
+			for (size_t plane = 0; plane < audio->planes; plane++) {
+				da_resize(chunk->buffers[mix_idx][plane],
+						audio->mix_bytes);
+				memset(chunk->buffers[mix_idx][plane].array, 0,
+						audio->mix_bytes);
+				dest.data[mix_idx][plane] = (float*)
+					chunk->buffers[mix_idx][plane].array;
+			}
+		}
+	}
+
+	chunk->mixed_mask = 0;
+
+	for (size_t i = chunk->first_line; i < chunk->end_line; i++) {
+		struct audio_line *line = audio->mix_lines.array[i];
+
+		if (mix_line(audio, line, &dest, 0))
+			chunk->mixed_mask |= line->mixed_mask;
+	}
+}
+
+static void reduce_chunks(struct audio_output *audio,
+		const struct audio_mix_task *task)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	float  *mix   = mix_plane_data(audio, task->mix_idx, task->plane) +
+		task->start;
+	size_t count  = task->end - task->start;
+	size_t last   = 0;
+
+	for (size_t i = 1; i < pool->chunks.num; i++) {
+		if (pool->chunks.array[i].mixed_mask & (1 << task->mix_idx))
+			last = i;
+	}
+
+	if (!last) {
+		clamp_float_array(mix, count);
+		return;
+	}
+
+	for (size_t i = 1; i <= last; i++) {
+		struct audio_mix_chunk *chunk = pool->chunks.array+i;
+		float *src;
+
+		if ((chunk->mixed_mask & (1 << task->mix_idx)) == 0)
 			continue;
 
+		src = (float*)chunk->buffers[task->mix_idx][task->plane].array +
+			task->start;
+		mix_float(&mix, i == last ? 0 : 1, i == last ? 1 : 0,
+				src, count);
+	}
+}
+
+static void run_mix_task(struct audio_output *audio,
+		struct audio_mix_task *task)
+{
+	uint64_t start;
+
+	switch (task->type) {
+	case AUDIO_MIX_TASK_MIX:
+		mix_chunk(audio, task->chunk);
+		break;
+	case AUDIO_MIX_TASK_REDUCE:
+		reduce_chunks(audio, task);
+		break;
+	case AUDIO_MIX_TASK_OUTPUT:
+		if (!os_atomic_compare_swap_long(&task->state,
+					AUDIO_MIX_TASK_PENDING,
+					AUDIO_MIX_TASK_RUNNING))
+			break;
+
+		start = os_gettime_ns();
+		output_to_input(audio, task->mix_idx, &task->input);
+		task->output_ns = os_gettime_ns() - start;
+		break;
+	}
+}
+
+static void run_mix_tasks(struct audio_output *audio)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	long num = (long)pool->tasks.num;
+	long i;
+
+	while ((i = os_atomic_inc_long(&pool->next_task) - 1) < num)
+		run_mix_task(audio, pool->tasks.array + i);
+}
+
+static void *mix_thread(void *param)
+{
+	struct audio_output *audio = param;
+	struct audio_mix_pool *pool = &audio->mix_pool;
+
+	os_set_thread_name("audio-io: mix thread");
+
+	while (os_sem_wait(pool->work_sem) == 0) {
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		run_mix_tasks(audio);
+		os_sem_post(pool->done_sem);
+	}
+
+	return NULL;
+}
+
+/* the audio thread runs tasks alongside the mix threads and returns once
+ * every task is done */
+static void mix_tasks(struct audio_output *audio)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	size_t workers = pool->tasks.num > 1 ? pool->threads.num : 0;
+
+	os_atomic_set_long(&pool->next_task, 0);
+
+	for (size_t i = 0; i < workers; i++)
+		os_sem_post(pool->work_sem);
+
+	run_mix_tasks(audio);
+
+	for (size_t i = 0; i < workers; i++)
+		os_sem_wait(pool->done_sem);
+}
+
+static void mix_lines_parallel(struct audio_output *audio)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	struct audio_mix_task task = {0};
+	size_t num_lines  = audio->mix_lines.num;
+	size_t num_chunks = pool->threads.num + 1;
+	size_t samples    = audio->mix_bytes / sizeof(float);
+	size_t band       = (samples + num_chunks - 1) / num_chunks;
+
+	if (num_chunks > num_lines)
+		num_chunks = num_lines ? num_lines : 1;
+
+	da_resize(pool->chunks, num_chunks);
+	da_resize(pool->tasks, 0);
+
+	task.type = AUDIO_MIX_TASK_MIX;
+	for (size_t i = 0; i < num_chunks; i++) {
+		pool->chunks.array[i].first_line = i * num_lines / num_chunks;
+		pool->chunks.array[i].end_line = (i + 1) * num_lines /
+			num_chunks;
+
+		task.chunk = i;
+		da_push_back(pool->tasks, &task);
+	}
+
+	mix_tasks(audio);
+
+	/* reduce (or just clamp) each plane of each mix in bands */
+	if (band < MIN_REDUCE_SAMPLES)
+		band = MIN_REDUCE_SAMPLES;
+
+	da_resize(pool->tasks, 0);
+	task.type = AUDIO_MIX_TASK_REDUCE;
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((audio->active_mixes & (1 << mix_idx)) == 0)
+			continue;
+
+		task.mix_idx = mix_idx;
+
 		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = (float*)mix->mix_buffers[plane].array;
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val >  1.0f) ?  1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
+			task.plane = plane;
+
+			for (size_t start = 0; start < samples; start += band) {
+				task.start = start;
+				task.end = min_size(start + band, samples);
+				da_push_back(pool->tasks, &task);
 			}
 		}
 	}
+
+	mix_tasks(audio);
 }
 
-static uint64_t round_to_ms(uint64_t ts)
+/* input_mutex is only held to gather the inputs, so callbacks can connect
+ * and disconnect inputs from the mix threads without waiting on the audio
+ * thread, which itself waits on the mix threads */
+static void output_parallel(struct audio_output *audio)
 {
-	return (ts + 999999ULL) / 1000000ULL * 1000000ULL;
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	struct audio_mix_task task = {0};
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	da_resize(pool->tasks, 0);
+	task.type = AUDIO_MIX_TASK_OUTPUT;
+	task.state = AUDIO_MIX_TASK_PENDING;
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix *mix = &audio->mixes[mix_idx];
+
+		if ((audio->active_mixes & (1 << mix_idx)) == 0)
+			continue;
+
+		task.mix_idx = mix_idx;
+
+		for (size_t i = mix->inputs.num; i > 0; i--) {
+			task.input = mix->inputs.array[i-1];
+			da_push_back(pool->tasks, &task);
+		}
+	}
+
+	audio->outputting = true;
+	os_event_reset(audio->output_idle_event);
+
+	pthread_mutex_unlock(&audio->input_mutex);
+
+	mix_tasks(audio);
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	for (size_t i = 0; i < pool->tasks.num; i++) {
+		struct audio_mix_task *done = pool->tasks.array+i;
+		audio->mix_output_ns[done->mix_idx] += done->output_ns;
+	}
+
+	for (size_t i = 0; i < audio->removed_inputs.num; i++)
+		audio_input_free(audio->removed_inputs.array+i);
+	da_resize(audio->removed_inputs, 0);
+
+	audio->outputting = false;
+	os_event_signal(audio->output_idle_event);
+
+	pthread_mutex_unlock(&audio->input_mutex);
 }
 
+static void free_mix_pool(struct audio_mix_pool *pool)
+{
+	if (pool->threads.num) {
+		os_atomic_set_bool(&pool->stop, true);
+
+		for (size_t i = 0; i < pool->threads.num; i++)
+			os_sem_post(pool->work_sem);
+		for (size_t i = 0; i < pool->threads.num; i++)
+			pthread_join(pool->threads.array[i], NULL);
+	}
+
+	os_sem_destroy(pool->work_sem);
+	os_sem_destroy(pool->done_sem);
+	pool->work_sem = NULL;
+	pool->done_sem = NULL;
+
+	for (size_t i = 0; i < pool->chunks.num; i++) {
+		struct audio_mix_chunk *chunk = pool->chunks.array+i;
+
+		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++)
+			for (size_t plane = 0; plane < MAX_AV_PLANES; plane++)
+				da_free(chunk->buffers[mix_idx][plane]);
+	}
+
+	da_free(pool->chunks);
+	da_free(pool->tasks);
+	da_free(pool->threads);
+	os_atomic_set_bool(&pool->stop, false);
+}
+
+static void init_mix_pool(struct audio_output *audio)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+	uint32_t threads = audio->info.mix_threads;
+	size_t workers;
+
+	if (threads > MAX_AUDIO_MIX_THREADS)
+		threads = MAX_AUDIO_MIX_THREADS;
+	workers = threads > 1 ? (size_t)(threads - 1) : 0;
+
+	if (!workers)
+		return;
+
+	if (os_sem_init(&pool->work_sem, 0) != 0 ||
+	    os_sem_init(&pool->done_sem, 0) != 0) {
+		blog(LOG_ERROR, "Failed to create audio mix thread semaphores");
+		free_mix_pool(pool);
+		return;
+	}
+
+	for (size_t i = 0; i < workers; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, mix_thread, audio) != 0) {
+			blog(LOG_ERROR, "Failed to create audio mix thread");
+			break;
+		}
+		da_push_back(pool->threads, &thread);
+	}
+
+	blog(LOG_INFO, "Mixing audio on %d thread(s)",
+			(int)pool->threads.num + 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
 #define MAX_MIX_BYTES 5 * 1024 * 1024
 
 /* sample audio 40 times a second */
 #define AUDIO_WAIT_TIME (1000/40)
 
+static const char *mix_lines_name = "mix_audio_lines";
+static const char *output_mixes_name = "output_audio_mixes";
+static const char *audio_buffering_name = "audio_buffering";
+
+static inline uint64_t line_dropped_frames(const struct audio_line *line)
+{
+	return line->out_of_bounds_frames + (uint64_t)os_atomic_load_long(
+			&line->ring_dropped_frames);
+}
+
+/* must be called with stats_mutex locked */
+static void publish_line_stats(struct audio_output *audio,
+		struct audio_line *line)
+{
+	struct audio_line_stats *stats = &line->stats;
+	uint64_t dropped = line_dropped_frames(line);
+	uint64_t lost = dropped - stats->dropped_frames +
+		line->cut_off_frames - stats->cut_off_frames;
+
+	stats->buffered_ns           = conv_frames_to_time(audio,
+			line->buffers[0].size / audio->block_size);
+	stats->required_buffering_ns = line->required_buffering;
+	stats->smoothed_timestamps   = line->smoothed_timestamps;
+	stats->max_ts_correction_ns  = line->max_ts_correction;
+	stats->dropped_frames        = dropped;
+	stats->cut_off_frames        = line->cut_off_frames;
+
+	profile_record(line->buffered_name, stats->buffered_ns);
+	profile_record(line->required_name, stats->required_buffering_ns);
+
+	if (line->tick_ts_correction) {
+		profile_record(line->ts_correction_name,
+				line->tick_ts_correction);
+		line->tick_ts_correction = 0;
+	}
+
+	/* recorded as the length of the audio that was lost */
+	if (lost)
+		profile_record(line->dropped_name,
+				conv_frames_to_time(audio, lost));
+}
+
+static void publish_stats(struct audio_output *audio, uint64_t buffer_time,
+		uint64_t mix_ns, uint64_t output_ns)
+{
+	struct audio_output_stats *stats = &audio->stats;
+
+	pthread_mutex_lock(&audio->stats_mutex);
+
+	for (size_t i = 0; i < audio->mix_lines.num; i++)
+		publish_line_stats(audio, audio->mix_lines.array[i]);
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix_stats *mix_stats = &audio->mix_stats[mix_idx];
+
+		mix_stats->lines          = 0;
+		mix_stats->inputs         = audio->mix_inputs[mix_idx];
+		mix_stats->frames         = 0;
+		mix_stats->output_time_ns = 0;
+
+		if ((audio->active_mixes & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t i = 0; i < audio->mix_lines.num; i++) {
+			struct audio_line *line = audio->mix_lines.array[i];
+			if ((line->mixed_mask & (1 << mix_idx)) != 0)
+				mix_stats->lines++;
+		}
+
+		mix_stats->frames         = audio->mix_frames;
+		mix_stats->output_time_ns = audio->mix_output_ns[mix_idx];
+	}
+
+	stats->buffering_ns   = buffer_time;
+	stats->catching_up    = audio->catching_up;
+	stats->lines          = (uint32_t)audio->mix_lines.num;
+	stats->mixes++;
+	stats->mix_time_ns    = mix_ns;
+	stats->output_time_ns = output_ns;
+	if (mix_ns > stats->max_mix_time_ns)
+		stats->max_mix_time_ns = mix_ns;
+	if (output_ns > stats->max_output_time_ns)
+		stats->max_output_time_ns = output_ns;
+
+	pthread_mutex_unlock(&audio->stats_mutex);
+
+	profile_record(audio_buffering_name, buffer_time);
+}
+
 static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		uint64_t prev_time, uint64_t *buffer_time)
 {
-	struct audio_line *line = audio->first_line;
+	struct audio_line *line;
 	uint64_t frames = ts_diff_frames(audio, audio_time, prev_time);
 	uint64_t total_bytes = frames * audio->block_size;
 	size_t bytes = (size_t)min_uint64(total_bytes,
@@ -409,46 +1233,77 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		audio->pause_cutoff_time = audio_time;
 	}
 
+	/* only mixes with inputs are mixed and output */
+	uint32_t active_mixes = 0;
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		size_t inputs = audio->mixes[mix_idx].inputs.num;
+
+		audio->mix_inputs[mix_idx] = (uint32_t)inputs;
+		if (inputs)
+			active_mixes |= 1 << mix_idx;
+	}
+
+	pthread_mutex_unlock(&audio->input_mutex);
+
 	/* resize and clear mix buffers */
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
+		if ((active_mixes & (1 << mix_idx)) == 0)
+			continue;
+
 		for (size_t i = 0; i < audio->planes; i++) {
 			da_resize(mix->mix_buffers[i], bytes);
 			memset(mix->mix_buffers[i].array, 0, bytes);
 		}
 	}
 
-	bool buffer_time_updated = false;
+	audio->mix_bytes     = bytes;
+	audio->mix_frames    = (uint32_t)frames;
+	audio->mix_timestamp = prev_time;
+	audio->mix_end_time  = audio_time;
+	audio->active_mixes  = active_mixes;
 
-	/* mix audio lines */
+	/* destroy lines marked for removal, and gather the rest in order */
+	da_resize(audio->mix_lines, 0);
+
+	/* only the audio thread frees lines, so the gathered lines stay valid
+	 * without holding line_mutex while mixing */
+	pthread_mutex_lock(&audio->line_mutex);
+
+	line = audio->first_line;
 	while (line) {
 		struct audio_line *next = line->next;
 
-		/* if line marked for removal, destroy and move to the next */
-		if (!line->buffers[0].size) {
-			if (!line->alive) {
-				audio_output_removeline(audio, line);
-				line = next;
-				continue;
-			}
-		}
+		if (line_is_dead(line))
+			audio_output_removeline(audio, line);
+		else
+			da_push_back(audio->mix_lines, &line);
 
-		pthread_mutex_lock(&line->mutex);
+		line = next;
+	}
 
-		if (line->buffers[0].size && line->base_timestamp < prev_time) {
-			clear_excess_audio_data(line, prev_time);
-			line->base_timestamp = prev_time;
+	pthread_mutex_unlock(&audio->line_mutex);
 
-		} else if (line->audio_getting_cut_off) {
-			line->audio_getting_cut_off = false;
-			blog(LOG_WARNING, "Audio line '%s' audio data no "
-			                  "longer getting cut off.",
-			                  line->name);
-		}
+	/* mix audio lines */
+	uint64_t mix_start = os_gettime_ns();
+	profile_start(mix_lines_name);
+
+	if (audio->mix_pool.threads.num)
+		mix_lines_parallel(audio);
+	else
+		mix_lines_serial(audio);
+
+	profile_end(mix_lines_name);
+	uint64_t mix_ns = os_gettime_ns() - mix_start;
 
-		if (mix_audio_line(audio, line, bytes, prev_time))
-			line->base_timestamp = audio_time;
+	bool buffer_time_updated = false;
+
+	for (size_t i = 0; i < audio->mix_lines.num; i++) {
+		line = audio->mix_lines.array[i];
 
 		uint64_t line_required_buffering = round_to_ms(
 			((prev_time > line->last_timestamp) ? prev_time - line->last_timestamp : 0) + line->required_buffering);
@@ -461,18 +1316,29 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		}
 
 		line->last_timestamp_valid = false;
+	}
 
-		pthread_mutex_unlock(&line->mutex);
+	/* output */
+	uint64_t output_start = os_gettime_ns();
+	profile_start(output_mixes_name);
 
-		line = next;
+	memset(audio->mix_output_ns, 0, sizeof(audio->mix_output_ns));
+
+	if (audio->mix_pool.threads.num)
+		output_parallel(audio);
+	else
+		output_serial(audio);
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((active_mixes & (1 << mix_idx)) != 0)
+			profile_record(audio->output_mix_names[mix_idx],
+					audio->mix_output_ns[mix_idx]);
 	}
 
-	/* clamps audio data to -1.0..1.0 */
-	clamp_audio_output(audio, bytes);
+	profile_end(output_mixes_name);
+	uint64_t output_ns = os_gettime_ns() - output_start;
 
-	/* output */
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, prev_time, (uint32_t)frames);
+	publish_stats(audio, *buffer_time, mix_ns, output_ns);
 
 	if (buffer_time_updated)
 		blog(LOG_INFO, "New audio buffering time: %llu ms (max is %llu ms)", *buffer_time / 1000000ULL, audio->info.max_buffer_ms);
@@ -480,12 +1346,57 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	return audio_time;
 }
 
+static const char *audio_tick_error_name = "audio_tick_error";
+
+static inline void record_tick_error(struct audio_output *audio,
+		uint64_t error_ns)
+{
+	long error_us = (long)min_uint64(error_ns / 1000, LONG_MAX);
+
+	os_atomic_set_long(&audio->last_tick_error_us, error_us);
+	if (error_us > os_atomic_load_long(&audio->max_tick_error_us))
+		os_atomic_set_long(&audio->max_tick_error_us, error_us);
+
+	profile_record(audio_tick_error_name, error_ns);
+}
+
+/* sleeps to the next tick deadline, unless it's already passed.  a deadline
+ * missed by more than a whole tick is dropped rather than mixing several
+ * times in a row to make up for it */
+static void wait_for_tick(struct audio_output *audio, uint64_t *deadline)
+{
+	uint64_t t = *deadline;
+	uint64_t cur_time;
+
+	if (os_sleepto_ns_hybrid(t, 0)) {
+		cur_time = os_gettime_ns();
+	} else {
+		cur_time = os_gettime_ns();
+		os_atomic_inc_long(&audio->late_ticks);
+	}
+
+	os_atomic_inc_long(&audio->ticks);
+	record_tick_error(audio, cur_time - t);
+
+	t += audio->tick_ns;
+	if (t <= cur_time) {
+		uint64_t missed = (cur_time - t) / audio->tick_ns + 1;
+		os_atomic_set_long(&audio->skipped_ticks,
+				os_atomic_load_long(&audio->skipped_ticks) +
+				(long)missed);
+		t += missed * audio->tick_ns;
+	}
+
+	*deadline = t;
+}
+
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	uint64_t buffer_time = 0;
 	uint64_t prev_time = os_gettime_ns() - buffer_time;
 	uint64_t audio_time;
+	uint64_t deadline = prev_time + audio->tick_ns;
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -494,11 +1405,16 @@ static void *audio_thread(void *param)
 				"audio_thread(%s)", audio->info.name);
 	
 	while (os_event_try(audio->stop_event) == EAGAIN) {
-		if (!audio->catching_up)
+		/* when catching up, mix again right away and restart the
+		 * ticks from the time it's done */
+		if (audio->catching_up)
+			deadline = os_gettime_ns() + audio->tick_ns;
+		else if (audio->tick_ns)
+			wait_for_tick(audio, &deadline);
+		else
 			os_sleep_ms(AUDIO_WAIT_TIME);
 
 		profile_start(audio_thread_name);
-		pthread_mutex_lock(&audio->line_mutex);
 
 		audio_time = os_gettime_ns() - buffer_time;
 		if (audio_time > prev_time) { // in case of buffer_time adjustments the new audio time can be below the previous time
@@ -506,7 +1422,6 @@ static void *audio_thread(void *param)
 			prev_time = audio_time;
 		}
 
-		pthread_mutex_unlock(&audio->line_mutex);
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
@@ -606,6 +1521,44 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 	return success;
 }
 
+static bool is_mix_thread(const struct audio_output *audio)
+{
+	const struct audio_mix_pool *pool = &audio->mix_pool;
+	pthread_t self = pthread_self();
+
+	if (pthread_equal(self, audio->thread))
+		return true;
+
+	for (size_t i = 0; i < pool->threads.num; i++) {
+		if (pthread_equal(self, pool->threads.array[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/* must be called with input_mutex locked while outputting */
+static void cancel_output_tasks(struct audio_output *audio, size_t mix_idx,
+		audio_output_callback_t callback, void *param)
+{
+	struct audio_mix_pool *pool = &audio->mix_pool;
+
+	for (size_t i = 0; i < pool->tasks.num; i++) {
+		struct audio_mix_task *task = pool->tasks.array+i;
+
+		if (task->type == AUDIO_MIX_TASK_OUTPUT &&
+		    task->mix_idx == mix_idx &&
+		    task->input.callback == callback &&
+		    task->input.param == param)
+			os_atomic_compare_swap_long(&task->state,
+					AUDIO_MIX_TASK_PENDING,
+					AUDIO_MIX_TASK_CANCELED);
+	}
+}
+
+/* once this returns the input's callback won't be called again.  if it's
+ * called from an audio callback, callbacks already running on other mix
+ * threads may still finish */
 void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 		audio_output_callback_t callback, void *param)
 {
@@ -613,10 +1566,24 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	while (audio->outputting && !is_mix_thread(audio)) {
+		pthread_mutex_unlock(&audio->input_mutex);
+		os_event_wait(audio->output_idle_event);
+		pthread_mutex_lock(&audio->input_mutex);
+	}
+
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array+idx);
+
+		if (audio->outputting) {
+			cancel_output_tasks(audio, mix_idx, callback, param);
+			da_push_back(audio->removed_inputs,
+					mix->inputs.array+idx);
+		} else {
+			audio_input_free(mix->inputs.array+idx);
+		}
+
 		da_erase(mix->inputs, idx);
 	}
 
@@ -644,6 +1611,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
 	pthread_mutex_init_value(&out->line_mutex);
+	pthread_mutex_init_value(&out->stats_mutex);
+	out->tick_ns    = info->tick_ms * 1000000ULL;
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->block_size = (planar ? 1 : out->channels) *
@@ -657,8 +1626,20 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->stats_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (os_event_init(&out->output_idle_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+		out->output_mix_names[i] = profile_store_name(
+				obs_get_profiler_name_store(),
+				"output_audio_mix(%d)", (int)i);
+
+	init_mix_pool(out);
+
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
 		goto fail;
 
@@ -684,6 +1665,10 @@ void audio_output_close(audio_t *audio)
 		pthread_join(audio->thread, &thread_ret);
 	}
 
+	free_mix_pool(&audio->mix_pool);
+	da_free(audio->mix_lines);
+	da_free(audio->removed_inputs);
+
 	line = audio->first_line;
 	while (line) {
 		struct audio_line *next = line->next;
@@ -704,7 +1689,9 @@ void audio_output_close(audio_t *audio)
 	}
 
 	os_event_destroy(audio->stop_event);
+	os_event_destroy(audio->output_idle_event);
 	pthread_mutex_destroy(&audio->line_mutex);
+	pthread_mutex_destroy(&audio->stats_mutex);
 	bfree(audio);
 }
 
@@ -714,17 +1701,28 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 	if (!audio) return NULL;
 
 	struct audio_line *line = bzalloc(sizeof(struct audio_line));
-	line->alive = true;
-	line->audio = audio;
-	line->mixers = mixers;
 
-	if (pthread_mutex_init(&line->mutex, NULL) != 0) {
-		blog(LOG_ERROR, "audio_output_createline: Failed to create "
-		                "mutex");
+	if (pthread_mutex_init(&line->overflow_mutex, NULL) != 0) {
 		bfree(line);
 		return NULL;
 	}
 
+	line->alive = true;
+	line->audio = audio;
+	line->mixers = mixers;
+	line->name = bstrdup(name ? name : "(unnamed audio line)");
+
+	profiler_name_store_t *store = obs_get_profiler_name_store();
+	line->buffered_name = profile_store_name(store,
+			"audio_line_buffered(%s)", line->name);
+	line->required_name = profile_store_name(store,
+			"audio_line_required_buffering(%s)", line->name);
+	line->ts_correction_name = profile_store_name(store,
+			"audio_line_ts_correction(%s)", line->name);
+	line->dropped_name = profile_store_name(store,
+			"audio_line_dropped(%s)", line->name);
+
+	/* the audio thread can mix the line as soon as it's linked */
 	pthread_mutex_lock(&audio->line_mutex);
 
 	if (audio->first_line) {
@@ -736,8 +1734,6 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 	audio->first_line = line;
 
 	pthread_mutex_unlock(&audio->line_mutex);
-
-	line->name = bstrdup(name ? name : "(unnamed audio line)");
 	return line;
 }
 
@@ -746,14 +1742,60 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+bool audio_output_get_tick_stats(const audio_t *audio,
+		struct audio_output_tick_stats *stats)
+{
+	if (!audio || !stats)
+		return false;
+
+	stats->tick_ms       = audio->info.tick_ms;
+	stats->ticks         = (uint32_t)os_atomic_load_long(&audio->ticks);
+	stats->late_ticks    = (uint32_t)os_atomic_load_long(
+			&audio->late_ticks);
+	stats->skipped_ticks = (uint32_t)os_atomic_load_long(
+			&audio->skipped_ticks);
+	stats->last_error_ns = (uint64_t)os_atomic_load_long(
+			&audio->last_tick_error_us) * 1000ULL;
+	stats->max_error_ns  = (uint64_t)os_atomic_load_long(
+			&audio->max_tick_error_us) * 1000ULL;
+	return true;
+}
+
+bool audio_output_get_stats(const audio_t *audio,
+		struct audio_output_stats *stats)
+{
+	if (!audio || !stats)
+		return false;
+
+	/* only the lock is modified */
+	struct audio_output *out = (struct audio_output*)audio;
+
+	pthread_mutex_lock(&out->stats_mutex);
+	*stats = out->stats;
+	pthread_mutex_unlock(&out->stats_mutex);
+	return true;
+}
+
+bool audio_output_get_mix_stats(const audio_t *audio, size_t mix_idx,
+		struct audio_mix_stats *stats)
+{
+	if (!audio || !stats || mix_idx >= MAX_AUDIO_MIXES)
+		return false;
+
+	struct audio_output *out = (struct audio_output*)audio;
+
+	pthread_mutex_lock(&out->stats_mutex);
+	*stats = out->mix_stats[mix_idx];
+	pthread_mutex_unlock(&out->stats_mutex);
+	return true;
+}
+
+/* the audio thread owns the line's buffers, so it frees the line once it
+ * has played what's left of it */
 void audio_line_destroy(struct audio_line *line)
 {
-	if (line) {
-		if (!line->buffers[0].size)
-			audio_output_removeline(line->audio, line);
-		else
-			line->alive = false;
-	}
+	if (line)
+		os_atomic_set_bool(&line->alive, false);
 }
 
 bool audio_output_active(const audio_t *audio)
@@ -790,40 +1832,19 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
-/* TODO: optimize these two functions */
-static inline void mul_vol_float(float *array, float volume, size_t count)
+static inline void mul_vol_float(float *dst, const float *src, float volume,
+		size_t count)
 {
 	for (size_t i = 0; i < count; i++)
-		array[i] *= volume;
+		dst[i] = src[i] * volume;
 }
 
 static void audio_line_place_data_pos(struct audio_line *line,
-		const struct audio_data *data, size_t position)
+		const struct audio_line_packet *packet, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
-	size_t total_size = data->frames * line->audio->block_size;
-
-	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
-
-		uint8_t *array = line->volume_buffers[i].array;
-
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float((float*)array, data->volume, total_num);
-			break;
-		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-			                "Unsupported or unknown format");
-			break;
-		}
-
+	for (size_t i = 0; i < line->audio->planes; i++)
 		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
-	}
+				packet->data[i].array, packet->data[i].num);
 }
 
 static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
@@ -842,14 +1863,25 @@ static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
 				diff);
 #endif
 
-	return (diff < TS_SMOOTHING_THRESHOLD) ? line->next_ts_min : timestamp;
+	if (diff >= TS_SMOOTHING_THRESHOLD)
+		return timestamp;
+
+	if (diff) {
+		line->smoothed_timestamps++;
+		if (diff > line->max_ts_correction)
+			line->max_ts_correction = diff;
+		if (diff > line->tick_ts_correction)
+			line->tick_ts_correction = diff;
+	}
+
+	return line->next_ts_min;
 }
 
 static bool audio_line_place_data(struct audio_line *line,
-		const struct audio_data *data)
+		const struct audio_line_packet *packet)
 {
 	int64_t pos;
-	uint64_t timestamp = smooth_ts(line, data->timestamp);
+	uint64_t timestamp = smooth_ts(line, packet->timestamp);
 
 	pos = ts_diff_bytes(line->audio, timestamp, line->base_timestamp);
 
@@ -858,17 +1890,17 @@ static bool audio_line_place_data(struct audio_line *line,
 	}
 
 	line->next_ts_min =
-		timestamp + conv_frames_to_time(line->audio, data->frames);
+		timestamp + conv_frames_to_time(line->audio, packet->frames);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "data->timestamp: %llu, line->base_timestamp: %llu, "
 			"pos: %lu, bytes: %lu, buf size: %lu",
 			timestamp, line->base_timestamp, pos,
-			data->frames * line->audio->block_size,
+			packet->frames * line->audio->block_size,
 			line->buffers[0].size);
 #endif
 
-	audio_line_place_data_pos(line, data, (size_t)pos);
+	audio_line_place_data_pos(line, packet, (size_t)pos);
 	return true;
 }
 
@@ -883,15 +1915,13 @@ static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
 	return ts >= line->base_timestamp && ts < max_ts;
 }
 
-void audio_line_output(audio_line_t *line, const struct audio_data *data)
+/* called from the audio thread for each packet taken from the ring */
+static void audio_line_insert(struct audio_line *line,
+		const struct audio_line_packet *packet)
 {
 	bool inserted_audio = false;
 
-	if (!line || !data) return;
-
-	uint64_t min_buffering = round_to_ms(2 * data->frames * 1000000000ULL / line->audio->info.samples_per_sec);
-
-	pthread_mutex_lock(&line->mutex);
+	uint64_t min_buffering = round_to_ms(2 * packet->frames * 1000000000ULL / line->audio->info.samples_per_sec);
 
 	if (min_buffering > line->audio->info.max_buffer_ms * 1000000ULL)
 		min_buffering = line->audio->info.max_buffer_ms * 1000000ULL;
@@ -903,19 +1933,21 @@ void audio_line_output(audio_line_t *line, const struct audio_data *data)
 	}
 
 	if (!line->buffers[0].size) {
-		line->base_timestamp = data->timestamp - min_buffering;
-		inserted_audio = audio_line_place_data(line, data);
+		line->base_timestamp = packet->timestamp - min_buffering;
+		inserted_audio = audio_line_place_data(line, packet);
 
-	} else if (valid_timestamp_range(line, data->timestamp)) {
-		inserted_audio = audio_line_place_data(line, data);
+	} else if (valid_timestamp_range(line, packet->timestamp)) {
+		inserted_audio = audio_line_place_data(line, packet);
 	}
 
 	if (inserted_audio && !line->last_timestamp_valid) {
-		line->last_timestamp = data->timestamp;
+		line->last_timestamp = packet->timestamp;
 		line->last_timestamp_valid = true;
 	}
 
 	if (!inserted_audio) {
+		line->out_of_bounds_frames += packet->frames;
+
 		if (!line->audio_data_out_of_bounds) {
 			blog(LOG_WARNING, "Audio line '%s' currently "
 			                  "receiving out of bounds audio "
@@ -929,7 +1961,7 @@ void audio_line_output(audio_line_t *line, const struct audio_data *data)
 		                "data->timestamp: %"PRIu64", "
 		                "line->base_timestamp: %"PRIu64".  This can "
 		                "sometimes happen when there's a pause in "
-		                "the threads.", line->name, data->timestamp,
+		                "the threads.", line->name, packet->timestamp,
 		                line->base_timestamp);*/
 
 	} else if (line->audio_data_out_of_bounds) {
@@ -937,8 +1969,111 @@ void audio_line_output(audio_line_t *line, const struct audio_data *data)
 		                  "out of bounds audio data.", line->name);
 		line->audio_data_out_of_bounds = false;
 	}
+}
+
+static void audio_line_copy_packet(struct audio_line *line,
+		struct audio_line_packet *packet, const struct audio_data *data)
+{
+	bool   planar     = line->audio->planes > 1;
+	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
+	size_t total_size = data->frames * line->audio->block_size;
+
+	packet->frames    = data->frames;
+	packet->timestamp = data->timestamp;
+
+	for (size_t i = 0; i < line->audio->planes; i++) {
+		da_resize(packet->data[i], total_size);
+
+		switch (line->audio->info.format) {
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR:
+			mul_vol_float((float*)packet->data[i].array,
+					(const float*)data->data[i],
+					data->volume, total_num);
+			break;
+		default:
+			blog(LOG_ERROR, "audio_line_output: "
+			                "Unsupported or unknown format");
+			memcpy(packet->data[i].array, data->data[i],
+					total_size);
+			break;
+		}
+	}
+}
+
+/* queues a packet that doesn't fit into the ring, returns false if the
+ * queue already holds the maximum buffering time */
+static bool audio_line_queue_overflow(struct audio_line *line,
+		const struct audio_data *data)
+{
+	const struct audio_output_info *info = &line->audio->info;
+	uint64_t max_frames = (uint64_t)info->max_buffer_ms *
+		info->samples_per_sec / 1000;
+	bool queued = false;
+
+	pthread_mutex_lock(&line->overflow_mutex);
+
+	if (line->overflow_frames + data->frames <= max_frames) {
+		if (line->overflow_used == line->overflow.num)
+			da_push_back_new(line->overflow);
+
+		audio_line_copy_packet(line,
+				line->overflow.array + line->overflow_used++,
+				data);
+
+		line->overflow_frames += data->frames;
+		os_atomic_inc_long(&line->overflow_count);
+		queued = true;
+	}
 
-	pthread_mutex_unlock(&line->mutex);
+	pthread_mutex_unlock(&line->overflow_mutex);
+	return queued;
+}
+
+/* only copies the data into the next free slot of the line's ring (or its
+ * overflow queue), the audio thread places it in the line's buffers the
+ * next time it mixes */
+void audio_line_output(audio_line_t *line, const struct audio_data *data)
+{
+	if (!line || !data) return;
+
+	/* only the producer adds to the overflow queue, so it can't become
+	 * non-empty behind its back */
+	if (os_atomic_load_long(&line->overflow_count) ||
+	    os_atomic_load_long(&line->ring_count) == AUDIO_LINE_RING_SIZE) {
+		if (!audio_line_queue_overflow(line, data)) {
+			if (!line->ring_full) {
+				blog(LOG_WARNING, "Audio line '%s' is full, "
+				                  "audio data is being dropped "
+				                  "until the audio thread "
+				                  "catches up.", line->name);
+				line->ring_full = true;
+			}
+
+			/* only the producer writes this */
+			os_atomic_set_long(&line->ring_dropped_frames,
+					os_atomic_load_long(
+						&line->ring_dropped_frames) +
+					(long)data->frames);
+			return;
+		}
+
+	} else {
+		audio_line_copy_packet(line, &line->ring[line->ring_write_idx],
+				data);
+
+		if (++line->ring_write_idx == AUDIO_LINE_RING_SIZE)
+			line->ring_write_idx = 0;
+
+		/* hands the slot to the audio thread */
+		os_atomic_inc_long(&line->ring_count);
+	}
+
+	if (line->ring_full) {
+		blog(LOG_WARNING, "Audio line '%s' no longer dropping "
+		                  "audio data.", line->name);
+		line->ring_full = false;
+	}
 }
 
 void audio_line_set_mixers(audio_line_t *line, uint32_t mixers)
@@ -951,3 +2086,19 @@ uint32_t audio_line_get_mixers(audio_line_t *line)
 {
 	return !!line ? line->mixers : 0;
 }
+
+/* as of the last mix the line was part of */
+bool audio_line_get_stats(const audio_line_t *line,
+		struct audio_line_stats *stats)
+{
+	if (!line || !stats)
+		return false;
+
+	struct audio_output *audio = line->audio;
+
+	pthread_mutex_lock(&audio->stats_mutex);
+	*stats = line->stats;
+	pthread_mutex_unlock(&audio->stats_mutex);
+
+	return true;
+}
@@ -78,6 +78,62 @@ struct audio_output_info {
 	enum audio_format   format;
 	enum speaker_layout speakers;
 	uint64_t            max_buffer_ms;
+
+	/* mixes on absolute deadlines every tick_ms milliseconds, 0 keeps
+	 * polling every 25 ms */
+	uint32_t            tick_ms;
+
+	/* threads mixing and outputting audio, including the audio thread
+	 * (0 or 1 mixes on the audio thread only, at most 16) */
+	uint32_t            mix_threads;
+};
+
+/* wake-up statistics of the audio thread in tick mode.  the error is how
+ * long after its deadline the thread woke; late ticks found their deadline
+ * already passed, and ticks more than one period late are skipped */
+struct audio_output_tick_stats {
+	uint32_t            tick_ms;
+	uint32_t            ticks;
+	uint32_t            late_ticks;
+	uint32_t            skipped_ticks;
+	uint64_t            last_error_ns;
+	uint64_t            max_error_ns;
+};
+
+/* state of the audio thread as of its last mix.  buffering is how far
+ * behind the current time the audio thread mixes, mix and output times are
+ * how long mixing the lines and passing the mixes on took */
+struct audio_output_stats {
+	uint64_t            buffering_ns;
+	bool                catching_up;
+	uint32_t            lines;
+	uint64_t            mixes;
+	uint64_t            mix_time_ns;
+	uint64_t            max_mix_time_ns;
+	uint64_t            output_time_ns;
+	uint64_t            max_output_time_ns;
+};
+
+/* a single mix as of the last mix.  the output time is summed over the
+ * threads that outputted it */
+struct audio_mix_stats {
+	uint32_t            lines;
+	uint32_t            inputs;
+	uint32_t            frames;
+	uint64_t            output_time_ns;
+};
+
+/* buffered is the audio queued in the line past the last mix.  smoothed
+ * timestamps were moved onto the end of the previous packet, dropped frames
+ * didn't fit in the line's queue or were too far out of bounds, and cut off
+ * frames were already behind the mix when they were placed */
+struct audio_line_stats {
+	uint64_t            buffered_ns;
+	uint64_t            required_buffering_ns;
+	uint64_t            smoothed_timestamps;
+	uint64_t            max_ts_correction_ns;
+	uint64_t            dropped_frames;
+	uint64_t            cut_off_frames;
 };
 
 struct audio_convert_info {
@@ -191,13 +247,24 @@ EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
+EXPORT bool audio_output_get_tick_stats(const audio_t *audio,
+		struct audio_output_tick_stats *stats);
+EXPORT bool audio_output_get_stats(const audio_t *audio,
+		struct audio_output_stats *stats);
+EXPORT bool audio_output_get_mix_stats(const audio_t *audio, size_t mix_idx,
+		struct audio_mix_stats *stats);
 
 EXPORT audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 		uint32_t mixers);
 EXPORT void audio_line_set_mixers(audio_line_t *line, uint32_t mixers);
 EXPORT uint32_t audio_line_get_mixers(audio_line_t *line);
 EXPORT void audio_line_destroy(audio_line_t *line);
+/* never blocks on the audio thread, but must not be called from more than
+ * one thread at a time for the same line */
 EXPORT void audio_line_output(audio_line_t *line, const struct audio_data *data);
+/* can be called from any thread until the line is destroyed */
+EXPORT bool audio_line_get_stats(const audio_line_t *line,
+		struct audio_line_stats *stats);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,70 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* This file is compiled with AVX enabled, nothing in it may be called
+ * before checking that the CPU supports AVX. */
+
+#include "audio-mix-avx.h"
+#include <immintrin.h>
+
+/* the operand order keeps NaNs the way the scalar clamp does */
+static FORCE_INLINE __m256 clamp_ps(__m256 val, __m256 min_val, __m256 max_val)
+{
+	return _mm256_max_ps(min_val, _mm256_min_ps(max_val, val));
+}
+
+size_t mix_float_avx(float *const mixes[], size_t num_add, size_t num_clamp,
+		const float *src, size_t count)
+{
+	size_t num_mixes = num_add + num_clamp;
+	size_t end       = count & ~(size_t)7;
+
+	__m256 min_val = _mm256_set1_ps(-1.0f);
+	__m256 max_val = _mm256_set1_ps(1.0f);
+
+	for (size_t i = 0; i < end; i += 8) {
+		__m256 val = _mm256_loadu_ps(src + i);
+		size_t mix_idx = 0;
+
+		for (; mix_idx < num_add; mix_idx++) {
+			float *dst = mixes[mix_idx] + i;
+			_mm256_storeu_ps(dst,
+					_mm256_add_ps(_mm256_loadu_ps(dst), val));
+		}
+
+		for (; mix_idx < num_mixes; mix_idx++) {
+			float *dst = mixes[mix_idx] + i;
+			__m256 sum = _mm256_add_ps(_mm256_loadu_ps(dst), val);
+			_mm256_storeu_ps(dst, clamp_ps(sum, min_val, max_val));
+		}
+	}
+
+	return end;
+}
+
+size_t clamp_float_avx(float *data, size_t count)
+{
+	size_t end = count & ~(size_t)7;
+
+	__m256 min_val = _mm256_set1_ps(-1.0f);
+	__m256 max_val = _mm256_set1_ps(1.0f);
+
+	for (size_t i = 0; i < end; i += 8) {
+		__m256 val = _mm256_loadu_ps(data + i);
+		_mm256_storeu_ps(data + i, clamp_ps(val, min_val, max_val));
+	}
+
+	return end;
+}
@@ -0,0 +1,31 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * AVX versions of the audio mixing functions.  Only call these if the CPU
+ * supports AVX.  They process as many samples as fit the vector width and
+ * return the sample the caller has to continue from.
+ */
+
+/* adds src to the first num_add mixes, and adds src to the next num_clamp
+ * mixes while clamping the result to -1.0..1.0 */
+size_t mix_float_avx(float *const mixes[], size_t num_add, size_t num_clamp,
+		const float *src, size_t count);
+
+size_t clamp_float_avx(float *data, size_t count);
@@ -0,0 +1,371 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* This file is compiled with AVX2 enabled, nothing in it may be called
+ * before checking that the CPU supports AVX2. */
+
+#include "format-conversion-avx2.h"
+#include <immintrin.h>
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* the packed pixels are U, Y, V, X; shuffle the Y, U and V bytes of each
+ * 128-bit lane into dwords 0, 1 and 2 of that lane */
+#define lane_shuffle_yuv() _mm256_setr_epi8(                                  \
+		1, 5, 9, 13, 0, 4, 8, 12, 2, 6, 10, 14, -1, -1, -1, -1,       \
+		1, 5, 9, 13, 0, 4, 8, 12, 2, 6, 10, 14, -1, -1, -1, -1)
+
+/* brings dword N of both lanes next to each other */
+#define lane_gather() _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)
+
+static FORCE_INLINE void store_lum(uint8_t *lum, __m256i line,
+		__m256i shuffle, __m256i gather)
+{
+	__m256i val = _mm256_permutevar8x32_epi32(
+			_mm256_shuffle_epi8(line, shuffle), gather);
+
+	_mm_storel_epi64((__m128i*)lum, _mm256_castsi256_si128(val));
+}
+
+/* averages the chroma of each 2x2 block into 16-bit U, V pairs, in the same
+ * order and with the same rounding as the SSE2 version */
+static FORCE_INLINE __m256i average_uv(__m256i line1, __m256i line2,
+		__m256i uv_mask)
+{
+	__m256i add_val = _mm256_add_epi16(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+	__m256i avg_val = _mm256_add_epi16(
+			add_val,
+			_mm256_shuffle_epi32(add_val, _MM_SHUFFLE(2, 3, 0, 1)));
+	avg_val = _mm256_srli_epi16(avg_val, 2);
+	return _mm256_shuffle_epi32(avg_val, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+uint32_t compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]) & ~7;
+	uint32_t y;
+
+	__m256i lum_shuffle = lane_shuffle_yuv();
+	__m256i gather      = lane_gather();
+	__m256i uv_mask     = _mm256_set1_epi16(0x00FF);
+	__m128i uv_split    = _mm_setr_epi8(0, 1, 4, 5, 2, 3, 6, 7,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			store_lum(lum_plane + lum_pos0, line1,
+					lum_shuffle, gather);
+			store_lum(lum_plane + lum_pos1, line2,
+					lum_shuffle, gather);
+
+			/* per lane: U01, U23, V01, V23 */
+			__m256i avg_val = average_uv(line1, line2, uv_mask);
+			avg_val = _mm256_shufflelo_epi16(avg_val,
+					_MM_SHUFFLE(3, 1, 2, 0));
+			avg_val = _mm256_packus_epi16(avg_val, avg_val);
+			avg_val = _mm256_permutevar8x32_epi32(avg_val, gather);
+
+			__m128i uv_val = _mm_shuffle_epi8(
+					_mm256_castsi256_si128(avg_val),
+					uv_split);
+
+			*(uint32_t*)(u_plane+chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(uv_val);
+			*(uint32_t*)(v_plane+chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(
+						_mm_srli_si128(uv_val, 4));
+		}
+	}
+
+	return width;
+}
+
+uint32_t compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]) & ~7;
+	uint32_t y;
+
+	__m256i lum_shuffle = lane_shuffle_yuv();
+	__m256i gather      = lane_gather();
+	__m256i uv_mask     = _mm256_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			store_lum(lum_plane + lum_pos0, line1,
+					lum_shuffle, gather);
+			store_lum(lum_plane + lum_pos1, line2,
+					lum_shuffle, gather);
+
+			/* per lane: U01, V01, U23, V23 */
+			__m256i avg_val = average_uv(line1, line2, uv_mask);
+			avg_val = _mm256_packus_epi16(avg_val, avg_val);
+			avg_val = _mm256_permutevar8x32_epi32(avg_val, gather);
+
+			_mm_storel_epi64(
+					(__m128i*)(chroma_plane + chroma_y_pos + x),
+					_mm256_castsi256_si128(avg_val));
+		}
+	}
+
+	return width;
+}
+
+static FORCE_INLINE void store_yuv(uint8_t *lum, uint8_t *u, uint8_t *v,
+		__m256i line, __m256i shuffle, __m256i gather)
+{
+	/* 64-bit lanes: Y, U, V */
+	__m256i val = _mm256_permutevar8x32_epi32(
+			_mm256_shuffle_epi8(line, shuffle), gather);
+	__m128i lo = _mm256_castsi256_si128(val);
+
+	_mm_storel_epi64((__m128i*)lum, lo);
+	_mm_storel_epi64((__m128i*)u, _mm_srli_si128(lo, 8));
+	_mm_storel_epi64((__m128i*)v, _mm256_extracti128_si256(val, 1));
+}
+
+uint32_t convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]) & ~7;
+	uint32_t y;
+
+	__m256i shuffle = lane_shuffle_yuv();
+	__m256i gather  = lane_gather();
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			store_yuv(lum_plane + lum_pos0, u_plane + lum_pos0,
+					v_plane + lum_pos0, line1,
+					shuffle, gather);
+			store_yuv(lum_plane + lum_pos1, u_plane + lum_pos1,
+					v_plane + lum_pos1, line2,
+					shuffle, gather);
+		}
+	}
+
+	return width;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* 16 luma pixels of a line combined with their (already shifted) chroma */
+static FORCE_INLINE void store_packed(uint32_t *output, const uint8_t *lum,
+		__m256i chroma_lo, __m256i chroma_hi)
+{
+	__m128i lum_val = _mm_loadu_si128((const __m128i*)lum);
+
+	_mm256_storeu_si256((__m256i*)output, _mm256_or_si256(
+			_mm256_cvtepu8_epi32(lum_val), chroma_lo));
+	_mm256_storeu_si256((__m256i*)(output + 8), _mm256_or_si256(
+			_mm256_cvtepu8_epi32(_mm_srli_si128(lum_val, 8)),
+			chroma_hi));
+}
+
+uint32_t decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = (min_uint32(in_linesize[0], out_linesize)/2) & ~7;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x += 8) {
+			/* each chroma sample covers two pixels */
+			__m128i u = _mm_loadl_epi64(
+					(const __m128i*)(chroma0 + x));
+			__m128i v = _mm_loadl_epi64(
+					(const __m128i*)(chroma1 + x));
+			u = _mm_unpacklo_epi8(u, u);
+			v = _mm_unpacklo_epi8(v, v);
+
+			__m256i chroma_lo = _mm256_or_si256(
+					_mm256_slli_epi32(
+						_mm256_cvtepu8_epi32(u), 8),
+					_mm256_slli_epi32(
+						_mm256_cvtepu8_epi32(v), 16));
+			__m256i chroma_hi = _mm256_or_si256(
+					_mm256_slli_epi32(_mm256_cvtepu8_epi32(
+						_mm_srli_si128(u, 8)), 8),
+					_mm256_slli_epi32(_mm256_cvtepu8_epi32(
+						_mm_srli_si128(v, 8)), 16));
+
+			store_packed(output0 + x*2, lum0 + x*2,
+					chroma_lo, chroma_hi);
+			store_packed(output1 + x*2, lum1 + x*2,
+					chroma_lo, chroma_hi);
+		}
+	}
+
+	return width_d2;
+}
+
+uint32_t decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = (min_uint32(in_linesize[0], out_linesize)/2) & ~7;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x += 8) {
+			/* each UV pair covers two pixels */
+			__m128i uv = _mm_loadu_si128(
+					(const __m128i*)(chroma + x));
+
+			__m256i chroma_lo = _mm256_slli_epi32(
+					_mm256_cvtepu16_epi32(
+						_mm_unpacklo_epi16(uv, uv)), 8);
+			__m256i chroma_hi = _mm256_slli_epi32(
+					_mm256_cvtepu16_epi32(
+						_mm_unpackhi_epi16(uv, uv)), 8);
+
+			store_packed(output0 + x*2, lum0 + x*2,
+					chroma_lo, chroma_hi);
+			store_packed(output1 + x*2, lum1 + x*2,
+					chroma_lo, chroma_hi);
+		}
+	}
+
+	return width_d2;
+}
+
+uint32_t decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width_d2 = (min_uint32(in_linesize, out_linesize)/2) & ~7;
+	uint32_t y;
+
+	/* the second pixel of each pair takes the second luma sample */
+	__m256i keep_mask = _mm256_set1_epi32(
+			leading_lum ? 0xFFFFFF00 : 0xFFFF00FF);
+	__m256i lum_mask  = _mm256_set1_epi32(leading_lum ? 0xFF : 0xFF00);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32 = (const uint32_t*)(input + y*in_linesize);
+		uint32_t       *output32 = (uint32_t*)(output + y*out_linesize);
+		uint32_t       x;
+
+		for (x = 0; x < width_d2; x += 8) {
+			__m256i dw = _mm256_loadu_si256(
+					(const __m256i*)(input32 + x));
+			__m256i second = _mm256_or_si256(
+					_mm256_and_si256(dw, keep_mask),
+					_mm256_and_si256(
+						_mm256_srli_epi32(dw, 16),
+						lum_mask));
+
+			__m256i lo = _mm256_unpacklo_epi32(dw, second);
+			__m256i hi = _mm256_unpackhi_epi32(dw, second);
+
+			_mm256_storeu_si256((__m256i*)(output32 + x*2),
+					_mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)(output32 + x*2 + 8),
+					_mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+
+	return width_d2;
+}
@@ -16,9 +16,13 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "format-conversion-avx2.h"
+#include "../util/threading.h"
+#include "../util/cpu-features.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -89,11 +93,41 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
+/* ------------------------------------------------------------------------- */
+
+static volatile long max_simd = CONVERSION_SIMD_AVX2;
+
+static inline enum conversion_simd get_supported_simd(void)
+{
+	return os_cpu_has_avx2() ? CONVERSION_SIMD_AVX2 : CONVERSION_SIMD_SSE2;
+}
+
+enum conversion_simd format_conversion_get_simd(void)
+{
+	enum conversion_simd simd = get_supported_simd();
+	long max = os_atomic_load_long(&max_simd);
+	return (long)simd < max ? simd : (enum conversion_simd)max;
+}
+
+enum conversion_simd format_conversion_set_max_simd(enum conversion_simd max)
+{
+	os_atomic_set_long(&max_simd, (long)max);
+	return format_conversion_get_simd();
+}
+
+static inline bool use_avx2(void)
+{
+	return format_conversion_get_simd() >= CONVERSION_SIMD_AVX2;
+}
+
+/* ------------------------------------------------------------------------- */
+
 void compress_uyvx_to_i420(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+	uint32_t start_x = 0;
 	uint8_t  *lum_plane   = output[0];
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
@@ -103,13 +137,17 @@ void compress_uyvx_to_i420(
 	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
 	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
 
+	if (use_avx2())
+		start_x = compress_uyvx_to_i420_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -132,6 +170,7 @@ void compress_uyvx_to_nv12(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+	uint32_t start_x = 0;
 	uint8_t *lum_plane    = output[0];
 	uint8_t *chroma_plane = output[1];
 	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
@@ -140,13 +179,17 @@ void compress_uyvx_to_nv12(
 	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
 	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
 
+	if (use_avx2())
+		start_x = compress_uyvx_to_nv12_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -168,6 +211,7 @@ void convert_uyvx_to_i444(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+	uint32_t start_x = 0;
 	uint8_t  *lum_plane   = output[0];
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
@@ -178,12 +222,16 @@ void convert_uyvx_to_i444(
 	__m128i u_mask   = _mm_set1_epi32(0x000000FF);
 	__m128i v_mask   = _mm_set1_epi32(0x00FF0000);
 
+	if (use_avx2())
+		start_x = convert_uyvx_to_i444_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -210,21 +258,27 @@ void decompress_420(
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
 	uint32_t height_d2  = end_y/2;
+	uint32_t start_x    = 0;
 	uint32_t y;
 
+	if (use_avx2())
+		start_x = decompress_420_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize);
+
 	for (y = start_y_d2; y < height_d2; y++) {
-		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
-		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1] + start_x;
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2] + start_x;
 		register const uint8_t *lum0, *lum1;
 		register uint32_t *output0, *output1;
 		uint32_t x;
 
-		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum0 = input[0] + y * 2 * in_linesize[0] + start_x * 2;
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize) +
+			start_x * 2;
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (x = start_x; x < width_d2; x++) {
 			uint32_t out;
 			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
 
@@ -245,21 +299,28 @@ void decompress_nv12(
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
 	uint32_t height_d2  = end_y/2;
+	uint32_t start_x    = 0;
 	uint32_t y;
 
+	if (use_avx2())
+		start_x = decompress_nv12_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize);
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
 		register const uint8_t *lum0, *lum1;
 		register uint32_t *output0, *output1;
 		uint32_t x;
 
-		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
-		lum0 = input[0] + y * 2 * in_linesize[0];
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]) +
+			start_x;
+		lum0 = input[0] + y * 2 * in_linesize[0] + start_x * 2;
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize) +
+			start_x * 2;
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (x = start_x; x < width_d2; x++) {
 			uint32_t out = *(chroma++) << 8;
 
 			*(output0++) = *(lum0++) | out;
@@ -278,17 +339,25 @@ void decompress_422(
 		bool leading_lum)
 {
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t start_x  = 0;
 	uint32_t y;
 
 	register const uint32_t *input32;
 	register const uint32_t *input32_end;
 	register uint32_t       *output32;
 
+	if (use_avx2())
+		start_x = decompress_422_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize,
+				leading_lum);
+
 	if (leading_lum) {
 		for (y = start_y; y < end_y; y++) {
 			input32     = (const uint32_t*)(input + y*in_linesize);
 			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+			output32    = (uint32_t*)(output + y*out_linesize) +
+				start_x * 2;
+			input32    += start_x;
 
 			while(input32 < input32_end) {
 				register uint32_t dw = *input32;
@@ -306,7 +375,9 @@ void decompress_422(
 		for (y = start_y; y < end_y; y++) {
 			input32     = (const uint32_t*)(input + y*in_linesize);
 			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+			output32    = (uint32_t*)(output + y*out_linesize) +
+				start_x * 2;
+			input32    += start_x;
 
 			while (input32 < input32_end) {
 				register uint32_t dw = *input32;
@@ -25,8 +25,25 @@ extern "C" {
 
 /*
  * Functions for converting to and from packed 444 YUV
+ *
+ * The widest instruction set supported by the CPU is picked at runtime.
  */
 
+enum conversion_simd {
+	CONVERSION_SIMD_SSE2,
+	CONVERSION_SIMD_AVX2
+};
+
+/** @return the instruction set currently used by the conversion functions */
+EXPORT enum conversion_simd format_conversion_get_simd(void);
+
+/**
+ * Limits the instruction set used by the conversion functions (used to
+ * compare implementations), returns the instruction set now in use
+ */
+EXPORT enum conversion_simd format_conversion_set_max_simd(
+		enum conversion_simd max);
+
 EXPORT void compress_uyvx_to_i420(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
@@ -17,6 +17,7 @@
 
 #include <assert.h>
 #include "../util/bmem.h"
+#include "../util/circlebuf.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
 #include "../util/threading.h"
@@ -29,13 +30,21 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CACHE_SIZE 16
+#define DEFAULT_CACHE_SIZE 6
 
 struct video_data_container {
 	volatile long refs;
 
+	/* set on per-input copies of containers that own their frame buffer,
+	 * the copies share the buffer but keep their own timestamp */
+	struct video_data_container *parent;
+
 	bool using_texture;
 	obs_output_texture_t *texture;
+
+	/* stage surface lent to a raw frame container, data points into its
+	 * mapping instead of a buffer owned by the container */
+	obs_output_texture_t *mapped;
 	union {
 		struct video_data data;
 		struct video_texture tex;
@@ -55,38 +64,191 @@ struct track_duplicated_frame {
 struct cached_frame_info {
 	DARRAY(struct cached_video_data) frames;
 	uint32_t frames_written;
-	int count;
+	volatile long count;
 	uint64_t timestamp;
 	video_tracked_frame_id tracked_id;
+
+	/* tracked duplicates count the outputs left until they're sent, so
+	 * they're added and counted down along with count under this lock */
+	pthread_mutex_t tracked_mutex;
+	volatile long num_tracked_ids;
 	DARRAY(struct track_duplicated_frame) tracked_ids;
 };
 
+/* every input calls its callback from its own thread, so a slow consumer
+ * only delays (and drops) its own frames */
+struct video_input_worker {
+	void (*callback)(void *param, struct video_data_container *container);
+	void *param;
+
+	pthread_t                  thread;
+	pthread_mutex_t            mutex;
+	os_sem_t                   *sem;
+	struct circlebuf           queue;
+	size_t                     queue_limit;
+	volatile bool              stop;
+	volatile bool              detached;
+
+	const char                 *profile_name;
+	volatile long              total_frames;
+	volatile long              dropped_frames;
+};
+
 struct video_input {
 	DARRAY(struct video_scale_info) info;
 
 	void (*callback)(void *param, struct video_data_container *container);
 	void *param;
+
+	struct video_input_worker  *worker;
 };
 
 void obs_output_texture_addref(obs_output_texture_t *tex);
 void obs_output_texture_release(obs_output_texture_t *tex);
 
+static void video_input_worker_destroy(struct video_input_worker *worker)
+{
+	struct video_data_container *container;
+
+	while (worker->queue.size) {
+		circlebuf_pop_front(&worker->queue, &container,
+				sizeof(container));
+		video_data_container_release(container);
+	}
+
+	circlebuf_free(&worker->queue);
+	os_sem_destroy(worker->sem);
+	pthread_mutex_destroy(&worker->mutex);
+	bfree(worker);
+}
+
+static void video_input_worker_stop(struct video_input_worker *worker)
+{
+	long total = os_atomic_load_long(&worker->total_frames);
+	long dropped = os_atomic_load_long(&worker->dropped_frames);
+
+	if (dropped)
+		blog(LOG_INFO, "video-io: Input dropped %ld of %ld frames "
+		               "because it could not keep up", dropped, total);
+
+	os_atomic_set_bool(&worker->stop, true);
+
+	/* inputs can be disconnected from their own callback, in which case
+	 * the worker cleans itself up once the callback returns */
+	if (pthread_equal(pthread_self(), worker->thread)) {
+		os_atomic_set_bool(&worker->detached, true);
+		pthread_detach(worker->thread);
+		os_sem_post(worker->sem);
+		return;
+	}
+
+	os_sem_post(worker->sem);
+	pthread_join(worker->thread, NULL);
+	video_input_worker_destroy(worker);
+}
+
 static inline void video_input_free(struct video_input *input)
 {
+	if (input->worker)
+		video_input_worker_stop(input->worker);
 	da_free(input->info);
 }
 
+/* copies of texture and lent frames hold the texture themselves, so the
+ * cached container can still drop it as soon as the frame completes */
+static struct video_data_container *copy_container(
+		struct video_data_container *container)
+{
+	struct video_data_container *copy = bmalloc(sizeof(*copy));
+
+	*copy = *container;
+	copy->refs = 0;
+
+	if (container->texture) {
+		obs_output_texture_addref(container->texture);
+	} else if (container->mapped) {
+		obs_output_texture_addref(container->mapped);
+	} else {
+		copy->parent = container;
+		video_data_container_addref(container);
+	}
+
+	return copy;
+}
+
+/* drops the oldest queued frame if the input has fallen behind */
+static void video_input_dispatch(struct video_input *input,
+		struct video_data_container *container)
+{
+	struct video_input_worker *worker = input->worker;
+	struct video_data_container *dropped = NULL;
+
+	pthread_mutex_lock(&worker->mutex);
+
+	if (worker->queue.size >= worker->queue_limit * sizeof(container))
+		circlebuf_pop_front(&worker->queue, &dropped,
+				sizeof(dropped));
+	circlebuf_push_back(&worker->queue, &container, sizeof(container));
+
+	pthread_mutex_unlock(&worker->mutex);
+
+	os_atomic_inc_long(&worker->total_frames);
+
+	if (dropped) {
+		os_atomic_inc_long(&worker->dropped_frames);
+		video_data_container_release(dropped);
+	} else {
+		os_sem_post(worker->sem);
+	}
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input_worker *worker = param;
+	struct video_data_container *container;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(worker->sem) == 0) {
+		if (os_atomic_load_bool(&worker->stop))
+			break;
+
+		pthread_mutex_lock(&worker->mutex);
+		circlebuf_pop_front(&worker->queue, &container,
+				sizeof(container));
+		pthread_mutex_unlock(&worker->mutex);
+
+		profile_start(worker->profile_name);
+		worker->callback(worker->param, container);
+		video_data_container_release(container);
+		profile_end(worker->profile_name);
+
+		profile_reenable_thread();
+	}
+
+	if (os_atomic_load_bool(&worker->detached))
+		video_input_worker_destroy(worker);
+
+	return NULL;
+}
+
+static inline void release_mapped_frame(struct video_data_container *container)
+{
+	obs_output_texture_release(container->mapped);
+	container->mapped = NULL;
+	memset(&container->data, 0, sizeof(struct video_frame));
+}
+
 struct video_output {
 	struct video_output_info   info;
 
 	pthread_t                  thread;
-	pthread_mutex_t            data_mutex;
 	bool                       stop;
 
 	os_sem_t                   *update_semaphore;
 	uint64_t                   frame_time;
-	uint32_t                   skipped_frames;
-	uint32_t                   total_frames;
+	volatile long              skipped_frames;
+	volatile long              total_frames;
 
 	bool                       initialized;
 
@@ -101,10 +263,14 @@ struct video_output {
 
 	DARRAY(struct video_conversion_info) infos;
 
-	size_t                     available_frames;
-	size_t                     first_added;
-	size_t                     last_added;
-	struct cached_frame_info   cache[MAX_CACHE_SIZE];
+	/* single producer (graphics thread), single consumer (video thread)
+	 * ring.  a slot belongs to the video thread while it's counted in
+	 * occupied, and to the graphics thread otherwise */
+	struct cached_frame_info   *cache;
+	size_t                     read_idx;
+	size_t                     write_idx;
+	volatile long              occupied;
+	volatile long              max_occupied;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -140,17 +306,21 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
+	frame_info = &video->cache[video->read_idx];
 
-	frame_info = &video->cache[video->first_added];
+	/* duplicates added from here on still include this output in their
+	 * count, so they can't be due yet */
+	if (os_atomic_load_long(&frame_info->num_tracked_ids)) {
+		pthread_mutex_lock(&frame_info->tracked_mutex);
 
-	for (size_t i = 0; i < frame_info->tracked_ids.num; i++)
-		if (--frame_info->tracked_ids.array[i].count == 0) {
-			tracked_frame = true;
-			tracked_id = frame_info->tracked_ids.array[i].id;
-		}
+		for (size_t i = 0; i < frame_info->tracked_ids.num; i++)
+			if (frame_info->tracked_ids.array[i].count == 1) {
+				tracked_frame = true;
+				tracked_id = frame_info->tracked_ids.array[i].id;
+			}
 
-	pthread_mutex_unlock(&video->data_mutex);
+		pthread_mutex_unlock(&frame_info->tracked_mutex);
+	}
 
 	/* -------------------------------- */
 
@@ -174,12 +344,19 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (!frame)
 			continue;
 
+		struct video_data_container *container =
+			copy_container(frame->container);
+
 		if (tracked_frame) {
-			frame->container->data.tracked_id = tracked_id;
-			blog(LOG_INFO, "video-io: Outputting (duplicated) tracked frame %lld", tracked_id);
+			if (container->texture)
+				container->tex.tracked_id = tracked_id;
+			else
+				container->data.tracked_id = tracked_id;
+			if (!video_frame_is_trace_sample(tracked_id))
+				blog(LOG_INFO, "video-io: Outputting (duplicated) tracked frame %lld", tracked_id);
 		}
 
-		input->callback(input->param, frame->container);
+		video_input_dispatch(input, container);
 	}
 
 	for (size_t i = 0; i < video->maybe_expired_scale_info.num;) {
@@ -211,34 +388,39 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
+	pthread_mutex_lock(&frame_info->tracked_mutex);
 
-	if (tracked_frame) {
-		for (size_t i = 0; i < frame_info->tracked_ids.num; i++) {
-			if (frame_info->tracked_ids.array[i].id == tracked_id) {
-				da_erase(frame_info->tracked_ids, i);
-				break;
-			}
+	for (size_t i = 0; i < frame_info->tracked_ids.num;) {
+		if (--frame_info->tracked_ids.array[i].count == 0) {
+			da_erase(frame_info->tracked_ids, i);
+			os_atomic_dec_long(&frame_info->num_tracked_ids);
+			continue;
 		}
+
+		i += 1;
 	}
 
-	complete = --frame_info->count == 0;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
-	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
-
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+	pthread_mutex_unlock(&frame_info->tracked_mutex);
 
+	if (complete) {
 		for (size_t i = 0; i < frame_info->frames.num; i++) {
 			struct cached_video_data *frame = frame_info->frames.array + i;
 			if (frame->container->refs == 0 && frame->container->texture) {
 				obs_output_texture_release(frame->container->texture);
 				frame->container->texture = NULL;
+			} else if (frame->container->refs == 0 && frame->container->mapped) {
+				release_mapped_frame(frame->container);
 			}
 		}
 
+		if (++video->read_idx == video->info.cache_size)
+			video->read_idx = 0;
+
+		/* hands the slot back to the graphics thread */
+		os_atomic_dec_long(&video->occupied);
+
 	} else {
 		for (size_t i = 0; i < frame_info->frames.num; i++) {
 			struct cached_video_data *frame = frame_info->frames.array + i;
@@ -250,11 +432,9 @@ static inline bool video_output_cur_frame(struct video_output *video)
 				frame->container->data.tracked_id = 0;
 			}
 		}
-		++video->skipped_frames;
+		os_atomic_inc_long(&video->skipped_frames);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	return complete;
@@ -276,10 +456,10 @@ static void *video_thread(void *param)
 
 		profile_start(video_thread_name);
 		while (!video->stop && !video_output_cur_frame(video)) {
-			video->total_frames++;
+			os_atomic_inc_long(&video->total_frames);
 		}
 
-		video->total_frames++;
+		os_atomic_inc_long(&video->total_frames);
 		profile_end(video_thread_name);
 
 		profile_reenable_thread();
@@ -295,17 +475,45 @@ static inline bool valid_video_params(const struct video_output_info *info)
 	return info->fps_den != 0 && info->fps_num != 0;
 }
 
-static inline void init_cache(struct video_output *video)
+/* a full cache repeats its newest frame, which must not be the slot the
+ * video thread is currently outputting, so at least two slots are needed */
+static inline bool init_cache(struct video_output *video)
 {
-	if (video->info.cache_size > MAX_CACHE_SIZE)
-		video->info.cache_size = MAX_CACHE_SIZE;
+	if (!video->info.cache_size)
+		video->info.cache_size = DEFAULT_CACHE_SIZE;
+	else if (video->info.cache_size < 2)
+		video->info.cache_size = 2;
+
+	video->cache = bzalloc(sizeof(struct cached_frame_info) *
+			video->info.cache_size);
 
 	for (size_t i = 0; i < video->info.cache_size; i++) {
-		da_init(video->cache[i].frames);
-		da_init(video->cache[i].tracked_ids);
+		if (pthread_mutex_init(&video->cache[i].tracked_mutex,
+					NULL) != 0) {
+			video->info.cache_size = i;
+			return false;
+		}
 	}
 
-	video->available_frames = video->info.cache_size;
+	return true;
+}
+
+static void free_cache(struct video_output *video)
+{
+	if (!video->cache)
+		return;
+
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		struct cached_frame_info *cfi = video->cache + i;
+		for (size_t j = 0; j < cfi->frames.num; j++)
+			video_data_container_release(cfi->frames.array[j].container);
+		da_free(cfi->frames);
+		da_free(cfi->tracked_ids);
+		pthread_mutex_destroy(&cfi->tracked_mutex);
+	}
+
+	bfree(video->cache);
+	video->cache = NULL;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -329,19 +537,17 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->data_mutex, &attr) != 0)
-		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
 	if (pthread_mutex_init(&out->scale_info_mutex, &attr) != 0)
 		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
+	if (!init_cache(out))
+		goto fail;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail;
 
-	init_cache(out);
-
 	out->initialized = true;
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
@@ -362,16 +568,9 @@ void video_output_close(video_t *video)
 		video_input_free(&video->inputs.array[i]);
 	da_free(video->inputs);
 
-	for (size_t i = 0; i < video->info.cache_size; i++) {
-		struct cached_frame_info *cfi = video->cache + i;
-		for (size_t j = 0; j < cfi->frames.num; j++)
-			video_data_container_release(cfi->frames.array[j].container);
-		da_free(video->cache[i].frames);
-		da_free(video->cache[i].tracked_ids);
-	}
+	free_cache(video);
 
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 	pthread_mutex_destroy(&video->scale_info_mutex);
 	bfree(video);
@@ -390,9 +589,46 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static bool video_input_worker_init(struct video_input *input,
+		struct video_output *video)
+{
+	struct video_input_worker *worker = bzalloc(sizeof(*worker));
+
+	worker->callback = input->callback;
+	worker->param = input->param;
+	worker->queue_limit = video->info.cache_size ?
+		video->info.cache_size : 1;
+	worker->profile_name = profile_store_name(
+			obs_get_profiler_name_store(),
+			"video_input_thread(%s)", video->info.name);
+
+	if (pthread_mutex_init(&worker->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&worker->sem, 0) != 0)
+		goto fail_sem;
+	if (pthread_create(&worker->thread, NULL, video_input_thread,
+				worker) != 0)
+		goto fail_thread;
+
+	input->worker = worker;
+	return true;
+
+fail_thread:
+	os_sem_destroy(worker->sem);
+fail_sem:
+	pthread_mutex_destroy(&worker->mutex);
+fail_mutex:
+	blog(LOG_ERROR, "video_input_init: Failed to create input thread");
+	bfree(worker);
+	return false;
+}
+
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
+	if (!video_input_worker_init(input, video))
+		return false;
+
 #if 0
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
@@ -448,8 +684,9 @@ bool video_output_connect(video_t *video,
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video->inputs.num == 0) {
-		video->skipped_frames = 0;
-		video->total_frames = 0;
+		os_atomic_set_long(&video->skipped_frames, 0);
+		os_atomic_set_long(&video->total_frames, 0);
+		os_atomic_set_long(&video->max_occupied, 0);
 	}
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
@@ -524,7 +761,11 @@ void video_output_disconnect(video_t *video,
 
 		da_free(removed);
 
+		pthread_mutex_unlock(&video->input_mutex);
+
+		/* waits for the worker to finish the frame it is on */
 		video_input_free(&input);
+		return;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -611,6 +852,32 @@ static void alloc_frame(struct video_data *data)
 		data->info.width, data->info.height, false);
 }
 
+/* the tracked id has to be registered before the video thread can output
+ * the added duplicates, otherwise it would miss (some of) them */
+static bool duplicate_tracked_frame(struct cached_frame_info *last,
+		int count, video_tracked_frame_id tracked_id)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&last->tracked_mutex);
+
+	long last_count = os_atomic_load_long(&last->count);
+	if (last_count > 0 && os_atomic_compare_swap_long(&last->count,
+				last_count, last_count + count)) {
+		struct track_duplicated_frame track = {
+			last_count + count,
+			tracked_id
+		};
+
+		da_push_back(last->tracked_ids, &track);
+		os_atomic_inc_long(&last->num_tracked_ids);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&last->tracked_mutex);
+	return success;
+}
+
 video_locked_frame video_output_lock_frame(video_t *video,
 		size_t num_buffers_hint,
 		int count, uint64_t timestamp, video_tracked_frame_id tracked_id)
@@ -619,39 +886,47 @@ video_locked_frame video_output_lock_frame(video_t *video,
 
 	if (!video) return cfi;
 
-	pthread_mutex_lock(&video->data_mutex);
+	for (;;) {
+		size_t size = video->info.cache_size;
+		long occupied = os_atomic_load_long(&video->occupied);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
+		if ((size_t)occupied < size) {
+			cfi = &video->cache[video->write_idx];
+			cfi->count = count;
+			cfi->timestamp = timestamp;
+			cfi->tracked_id = tracked_id;
+			cfi->frames_written = 0;
 
-		if (tracked_id) {
-			struct track_duplicated_frame track = {
-				video->cache[video->last_added].count,
-				tracked_id
-			};
-			da_push_back(video->cache[video->last_added].tracked_ids, &track);
-			blog(LOG_INFO, "video-io: Tracked frame %lld will be duplicated", tracked_id);
+			da_reserve(cfi->frames, num_buffers_hint);
+
+			da_resize(cfi->tracked_ids, 0);
+			cfi->num_tracked_ids = 0;
+			break;
 		}
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+		/* the cache is full, repeat the newest frame.  the video
+		 * thread may finish it at any moment, in which case a slot has
+		 * just been freed up and the frame can be cached after all */
+		struct cached_frame_info *last =
+			&video->cache[(video->write_idx + size - 1) % size];
+		if (tracked_id) {
+			if (!duplicate_tracked_frame(last, count, tracked_id))
+				continue;
+
+			blog(LOG_INFO, "video-io: Tracked frame %lld will be duplicated", tracked_id);
+			break;
 		}
 
-		cfi = &video->cache[video->last_added];
-		cfi->count = count;
-		cfi->timestamp = timestamp;
-		cfi->tracked_id = tracked_id;
-		cfi->frames_written = 0;
+		long last_count = os_atomic_load_long(&last->count);
 
-		da_reserve(cfi->frames, num_buffers_hint);
+		if (last_count <= 0 || !os_atomic_compare_swap_long(
+					&last->count, last_count,
+					last_count + count))
+			continue;
 
-		da_resize(cfi->tracked_ids, 0);
+		break;
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	return cfi;
 }
 
@@ -684,6 +959,8 @@ static struct cached_video_data *add_data(struct cached_frame_info *cfi, struct
 		} else if (data->container->refs == 0 && data->container->texture) {
 			obs_output_texture_release(data->container->texture);
 			data->container->texture = NULL;
+		} else if (data->container->refs == 0 && data->container->mapped) {
+			release_mapped_frame(data->container);
 		}
 	}
 
@@ -709,6 +986,10 @@ bool video_output_get_frame_buffer(video_t *video,
 
 	struct cached_video_data *data = add_data(cfi, info, expiring);
 
+	/* the buffer was dropped if the container last held a lent frame */
+	if (!data->container->data.data[0])
+		alloc_frame(&data->container->data);
+
 	data->container->data.timestamp = cfi->timestamp;
 	data->container->data.tracked_id = cfi->tracked_id;
 
@@ -716,6 +997,28 @@ bool video_output_get_frame_buffer(video_t *video,
 	return true;
 }
 
+bool video_output_lend_frame(video_t *video, obs_output_texture_t *output_tex,
+	const struct video_frame *frame, struct video_scale_info *info, video_locked_frame locked, bool expiring)
+{
+	if (!locked || !info || !frame || info->texture_output) return false;
+
+	struct cached_frame_info *cfi = locked;
+
+	struct cached_video_data *data = add_data(cfi, info, expiring);
+
+	if (!data->container->mapped)
+		video_frame_free((struct video_frame*)&data->container->data);
+
+	obs_output_texture_addref(output_tex);
+	data->container->mapped = output_tex;
+
+	memcpy(&data->container->data, frame, sizeof(*frame));
+	data->container->data.timestamp = cfi->timestamp;
+	data->container->data.tracked_id = cfi->tracked_id;
+
+	return true;
+}
+
 bool video_output_add_texture(video_t *video, obs_output_texture_t *output_tex,
 	struct video_texture *video_tex, struct video_scale_info *info, video_locked_frame locked, bool expiring)
 {
@@ -757,12 +1060,15 @@ void video_output_unlock_frame(video_t *video, video_locked_frame locked)
 		da_erase(cfi->frames, i);
 	}
 
-	pthread_mutex_lock(&video->data_mutex);
+	if (++video->write_idx == video->info.cache_size)
+		video->write_idx = 0;
 
-	video->available_frames--;
-	os_sem_post(video->update_semaphore);
+	long occupied = os_atomic_inc_long(&video->occupied);
+	long max_occupied = os_atomic_load_long(&video->max_occupied);
+	if (occupied > max_occupied)
+		os_atomic_set_long(&video->max_occupied, occupied);
 
-	pthread_mutex_unlock(&video->data_mutex);
+	os_sem_post(video->update_semaphore);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
@@ -812,12 +1118,50 @@ bool video_get_output_texture_size(struct video_scale_info *info, struct video_t
 
 uint32_t video_output_get_skipped_frames(const video_t *video)
 {
-	return video->skipped_frames;
+	return (uint32_t)os_atomic_load_long(&video->skipped_frames);
 }
 
 uint32_t video_output_get_total_frames(const video_t *video)
 {
-	return video->total_frames;
+	return (uint32_t)os_atomic_load_long(&video->total_frames);
+}
+
+bool video_output_get_stats(const video_t *video,
+		struct video_output_stats *stats)
+{
+	if (!video || !stats)
+		return false;
+
+	stats->cache_size = video->info.cache_size;
+	stats->cache_occupancy =
+		(size_t)os_atomic_load_long(&video->occupied);
+	stats->max_cache_occupancy =
+		(size_t)os_atomic_load_long(&video->max_occupied);
+	stats->total_frames =
+		(uint32_t)os_atomic_load_long(&video->total_frames);
+	stats->skipped_frames =
+		(uint32_t)os_atomic_load_long(&video->skipped_frames);
+	return true;
+}
+
+uint32_t video_output_get_input_dropped_frames(video_t *video,
+		video_data_callback callback, void *param)
+{
+	uint32_t dropped = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		dropped = (uint32_t)os_atomic_load_long(
+				&video->inputs.array[idx].worker->dropped_frames);
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return dropped;
 }
 
 bool video_output_get_changes(video_t *video, video_scale_info_ts *added,
@@ -872,9 +1216,17 @@ void video_data_container_release(struct video_data_container *container)
 	if (os_atomic_dec_long(&container->refs) != -1)
 		return;
 
+	if (container->parent) {
+		video_data_container_release(container->parent);
+		bfree(container);
+		return;
+	}
+
 	if (container->using_texture) {
 		if (container->texture)
 			obs_output_texture_release(container->texture);
+	} else if (container->mapped) {
+		obs_output_texture_release(container->mapped);
 	} else
 		video_frame_free((struct video_frame*)&container->data);
 
@@ -36,6 +36,15 @@ typedef struct video_output video_t;
 
 typedef uint64_t video_tracked_frame_id;
 
+/* frames sampled for lifecycle tracing get IDs of their own with this bit
+ * set, so they aren't taken for frames tracked on request */
+#define VIDEO_FRAME_TRACE_SAMPLE_ID (1ULL << 62)
+
+static inline bool video_frame_is_trace_sample(video_tracked_frame_id id)
+{
+	return (id & VIDEO_FRAME_TRACE_SAMPLE_ID) != 0;
+}
+
 enum video_format {
 	VIDEO_FORMAT_NONE,
 
@@ -77,6 +86,16 @@ struct video_output_info {
 	size_t            cache_size;
 };
 
+/* frame cache ring statistics, occupancy is the number of rendered frames
+ * waiting for the video thread */
+struct video_output_stats {
+	size_t            cache_size;
+	size_t            cache_occupancy;
+	size_t            max_cache_occupancy;
+	uint32_t          total_frames;
+	uint32_t          skipped_frames;
+};
+
 typedef void *video_locked_frame;
 
 static inline bool format_is_yuv(enum video_format format)
@@ -213,6 +232,11 @@ EXPORT bool video_output_get_frame_buffer(video_t *video,
 		struct video_frame *frame, struct video_scale_info *info, video_locked_frame locked, bool expiring);
 EXPORT bool video_output_add_texture(video_t *video, obs_output_texture_t *output_tex,
 		struct video_texture *video_tex, struct video_scale_info *info, video_locked_frame locked, bool expiring);
+/* hands a frame that already has the output's layout to video-io without
+ * copying it, the frame data must stay valid until the last reference to
+ * output_tex is released */
+EXPORT bool video_output_lend_frame(video_t *video, obs_output_texture_t *output_tex,
+		const struct video_frame *frame, struct video_scale_info *info, video_locked_frame locked, bool expiring);
 EXPORT void video_output_unlock_frame(video_t *video, video_locked_frame locked);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
@@ -223,6 +247,11 @@ EXPORT bool video_get_output_texture_size(struct video_scale_info *info, struct
 
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
+EXPORT bool video_output_get_stats(const video_t *video,
+		struct video_output_stats *stats);
+/* frames dropped for a single input because its callback fell behind */
+EXPORT uint32_t video_output_get_input_dropped_frames(video_t *video,
+		video_data_callback callback, void *param);
 
 EXPORT bool video_output_get_changes(video_t *video, video_scale_info_ts *added,
 		video_scale_info_ts *expiring, video_scale_info_ts *removed);
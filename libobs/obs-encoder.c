@@ -748,6 +748,9 @@ static inline void do_encode(struct obs_encoder *encoder,
 			}
 		}
 
+		obs_frame_trace_mark(pkt.tracked_id,
+				OBS_FRAME_TRACE_ENCODE_RETURN);
+
 		profile_start(encoder->profile_encoder_callback_mutex_name);
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
@@ -768,6 +771,18 @@ end_profile:
 }
 
 static const char *receive_video_name = "receive_video";
+/* video-io drops frames for encoders that fall behind, so the pts follows
+ * the frame timestamps instead of counting received frames */
+static inline int64_t get_video_pts(struct obs_encoder *encoder,
+		uint64_t timestamp)
+{
+	uint64_t frame_time = video_output_get_frame_time(encoder->media);
+	uint64_t frames = (timestamp - encoder->start_ts + frame_time / 2) /
+		frame_time;
+
+	return (int64_t)frames * encoder->timebase_num;
+}
+
 static void receive_video(void *param, struct video_data_container *container)
 {
 	profile_start(receive_video_name);
@@ -776,6 +791,13 @@ static void receive_video(void *param, struct video_data_container *container)
 	struct video_data     *frame    = video_data_from_container(container);
 	struct video_texture  *tex      = video_texture_from_container(container);
 	struct encoder_frame  enc_frame;
+	video_tracked_frame_id tracked_id = 0;
+
+	if (frame)
+		tracked_id = frame->tracked_id;
+	else if (tex)
+		tracked_id = tex->tracked_id;
+	obs_frame_trace_mark(tracked_id, OBS_FRAME_TRACE_DISPATCH);
 
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
@@ -784,6 +806,7 @@ static void receive_video(void *param, struct video_data_container *container)
 	if (frame) {
 		if (!encoder->start_ts)
 			encoder->start_ts = frame->timestamp;
+		enc_frame.pts = get_video_pts(encoder, frame->timestamp);
 
 		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
 			enc_frame.data[i] = frame->data[i];
@@ -801,6 +824,7 @@ static void receive_video(void *param, struct video_data_container *container)
 	} else if (tex) {
 		if (!encoder->start_ts)
 			encoder->start_ts = tex->timestamp;
+		enc_frame.pts = get_video_pts(encoder, tex->timestamp);
 
 		enc_frame.is_texture = true;
 		enc_frame.tex = tex->tex;
@@ -817,9 +841,10 @@ static void receive_video(void *param, struct video_data_container *container)
 		}
 	}
 
+	obs_frame_trace_mark(tracked_id, OBS_FRAME_TRACE_ENCODE_SUBMIT);
 	do_encode(encoder, &enc_frame);
 
-	encoder->cur_pts += encoder->timebase_num;
+	encoder->cur_pts = enc_frame.pts + encoder->timebase_num;
 
 	profile_end(receive_video_name);
 }
@@ -951,6 +976,46 @@ void obs_free_encoder_packet(struct encoder_packet *packet)
 	memset(packet, 0, sizeof(struct encoder_packet));
 }
 
+void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	long *p_refs;
+
+	*dst = *src;
+	p_refs = bmalloc(src->size + sizeof(long));
+	dst->data = (void*)(p_refs + 1);
+	*p_refs = 1;
+	memcpy(dst->data, src->data, src->size);
+}
+
+void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	if (!src)
+		return;
+
+	if (src->data) {
+		long *p_refs = ((long*)src->data) - 1;
+		os_atomic_inc_long(p_refs);
+	}
+
+	*dst = *src;
+}
+
+void obs_encoder_packet_release(struct encoder_packet *packet)
+{
+	if (!packet)
+		return;
+
+	if (packet->data) {
+		long *p_refs = ((long*)packet->data) - 1;
+		if (os_atomic_dec_long(p_refs) == 0)
+			bfree(p_refs);
+	}
+
+	memset(packet, 0, sizeof(struct encoder_packet));
+}
+
 void obs_encoder_addref(obs_encoder_t *encoder)
 {
 	if (!encoder)
@@ -0,0 +1,160 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/*
+ * Frame lifecycle tracer.  Traces are kept in a small ring indexed by
+ * tracked frame ID, so only the last OBS_FRAME_TRACE_HISTORY traced frames
+ * can be queried.  Sampled frames are numbered separately from frames
+ * tracked with obs_track_next_frame, see VIDEO_FRAME_TRACE_SAMPLE_ID.
+ * Only traced frames take the tracer mutex, untraced frames
+ * (tracked_id == 0) return before touching any shared state.
+ */
+
+static const char *stage_names[OBS_FRAME_TRACE_STAGE_COUNT] = {
+	"render",
+	"stage",
+	"download",
+	"convert",
+	"dispatch",
+	"encode_submit",
+	"encode_return",
+	"interleave",
+	"send"
+};
+
+static inline struct obs_frame_trace *get_trace(
+		struct obs_frame_tracer *tracer, video_tracked_frame_id id)
+{
+	return &tracer->traces[id % OBS_FRAME_TRACE_HISTORY];
+}
+
+void obs_frame_trace_begin(struct obs_core_video *video,
+		video_tracked_frame_id id, uint64_t timestamp,
+		uint64_t render_ts)
+{
+	struct obs_frame_tracer *tracer = &video->frame_tracer;
+	struct obs_frame_trace *trace;
+
+	if (!id)
+		return;
+
+	pthread_mutex_lock(&tracer->mutex);
+	trace = get_trace(tracer, id);
+	memset(trace, 0, sizeof(*trace));
+	trace->id = id;
+	trace->timestamp = timestamp;
+	trace->stage_ts[OBS_FRAME_TRACE_RENDER] = render_ts;
+	pthread_mutex_unlock(&tracer->mutex);
+}
+
+/* called from the graphics thread while frame_tracker_mutex is held */
+video_tracked_frame_id obs_frame_trace_sample(struct obs_core_video *video)
+{
+	struct obs_frame_tracer *tracer = &video->frame_tracer;
+	uint32_t interval = tracer->sample_interval;
+
+	if (!interval || video->total_frames < tracer->next_sample_frame)
+		return 0;
+
+	tracer->next_sample_frame = video->total_frames + interval;
+	tracer->last_sample_id = (tracer->last_sample_id + 1) &
+		(VIDEO_FRAME_TRACE_SAMPLE_ID - 1);
+	return VIDEO_FRAME_TRACE_SAMPLE_ID | tracer->last_sample_id;
+}
+
+void obs_frame_trace_set_sample_interval(uint32_t frames)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->video.frame_tracker_mutex);
+	obs->video.frame_tracer.sample_interval = frames;
+	obs->video.frame_tracer.next_sample_frame = 0;
+	pthread_mutex_unlock(&obs->video.frame_tracker_mutex);
+}
+
+uint32_t obs_frame_trace_get_sample_interval(void)
+{
+	uint32_t interval;
+
+	if (!obs)
+		return 0;
+
+	pthread_mutex_lock(&obs->video.frame_tracker_mutex);
+	interval = obs->video.frame_tracer.sample_interval;
+	pthread_mutex_unlock(&obs->video.frame_tracker_mutex);
+	return interval;
+}
+
+void obs_frame_trace_mark(video_tracked_frame_id id,
+		enum obs_frame_trace_stage stage)
+{
+	struct obs_frame_tracer *tracer;
+	struct obs_frame_trace *trace;
+	uint64_t ts;
+	bool marked = false;
+
+	if (!id || !obs || stage >= OBS_FRAME_TRACE_STAGE_COUNT)
+		return;
+
+	ts = os_gettime_ns();
+	tracer = &obs->video.frame_tracer;
+
+	pthread_mutex_lock(&tracer->mutex);
+	trace = get_trace(tracer, id);
+	if (trace->id == id && !trace->stage_ts[stage]) {
+		trace->stage_ts[stage] = ts;
+		marked = true;
+	}
+	pthread_mutex_unlock(&tracer->mutex);
+
+	if (marked && (stage == OBS_FRAME_TRACE_INTERLEAVE ||
+	               stage == OBS_FRAME_TRACE_SEND)) {
+		struct calldata params = {0};
+		calldata_set_int(&params, "id", (long long)id);
+		calldata_set_int(&params, "stage", stage);
+		signal_handler_signal(obs->signals, "frame_traced", &params);
+		calldata_free(&params);
+	}
+}
+
+bool obs_frame_trace_get(video_tracked_frame_id id,
+		struct obs_frame_trace *trace)
+{
+	struct obs_frame_tracer *tracer;
+	bool found;
+
+	if (!id || !obs || !trace)
+		return false;
+
+	tracer = &obs->video.frame_tracer;
+
+	pthread_mutex_lock(&tracer->mutex);
+	found = get_trace(tracer, id)->id == id;
+	if (found)
+		*trace = *get_trace(tracer, id);
+	pthread_mutex_unlock(&tracer->mutex);
+
+	return found;
+}
+
+const char *obs_frame_trace_stage_name(enum obs_frame_trace_stage stage)
+{
+	if (stage >= OBS_FRAME_TRACE_STAGE_COUNT)
+		return NULL;
+	return stage_names[stage];
+}
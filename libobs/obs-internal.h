@@ -231,6 +231,7 @@ struct obs_vframe_info {
 	int count;
 
 	video_tracked_frame_id tracked_id;
+	uint64_t render_ts;
 
 	int uses;
 
@@ -261,6 +262,9 @@ struct obs_active_texture {
 	obs_output_texture_t *tex;
 	obs_vframe_info_t    *vframe_info;
 	obs_video_outputs_t  outputs;
+
+	/* frames since the texture was staged, copy surfaces only */
+	uint32_t             age;
 };
 typedef struct obs_active_texture obs_active_texture_t;
 
@@ -276,9 +280,20 @@ struct obs_texture_pipeline {
 	obs_active_textures_t         active;
 	obs_active_textures_t         ready;
 	DARRAY(obs_video_outputs_t)   idle_output_lists;
+
+	/* readback ring, copy surface pipelines queue staged surfaces in
+	 * ready until their copy completes or they are depth frames old */
+	uint32_t                      readback_depth;
+	uint32_t                      readback_window;
+	uint32_t                      readback_max_latency;
 };
 typedef struct obs_texture_pipeline obs_texture_pipeline_t;
 
+#define OBS_MAX_READBACK_DEPTH 8
+#define OBS_READBACK_WINDOW    300
+
+#define OBS_DEFAULT_PACING_SPIN_US 500
+
 typedef DARRAY(obs_texture_pipeline_t) obs_texture_pipelines_t;
 
 struct obs_video_output {
@@ -298,6 +313,54 @@ struct obs_video_output {
 	struct video_scale_info info;
 };
 
+/* ------------------------------------------------------------------------- */
+/* frame lifecycle tracer */
+
+#define OBS_FRAME_TRACE_HISTORY 64
+
+struct obs_frame_tracer {
+	pthread_mutex_t                 mutex;
+	uint32_t                        sample_interval;
+	uint32_t                        next_sample_frame;
+	video_tracked_frame_id          last_sample_id;
+	struct obs_frame_trace          traces[OBS_FRAME_TRACE_HISTORY];
+};
+
+/* ------------------------------------------------------------------------- */
+/* CPU conversion worker pool */
+
+#define OBS_MAX_CONVERSION_THREADS 16
+
+enum obs_convert_band_type {
+	OBS_CONVERT_BAND_CONVERT,
+	OBS_CONVERT_BAND_COPY_RGBX,
+	OBS_CONVERT_BAND_COPY_PLANE,
+	OBS_CONVERT_BAND_COPY_DEALIGN
+};
+
+/* one slice of an output frame: rows for conversion/RGBX copies, bytes of a
+ * plane for GPU converted data */
+struct obs_convert_band {
+	enum obs_convert_band_type type;
+	const obs_video_output_t   *output;
+	const struct video_frame   *frame;
+	struct video_frame         output_frame;
+	uint32_t                   plane;
+	uint32_t                   start;
+	uint32_t                   end;
+};
+
+struct obs_convert_pool {
+	long                            requested_threads;
+	DARRAY(pthread_t)               threads;
+	os_sem_t                        *work_sem;
+	os_sem_t                        *done_sem;
+	volatile bool                   stop;
+
+	DARRAY(struct obs_convert_band) bands;
+	volatile long                   next_band;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
 	obs_texture_pipeline_t          render_textures;
@@ -336,10 +399,21 @@ struct obs_core_video {
 	uint32_t                        base_width;
 	uint32_t                        base_height;
 
+	volatile long                   conversion_threads;
+	struct obs_convert_pool         convert_pool;
+
+	volatile long                   readback_depth;
+
+	enum obs_video_pacing           pacing;
+	uint64_t                        pacing_spin_ns;
+	bool                            pacing_realtime;
+
 	pthread_mutex_t                 frame_tracker_mutex;
 	video_tracked_frame_id          last_tracked_frame_id;
 	video_tracked_frame_id          tracked_frame_id;
 
+	struct obs_frame_tracer         frame_tracer;
+
 	struct {
 		pthread_mutex_t             mutex;
 		DARRAY(gs_texture_t*)       textures;
@@ -353,6 +427,12 @@ struct obs_core_video {
 
 extern void obs_free_deferred_gs_data(void);
 
+extern void obs_frame_trace_begin(struct obs_core_video *video,
+		video_tracked_frame_id id, uint64_t timestamp,
+		uint64_t render_ts);
+extern video_tracked_frame_id obs_frame_trace_sample(
+		struct obs_core_video *video);
+
 
 struct obs_core_audio {
 	/* TODO: sound output subsystem */
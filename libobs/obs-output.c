@@ -127,7 +127,7 @@ fail:
 static inline void free_packets(struct obs_output *output)
 {
 	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_free_encoder_packet(output->interleaved_packets.array+i);
+		obs_encoder_packet_release(output->interleaved_packets.array+i);
 	da_free(output->interleaved_packets);
 }
 
@@ -615,6 +615,19 @@ obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
 	return output->audio_encoders[idx];
 }
 
+int64_t obs_output_get_packet_offset(const obs_output_t *output,
+		enum obs_encoder_type type, size_t track_idx)
+{
+	if (!obs_output_valid(output, "obs_output_get_packet_offset"))
+		return 0;
+
+	if (type == OBS_ENCODER_VIDEO)
+		return output->video_offset;
+
+	return track_idx < MAX_AUDIO_MIXES ?
+		output->audio_offsets[track_idx] : 0;
+}
+
 void obs_output_set_service(obs_output_t *output, obs_service_t *service)
 {
 	if (!obs_output_valid(output, "obs_output_set_service"))
@@ -1000,11 +1013,14 @@ static inline void send_interleaved(struct obs_output *output)
 
 	da_erase(output->interleaved_packets, 0);
 	if (output->started) {
+		obs_frame_trace_mark(out.tracked_id,
+				OBS_FRAME_TRACE_INTERLEAVE);
 		output->info.encoded_packet(output->context.data, &out);
 
 		update_timestamps(output, &out);
 
-		if (out.tracked_id) {
+		if (out.tracked_id &&
+		    !video_frame_is_trace_sample(out.tracked_id)) {
 			struct calldata params = {0};
 			calldata_set_int(&params, "id", out.tracked_id);
 			calldata_set_int(&params, "frame_number",
@@ -1021,7 +1037,7 @@ static inline void send_interleaved(struct obs_output *output)
 			handle_queued_stop(output, &out);
 	}
 
-	obs_free_encoder_packet(&out);
+	obs_encoder_packet_release(&out);
 }
 
 static inline void set_higher_ts(struct obs_output *output,
@@ -1071,7 +1087,7 @@ static void prune_interleaved_packets(struct obs_output *output)
 		for (size_t i = 0; i < start_idx; i++) {
 			struct encoder_packet *packet =
 				&output->interleaved_packets.array[i];
-			obs_free_encoder_packet(packet);
+			obs_encoder_packet_release(packet);
 		}
 
 		da_erase_range(output->interleaved_packets, 0, start_idx);
@@ -1184,7 +1200,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_duplicate_encoder_packet(&out, packet);
+		obs_encoder_packet_create_instance(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
@@ -1224,7 +1240,7 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 		update_timestamps(output, packet);
 	}
 	if (output->active_delay_ns)
-		obs_free_encoder_packet(packet);
+		obs_encoder_packet_release(packet);
 
 	if (packet->type == OBS_ENCODER_VIDEO)
 		output->total_frames++;
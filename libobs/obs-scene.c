@@ -52,9 +52,8 @@ static const char *scene_getname(void *unused)
 static void *scene_create(obs_data_t *settings, struct obs_source *source)
 {
 	pthread_mutexattr_t attr;
-	struct obs_scene *scene = bmalloc(sizeof(struct obs_scene));
+	struct obs_scene *scene = bzalloc(sizeof(struct obs_scene));
 	scene->source     = source;
-	scene->first_item = NULL;
 
 	signal_handler_add_array(obs_source_get_signal_handler(source),
 			obs_scene_signals);
@@ -100,6 +99,7 @@ static void scene_destroy(void *data)
 	struct obs_scene *scene = data;
 
 	remove_all_items(scene);
+	da_free(scene->occluders);
 	pthread_mutex_destroy(&scene->mutex);
 	bfree(scene);
 }
@@ -299,18 +299,161 @@ static inline bool source_size_changed(struct obs_scene_item *item)
 	return item->last_width != width || item->last_height != height;
 }
 
+static inline void update_draw_corners(struct obs_scene_item *item)
+{
+	float cx = (float)obs_source_get_width(item->source);
+	float cy = (float)obs_source_get_height(item->source);
+
+	vec3_set(&item->draw_corners[0], 0.0f, 0.0f, 0.0f);
+	vec3_set(&item->draw_corners[1], cx,   0.0f, 0.0f);
+	vec3_set(&item->draw_corners[2], cx,   cy,   0.0f);
+	vec3_set(&item->draw_corners[3], 0.0f, cy,   0.0f);
+
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(&item->draw_corners[i], &item->draw_corners[i],
+				&item->draw_transform);
+}
+
+static inline float corners_area(const struct vec3 *corners)
+{
+	struct vec3 a, b;
+	vec3_sub(&a, &corners[1], &corners[0]);
+	vec3_sub(&b, &corners[3], &corners[0]);
+	return fabsf(a.x * b.y - a.y * b.x);
+}
+
+/* tolerance in scene pixels, so that items sharing an edge with the item
+ * covering them aren't kept around because of rounding */
+#define COVER_EPSILON 0.001f
+
+static bool point_in_corners(const struct vec3 *corners, const struct vec3 *p)
+{
+	struct vec3 a, b;
+	vec3_sub(&a, &corners[1], &corners[0]);
+	vec3_sub(&b, &corners[3], &corners[0]);
+
+	/* the corners wind the other way if the item is flipped */
+	float winding = (a.x * b.y - a.y * b.x) < 0.0f ? -1.0f : 1.0f;
+
+	for (size_t i = 0; i < 4; i++) {
+		const struct vec3 *v0 = &corners[i];
+		const struct vec3 *v1 = &corners[(i + 1) & 3];
+		float ex  = v1->x - v0->x;
+		float ey  = v1->y - v0->y;
+		float len = sqrtf(ex * ex + ey * ey);
+		float dist = (ex * (p->y - v0->y) - ey * (p->x - v0->x)) / len;
+
+		if (dist * winding < -COVER_EPSILON)
+			return false;
+	}
+
+	return true;
+}
+
+static inline bool item_covered_by(const struct obs_scene_item *item,
+		const struct obs_scene_item *cover)
+{
+	for (size_t i = 0; i < 4; i++)
+		if (!point_in_corners(cover->draw_corners,
+					&item->draw_corners[i]))
+			return false;
+	return true;
+}
+
+static inline bool item_off_canvas(const struct obs_scene_item *item,
+		float cx, float cy)
+{
+	const struct vec3 *c = item->draw_corners;
+
+	return (c[0].x <= 0.0f && c[1].x <= 0.0f &&
+	        c[2].x <= 0.0f && c[3].x <= 0.0f) ||
+	       (c[0].y <= 0.0f && c[1].y <= 0.0f &&
+	        c[2].y <= 0.0f && c[3].y <= 0.0f) ||
+	       (c[0].x >= cx && c[1].x >= cx &&
+	        c[2].x >= cx && c[3].x >= cx) ||
+	       (c[0].y >= cy && c[1].y >= cy &&
+	        c[2].y >= cy && c[3].y >= cy);
+}
+
+static inline bool item_is_occluder(const struct obs_scene_item *item)
+{
+	const struct obs_source *source = item->source;
+	uint32_t flags = source->info.output_flags;
+
+	/* disabled sources (and sources without data) don't draw anything */
+	if (!source->enabled || !source->context.data)
+		return false;
+
+	if ((flags & OBS_SOURCE_OPAQUE) == 0 || source->filters.num != 0 ||
+	    corners_area(item->draw_corners) <= 0.0f)
+		return false;
+
+	return !source->info.is_opaque ||
+		source->info.is_opaque(source->context.data);
+}
+
+/* nested scenes don't clip their items to their own size, so off-canvas
+ * culling is only done when the scene is drawn directly onto its canvas */
+static inline bool scene_drawn_on_canvas(void)
+{
+	struct matrix4 cur, identity;
+
+	gs_matrix_get(&cur);
+	matrix4_identity(&identity);
+	return memcmp(&cur, &identity, sizeof(struct matrix4)) == 0;
+}
+
+/* walks the items from the top down, marking the ones that can't be seen
+ * because they lie outside of the canvas or beneath an opaque item */
+static void cull_items(struct obs_scene *scene, struct obs_scene_item *last)
+{
+	bool     check_canvas = scene_drawn_on_canvas();
+	float    cx           = (float)obs->video.base_width;
+	float    cy           = (float)obs->video.base_height;
+	uint32_t occluded     = 0;
+	uint32_t off_canvas   = 0;
+
+	da_resize(scene->occluders, 0);
+
+	for (struct obs_scene_item *item = last; item; item = item->prev) {
+		item->culled = false;
+
+		if (!item->visible)
+			continue;
+
+		if (check_canvas && !obs_scene_from_source(item->source) &&
+		    item_off_canvas(item, cx, cy)) {
+			item->culled = true;
+			off_canvas++;
+			continue;
+		}
+
+		for (size_t i = 0; i < scene->occluders.num; i++) {
+			if (item_covered_by(item, scene->occluders.array[i])) {
+				item->culled = true;
+				occluded++;
+				break;
+			}
+		}
+
+		if (!item->culled && item_is_occluder(item))
+			da_push_back(scene->occluders, &item);
+	}
+
+	scene->occluded_items   = occluded;
+	scene->off_canvas_items = off_canvas;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	struct obs_scene_item *last = NULL;
 
 	pthread_mutex_lock(&scene->mutex);
 
 	item = scene->first_item;
 
-	gs_blend_state_push();
-	gs_reset_blend_state();
-
 	while (item) {
 		if (obs_source_removed(item->source)) {
 			struct obs_scene_item *del_item = item;
@@ -323,7 +466,21 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->visible) {
+		update_draw_corners(item);
+
+		last = item;
+		item = item->next;
+	}
+
+	cull_items(scene, last);
+
+	item = scene->first_item;
+
+	gs_blend_state_push();
+	gs_reset_blend_state();
+
+	while (item) {
+		if (item->visible && !item->culled) {
 			gs_matrix_push();
 			gs_matrix_mul(&item->draw_transform);
 			obs_source_video_render(item->source);
@@ -540,6 +697,15 @@ obs_scene_t *obs_scene_from_source(const obs_source_t *source)
 	return source->context.data;
 }
 
+void obs_scene_get_culled_items(const obs_scene_t *scene,
+		uint32_t *occluded, uint32_t *off_canvas)
+{
+	if (occluded)
+		*occluded = scene ? scene->occluded_items : 0;
+	if (off_canvas)
+		*off_canvas = scene ? scene->off_canvas_items : 0;
+}
+
 obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
 {
 	struct obs_scene_item *item;
@@ -45,6 +45,11 @@ struct obs_scene_item {
 	struct matrix4        box_transform;
 	struct matrix4        draw_transform;
 
+	/* scene space corners of the drawn area and whether the item was
+	 * skipped, both updated each time the scene renders */
+	struct vec3           draw_corners[4];
+	bool                  culled;
+
 	enum obs_bounds_type  bounds_type;
 	uint32_t              bounds_align;
 	struct vec2           bounds;
@@ -61,4 +66,11 @@ struct obs_scene {
 
 	pthread_mutex_t       mutex;
 	struct obs_scene_item *first_item;
+
+	/* opaque items found while culling, reused between renders */
+	DARRAY(struct obs_scene_item*) occluders;
+
+	/* number of items skipped during the last render */
+	uint32_t              occluded_items;
+	uint32_t              off_canvas_items;
 };
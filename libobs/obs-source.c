@@ -2945,6 +2945,18 @@ uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
 	return audio_line_get_mixers(source->audio_streams.array[0]->audio_line);
 }
 
+bool obs_source_get_audio_stats(const obs_source_t *source,
+		struct audio_line_stats *stats)
+{
+	if (!obs_source_valid(source, "obs_source_get_audio_stats"))
+		return false;
+	if ((source->info.output_flags & OBS_SOURCE_AUDIO) == 0)
+		return false;
+
+	return audio_line_get_stats(source->audio_streams.array[0]->audio_line,
+			stats);
+}
+
 void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix,
 		const struct vec3 *color_range_min,
 		const struct vec3 *color_range_max)
@@ -103,6 +103,19 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_INTERACTION (1<<5)
 
+/**
+ * Source is opaque.
+ *
+ * When this is used, the source promises that whenever its width and height
+ * are non-zero, its video_render callback covers that entire area with fully
+ * opaque pixels.  Scenes use this to skip rendering items that are completely
+ * hidden beneath it.  The flag is ignored while the source has filters.
+ *
+ * Sources that aren't always opaque, or that don't draw anything for a while
+ * (e.g. until the first frame is captured), can also implement is_opaque.
+ */
+#define OBS_SOURCE_OPAQUE      (1<<6)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -383,6 +396,16 @@ struct obs_source_info {
 	 * If defined, called to free private data on shutdown
 	 */
 	void (*free_type_data)(void *type_data);
+
+	/**
+	 * Called by scenes to check whether a source with OBS_SOURCE_OPAQUE
+	 * currently covers its entire area with fully opaque pixels.  If not
+	 * defined, the flag alone decides.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the source is currently opaque
+	 */
+	bool (*is_opaque)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
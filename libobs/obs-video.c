@@ -122,16 +122,21 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
+/* mapped_surfaces holds a reference of its own, so a surface lent to
+ * video-io and released on another thread can't be reused by find_texture
+ * before it has been unmapped here */
 static inline void unmap_last_surfaces(struct obs_core_video *video)
 {
 	for (size_t i = 0; i < video->mapped_surfaces.num;) {
-		if (video->mapped_surfaces.array[i]->refs != -1) {
+		obs_output_texture_t *tex = video->mapped_surfaces.array[i];
+		if (os_atomic_load_long(&tex->refs) != 0) {
 			i++;
 			continue;
 		}
 
-		gs_stagesurface_unmap(video->mapped_surfaces.array[i]->surf);
+		gs_stagesurface_unmap(tex->surf);
 		da_erase(video->mapped_surfaces, i);
+		obs_output_texture_release(tex);
 	}
 }
 
@@ -290,6 +295,14 @@ static void update_pipeline_ready_state(obs_texture_pipeline_t *pipeline)
 	da_resize(pipeline->active, 0);
 }
 
+/* copy surfaces stay queued in ready, oldest first, until download_frames
+ * maps them */
+static void queue_staged_surfaces(obs_texture_pipeline_t *pipeline)
+{
+	da_push_back_da(pipeline->ready, pipeline->active);
+	da_resize(pipeline->active, 0);
+}
+
 static void free_activated_texture(obs_texture_pipeline_t *pipeline, obs_active_texture_t *active)
 {
 	da_erase_item(pipeline->textures, &active->tex);
@@ -343,6 +356,7 @@ static inline void render_main_texture(struct obs_core_video *video, struct obs_
 
 	set_render_size(video->base_width, video->base_height);
 	obs_view_render(&obs->data.main_view);
+	vframe_info->render_ts = os_gettime_ns();
 
 	da_push_back_da(active->outputs, video->active_outputs);
 
@@ -497,6 +511,9 @@ static void render_output_texture(struct obs_core_video *video, obs_active_textu
 		tex->vframe_info = source->vframe_info;
 		tex->vframe_info->uses++;
 
+		obs_frame_trace_mark(tex->vframe_info->tracked_id,
+				OBS_FRAME_TRACE_STAGE);
+
 		for (size_t i = 0; i < source->outputs.num;) {
 			obs_video_output_t *out = source->outputs.array[i];
 			if (out->expired ||
@@ -754,11 +771,9 @@ static inline bool stage_output_texture(struct obs_core_video *video, obs_active
 static const char *stage_output_textures_name = "stage_output_textures";
 static void stage_output_textures(struct obs_core_video *video)
 {
-	for (size_t i = 0; i < video->copy_surfaces.num; i++) {
-		release_ready_textures(&video->copy_surfaces.array[i]);
-		unmap_last_surfaces(video);
-		update_pipeline_ready_state(&video->copy_surfaces.array[i]);
-	}
+	unmap_last_surfaces(video);
+	for (size_t i = 0; i < video->copy_surfaces.num; i++)
+		queue_staged_surfaces(&video->copy_surfaces.array[i]);
 
 	free_unused_pipelines(&video->copy_surfaces);
 
@@ -809,51 +824,144 @@ static inline void render_video(struct obs_core_video *video, struct obs_vframe_
 	gs_end_scene();
 }
 
-static inline void download_frames(struct obs_core_video *video)
+static const char *readback_map_name = "readback_map";
+static const char *readback_stall_name = "readback_stall";
+
+/* in automatic mode a stall grows the ring by a frame, and after
+ * OBS_READBACK_WINDOW frames without one it shrinks to the highest latency
+ * seen in that window */
+static void update_readback_depth(obs_texture_pipeline_t *pipeline,
+		uint32_t latency, bool stalled)
 {
-	for (size_t i = 0; i < video->copy_surfaces.num; i++) {
-		obs_texture_pipeline_t *pipeline = video->copy_surfaces.array + i;
-		for (size_t j = 0; j < pipeline->ready.num; j++) {
-			obs_active_texture_t *active = pipeline->ready.array + j;
+	if (stalled) {
+		if (pipeline->readback_depth < OBS_MAX_READBACK_DEPTH)
+			pipeline->readback_depth++;
+		pipeline->readback_window = 0;
+		pipeline->readback_max_latency = 0;
+		return;
+	}
+
+	if (latency > pipeline->readback_max_latency)
+		pipeline->readback_max_latency = latency;
+	if (++pipeline->readback_window < OBS_READBACK_WINDOW)
+		return;
 
-			struct video_frame frame = { 0 };
-			if (!gs_stagesurface_map(active->tex->surf, &frame.data[0], &frame.linesize[0]))
-				goto cleanup;
+	pipeline->readback_depth = pipeline->readback_max_latency;
+	pipeline->readback_window = 0;
+	pipeline->readback_max_latency = 0;
+}
 
-			bool actual_download = false;
+/* returns true if the oldest queued surface of the pipeline should be mapped
+ * now, stalled is set if its copy hasn't completed yet */
+static bool readback_ready(struct obs_core_video *video,
+		obs_texture_pipeline_t *pipeline, obs_active_texture_t *active,
+		bool *stalled)
+{
+	long depth = os_atomic_load_long(&video->readback_depth);
+	bool automatic = depth <= 0;
 
-			obs_video_output_t *output;
-			while (output = get_active_output(active, 0)) {
-				if (!output->info.texture_output) {
-					actual_download = true;
+	if (!automatic)
+		pipeline->readback_depth = depth < OBS_MAX_READBACK_DEPTH ?
+			(uint32_t)depth : OBS_MAX_READBACK_DEPTH;
+	else if (!pipeline->readback_depth)
+		pipeline->readback_depth = 1;
 
-					obs_ready_frame_t *ready = add_ready_frame(active, output);
-					ready->frame = frame;
-				}
+	*stalled = false;
+
+	if (gs_stagesurface_ready(active->tex->surf)) {
+		if (automatic)
+			update_readback_depth(pipeline, active->age, false);
+		return true;
+	}
+
+	if (active->age < pipeline->readback_depth)
+		return false;
+
+	*stalled = true;
+	if (automatic)
+		update_readback_depth(pipeline, active->age, true);
+	return true;
+}
+
+static void download_frame(struct obs_core_video *video,
+		obs_active_texture_t *active, bool stalled)
+{
+	const char *map_name = stalled ?
+		readback_stall_name : readback_map_name;
+	struct video_frame frame = { 0 };
+	obs_video_output_t *output;
+	bool mapped;
 
-				da_erase(active->outputs, 0);
+	profile_start(map_name);
+	mapped = gs_stagesurface_map(active->tex->surf, &frame.data[0],
+			&frame.linesize[0]);
+	profile_end(map_name);
+
+	if (mapped) {
+		bool actual_download = false;
+
+		obs_frame_trace_mark(active->vframe_info->tracked_id,
+				OBS_FRAME_TRACE_DOWNLOAD);
+
+		while (output = get_active_output(active, 0)) {
+			if (!output->info.texture_output) {
+				actual_download = true;
+
+				obs_ready_frame_t *ready = add_ready_frame(active, output);
+				ready->frame = frame;
 			}
 
-			if (actual_download)
-				da_push_back(video->mapped_surfaces, &active->tex);
-			else
-				gs_stagesurface_unmap(active->tex->surf);
-
-		cleanup:
-			active->vframe_info->uses--;
-			while (output = get_active_output(active, 0)) {
-				for (size_t j = 0; j < active->vframe_info->data.num;) {
-					obs_ready_frame_t *ready = active->vframe_info->data.array + j;
-					if (ready->output != output) {
-						j++;
-						continue;
-					}
-
-					obs_output_texture_release(ready->tex);
-					da_erase(active->vframe_info->data, j);
-				}
+			da_erase(active->outputs, 0);
+		}
+
+		if (actual_download) {
+			obs_output_texture_addref(active->tex);
+			da_push_back(video->mapped_surfaces, &active->tex);
+		} else
+			gs_stagesurface_unmap(active->tex->surf);
+	}
+
+	active->vframe_info->uses--;
+	while (output = get_active_output(active, 0)) {
+		for (size_t j = 0; j < active->vframe_info->data.num;) {
+			obs_ready_frame_t *ready = active->vframe_info->data.array + j;
+			if (ready->output != output) {
+				j++;
+				continue;
 			}
- 		}
+
+			obs_output_texture_release(ready->tex);
+			da_erase(active->vframe_info->data, j);
+		}
+
+		da_erase(active->outputs, 0);
+	}
+}
+
+static inline void download_frames(struct obs_core_video *video)
+{
+	for (size_t i = 0; i < video->copy_surfaces.num; i++) {
+		obs_texture_pipeline_t *pipeline = video->copy_surfaces.array + i;
+		bool stalled;
+
+		/* every queued surface is a frame older, not just the one
+		 * that's next to be mapped */
+		for (size_t j = 0; j < pipeline->ready.num; j++)
+			pipeline->ready.array[j].age++;
+
+		while (pipeline->ready.num) {
+			obs_active_texture_t *active = pipeline->ready.array;
+			if (!readback_ready(video, pipeline, active, &stalled))
+				break;
+
+			download_frame(video, active, stalled);
+
+			obs_output_texture_release(active->tex);
+			if (active->outputs.capacity)
+				da_push_back(pipeline->idle_output_lists,
+						&active->outputs);
+			da_erase(pipeline->ready, 0);
+		}
 	}
 }
 
@@ -894,87 +1002,259 @@ static inline uint32_t make_aligned_linesize_offset(uint32_t offset,
 	return (offset / dst_linesize) * src_linesize + remainder;
 }
 
-static void fix_gpu_converted_alignment(struct video_frame *output_frame, const obs_video_output_t *output, struct video_frame *frame)
+static inline uint32_t gpu_converted_plane_size(
+		const obs_video_output_t *output, size_t plane)
 {
-	uint32_t src_linesize = frame->linesize[0];
-	uint32_t dst_linesize = output_frame->linesize[0] * 4;
-	uint32_t src_pos      = 0;
+	uint32_t size = output->plane_linewidth[plane] * output->info.height;
 
-	for (size_t i = 0; i < 3; i++) {
-		if (output->plane_linewidth[i] == 0)
-			break;
+	if (plane && (output->info.format == VIDEO_FORMAT_I420 ||
+	              output->info.format == VIDEO_FORMAT_NV12))
+		size /= 2;
+	return size;
+}
 
-		src_pos = make_aligned_linesize_offset(output->plane_offsets[i],
-				dst_linesize, src_linesize);
+static void convert_band(struct obs_convert_band *band)
+{
+	const obs_video_output_t *output = band->output;
+	const struct video_frame *frame = band->frame;
+	struct video_frame *output_frame = &band->output_frame;
+	uint32_t src_linesize;
+	uint32_t dst_linesize;
+
+	switch (band->type) {
+	case OBS_CONVERT_BAND_CONVERT:
+		if (output->info.format == VIDEO_FORMAT_I420)
+			compress_uyvx_to_i420(
+					frame->data[0], frame->linesize[0],
+					band->start, band->end,
+					output_frame->data, output_frame->linesize);
+		else if (output->info.format == VIDEO_FORMAT_NV12)
+			compress_uyvx_to_nv12(
+					frame->data[0], frame->linesize[0],
+					band->start, band->end,
+					output_frame->data, output_frame->linesize);
+		else
+			convert_uyvx_to_i444(
+					frame->data[0], frame->linesize[0],
+					band->start, band->end,
+					output_frame->data, output_frame->linesize);
+		break;
+
+	case OBS_CONVERT_BAND_COPY_RGBX:
+		src_linesize = frame->linesize[0];
+		dst_linesize = output_frame->linesize[0];
+
+		/* if the line sizes match, do a single copy */
+		if (src_linesize == dst_linesize) {
+			memcpy(output_frame->data[0] + band->start * dst_linesize,
+					frame->data[0] + band->start * src_linesize,
+					(band->end - band->start) * src_linesize);
+		} else {
+			for (uint32_t y = band->start; y < band->end; y++)
+				memcpy(output_frame->data[0] + y * dst_linesize,
+						frame->data[0] + y * src_linesize,
+						output->info.width * 4);
+		}
+		break;
+
+	case OBS_CONVERT_BAND_COPY_PLANE:
+		memcpy(output_frame->data[band->plane] + band->start,
+				frame->data[0] + output->plane_offsets[band->plane] +
+				band->start,
+				band->end - band->start);
+		break;
+
+	case OBS_CONVERT_BAND_COPY_DEALIGN:
+		src_linesize = frame->linesize[0];
+		dst_linesize = output_frame->linesize[0] * 4;
 
-		copy_dealign(output_frame->data[i], 0, dst_linesize,
-				frame->data[0], src_pos, src_linesize,
-				output->plane_sizes[i]);
+		copy_dealign(output_frame->data[band->plane], band->start,
+				dst_linesize, frame->data[0],
+				make_aligned_linesize_offset(
+					output->plane_offsets[band->plane] +
+					band->start, dst_linesize, src_linesize),
+				src_linesize, band->end - band->start);
+		break;
 	}
 }
 
-static void set_gpu_converted_data(struct video_frame *output_frame, const obs_video_output_t *output, struct video_frame *frame)
+/* splits [0, total) into one band per conversion thread, keeping band
+ * boundaries on multiples of align */
+static void add_convert_bands(struct obs_convert_pool *pool,
+		struct obs_convert_band *band, uint32_t total, uint32_t align)
 {
-	if (frame->linesize[0] == output->info.width*4) {
-		struct video_frame input;
+	uint32_t count = (uint32_t)pool->threads.num + 1;
+	uint32_t size = (total / count + align - 1) / align * align;
 
-		for (size_t i = 0; i < 3; i++) {
+	if (!size)
+		size = align;
+
+	for (uint32_t start = 0; start < total; start += size) {
+		band->start = start;
+		band->end = total - start > size ? start + size : total;
+		da_push_back(pool->bands, band);
+	}
+}
+
+static void add_conversion_bands(struct obs_convert_pool *pool,
+		struct video_frame *output_frame,
+		const obs_video_output_t *output,
+		const struct video_frame *frame)
+{
+	struct obs_convert_band band = {0};
+	band.output = output;
+	band.frame = frame;
+	band.output_frame = *output_frame;
+
+	if (output->info.gpu_conversion) {
+		bool aligned = frame->linesize[0] == output->info.width*4;
+
+		for (uint32_t i = 0; i < 3; i++) {
 			if (output->plane_linewidth[i] == 0)
 				break;
 
-			input.linesize[i] = output->plane_linewidth[i];
-			input.data[i] = frame->data[0] + output->plane_offsets[i];
+			band.plane = i;
+			if (aligned) {
+				band.type = OBS_CONVERT_BAND_COPY_PLANE;
+				add_convert_bands(pool, &band,
+						gpu_converted_plane_size(output, i),
+						output->plane_linewidth[i]);
+			} else {
+				band.type = OBS_CONVERT_BAND_COPY_DEALIGN;
+				add_convert_bands(pool, &band,
+						output->plane_sizes[i],
+						output_frame->linesize[0] * 4);
+			}
 		}
 
-		video_frame_copy(output_frame, &input, output->info.format, output->info.height);
+	} else if (format_is_yuv(output->info.format)) {
+		if (output->info.format != VIDEO_FORMAT_I420 &&
+		    output->info.format != VIDEO_FORMAT_NV12 &&
+		    output->info.format != VIDEO_FORMAT_I444) {
+			blog(LOG_ERROR, "convert_frame: unsupported texture format");
+			return;
+		}
+
+		/* the conversion kernels work on pairs of lines */
+		band.type = OBS_CONVERT_BAND_CONVERT;
+		add_convert_bands(pool, &band, output->info.height, 2);
 
 	} else {
-		fix_gpu_converted_alignment(output_frame, output, frame);
+		band.type = OBS_CONVERT_BAND_COPY_RGBX;
+		add_convert_bands(pool, &band, output->info.height, 1);
 	}
 }
 
-static void convert_frame(
-		struct video_frame *output_frame, const obs_video_output_t *output, const struct video_frame *frame)
+static void run_convert_bands(struct obs_convert_pool *pool)
+{
+	long num = (long)pool->bands.num;
+	long i;
+
+	while ((i = os_atomic_inc_long(&pool->next_band) - 1) < num)
+		convert_band(pool->bands.array + i);
+}
+
+static void *convert_thread(void *param)
 {
-	if (output->info.format == VIDEO_FORMAT_I420) {
-		compress_uyvx_to_i420(
-				frame->data[0], frame->linesize[0],
-				0, output->info.height,
-				output_frame->data, output_frame->linesize);
+	struct obs_convert_pool *pool = param;
 
-	} else if (output->info.format == VIDEO_FORMAT_NV12) {
-		compress_uyvx_to_nv12(
-				frame->data[0], frame->linesize[0],
-				0, output->info.height,
-				output_frame->data, output_frame->linesize);
+	os_set_thread_name("libobs: conversion thread");
 
-	} else if (output->info.format == VIDEO_FORMAT_I444) {
-		convert_uyvx_to_i444(
-				frame->data[0], frame->linesize[0],
-				0, output->info.height,
-				output_frame->data, output_frame->linesize);
+	while (os_sem_wait(pool->work_sem) == 0) {
+		if (os_atomic_load_bool(&pool->stop))
+			break;
 
-	} else {
-		blog(LOG_ERROR, "convert_frame: unsupported texture format");
+		run_convert_bands(pool);
+		os_sem_post(pool->done_sem);
 	}
+
+	return NULL;
 }
 
-static inline void copy_rgbx_frame(struct video_frame *output_frame,
-	obs_video_output_t *output, const struct video_frame *input)
+/* the graphics thread converts bands alongside the workers and returns once
+ * every band has been written */
+static void convert_frames(struct obs_convert_pool *pool)
 {
-	uint8_t *in_ptr = input->data[0];
-	uint8_t *out_ptr = output_frame->data[0];
+	size_t workers = pool->bands.num > 1 ? pool->threads.num : 0;
 
-	/* if the line sizes match, do a single copy */
-	if (input->linesize[0] == output_frame->linesize[0]) {
-		memcpy(out_ptr, in_ptr, input->linesize[0] * output->info.height);
-	} else {
-		for (size_t y = 0; y < output->info.height; y++) {
-			memcpy(out_ptr, in_ptr, output->info.width * 4);
-			in_ptr += input->linesize[0];
-			out_ptr += output_frame->linesize[0];
+	os_atomic_set_long(&pool->next_band, 0);
+
+	for (size_t i = 0; i < workers; i++)
+		os_sem_post(pool->work_sem);
+
+	run_convert_bands(pool);
+
+	for (size_t i = 0; i < workers; i++)
+		os_sem_wait(pool->done_sem);
+}
+
+static void free_convert_threads(struct obs_convert_pool *pool)
+{
+	if (pool->threads.num) {
+		os_atomic_set_bool(&pool->stop, true);
+
+		for (size_t i = 0; i < pool->threads.num; i++)
+			os_sem_post(pool->work_sem);
+		for (size_t i = 0; i < pool->threads.num; i++)
+			pthread_join(pool->threads.array[i], NULL);
+	}
+
+	os_sem_destroy(pool->work_sem);
+	os_sem_destroy(pool->done_sem);
+	pool->work_sem = NULL;
+	pool->done_sem = NULL;
+
+	da_free(pool->threads);
+	os_atomic_set_bool(&pool->stop, false);
+}
+
+/* forgets the requested thread count too, so the pool is recreated after
+ * the video is reset with the same count */
+static void free_convert_pool(struct obs_convert_pool *pool)
+{
+	free_convert_threads(pool);
+	pool->requested_threads = 0;
+}
+
+static void update_convert_pool(struct obs_core_video *video)
+{
+	struct obs_convert_pool *pool = &video->convert_pool;
+	long threads = os_atomic_load_long(&video->conversion_threads);
+	size_t workers;
+
+	if (threads == pool->requested_threads)
+		return;
+	pool->requested_threads = threads;
+
+	if (threads > OBS_MAX_CONVERSION_THREADS)
+		threads = OBS_MAX_CONVERSION_THREADS;
+	workers = threads > 1 ? (size_t)(threads - 1) : 0;
+
+	if (workers == pool->threads.num)
+		return;
+
+	free_convert_threads(pool);
+	if (!workers)
+		return;
+
+	if (os_sem_init(&pool->work_sem, 0) != 0 ||
+	    os_sem_init(&pool->done_sem, 0) != 0) {
+		blog(LOG_ERROR, "Failed to create conversion thread semaphores");
+		free_convert_threads(pool);
+		return;
+	}
+
+	for (size_t i = 0; i < workers; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, convert_thread, pool) != 0) {
+			blog(LOG_ERROR, "Failed to create conversion thread");
+			break;
 		}
+		da_push_back(pool->threads, &thread);
 	}
+
+	blog(LOG_INFO, "Converting output frames on %d thread(s)",
+			(int)pool->threads.num + 1);
 }
 
 static void output_video_texture(video_t *video, video_locked_frame locked, obs_video_output_t *output, obs_output_texture_t *output_tex, uint32_t shared_handle)
@@ -990,41 +1270,78 @@ static void output_video_texture(video_t *video, video_locked_frame locked, obs_
 		blog(LOG_ERROR, "Failed to set texture for output");
 }
 
-static inline void output_video_data(video_t *video,
+/* gets the planes of a mapped surface if they already have the layout of the
+ * output's frame buffer, so the surface can be lent instead of copied */
+static bool get_lent_frame(const obs_video_output_t *output,
+		const struct video_frame *mapped, struct video_frame *frame)
+{
+	memset(frame, 0, sizeof(*frame));
+
+	if (output->info.gpu_conversion) {
+		if (mapped->linesize[0] != output->info.width*4)
+			return false;
+
+		for (size_t i = 0; i < 3; i++) {
+			if (output->plane_linewidth[i] == 0)
+				break;
+
+			frame->data[i] = mapped->data[0] +
+				output->plane_offsets[i];
+			frame->linesize[i] = output->plane_linewidth[i];
+		}
+		return true;
+	}
+
+	if (format_is_yuv(output->info.format))
+		return false;
+
+	frame->data[0] = mapped->data[0];
+	frame->linesize[0] = mapped->linesize[0];
+	return true;
+}
+
+static inline void output_video_data(struct obs_core_video *video,
 		struct obs_vframe_info *info)
 {
+	struct obs_convert_pool *pool = &video->convert_pool;
 	video_locked_frame locked;
 
-	locked = video_output_lock_frame(video, info->data.num, info->count,
-			info->timestamp, info->tracked_id);
+	locked = video_output_lock_frame(video->video, info->data.num,
+			info->count, info->timestamp, info->tracked_id);
 	if (locked) {
 		struct video_frame output_frame;
+
+		da_resize(pool->bands, 0);
+
 		for (size_t i = 0; i < info->data.num; i++) {
 			obs_video_output_t *output = info->data.array[i].output;
 			if (output->info.texture_output) {
-				output_video_texture(video, locked, output, info->data.array[i].tex, info->data.array[i].shared_handle);
+				output_video_texture(video->video, locked, output, info->data.array[i].tex, info->data.array[i].shared_handle);
+
+			} else if (get_lent_frame(output, &info->data.array[i].frame, &output_frame)) {
+				if (!video_output_lend_frame(video->video, info->data.array[i].tex, &output_frame, &output->info, locked, output->expiring || output->expired))
+					blog(LOG_ERROR, "Failed to lend frame to output");
 
 			} else {
-				if (!video_output_get_frame_buffer(video, &output_frame, &output->info, locked, output->expiring || output->expired)) {
+				if (!video_output_get_frame_buffer(video->video, &output_frame, &output->info, locked, output->expiring || output->expired)) {
 					blog(LOG_ERROR, "Failed to get frame buffer for output");
 					continue;
 				}
 
-				struct video_frame *frame = &info->data.array[i].frame;
-				if (output->info.gpu_conversion) {
-					set_gpu_converted_data(&output_frame, output, frame);
-				} else if (format_is_yuv(output->info.format)) {
-					convert_frame(&output_frame, output, frame);
-				} else {
-					copy_rgbx_frame(&output_frame, output, frame);
-				}
+				add_conversion_bands(pool, &output_frame, output,
+						&info->data.array[i].frame);
 			}
+		}
+
+		if (pool->bands.num)
+			convert_frames(pool);
 
+		for (size_t i = 0; i < info->data.num; i++)
 			if (info->data.array[i].tex)
 				obs_output_texture_release(info->data.array[i].tex);
-		}
 
-		video_output_unlock_frame(video, locked);
+		obs_frame_trace_mark(info->tracked_id, OBS_FRAME_TRACE_CONVERT);
+		video_output_unlock_frame(video->video, locked);
 
 	} else {
 		for (size_t i = 0; i < info->data.num; i++)
@@ -1051,6 +1368,8 @@ static struct obs_vframe_info *get_vframe_info()
 	return bzalloc(sizeof(*info));
 }
 
+static const char *video_wake_error_name = "video_wake_error";
+
 static bool sleepto_imprecise(uint64_t target)
 {
 	uint64_t actual_time = os_gettime_ns();
@@ -1078,9 +1397,20 @@ static inline void video_sleep(struct obs_core_video *video,
 		*vframe_info = get_vframe_info();
 
 	bool precise_sleep = video->active_outputs.num > 0;
-	bool did_sleep = precise_sleep ? os_sleepto_ns(t) : sleepto_imprecise(t);
+	bool did_sleep;
+
+	if (!precise_sleep)
+		did_sleep = sleepto_imprecise(t);
+	else if (video->pacing == OBS_VIDEO_PACING_HYBRID)
+		did_sleep = os_sleepto_ns_hybrid(t, video->pacing_spin_ns);
+	else
+		did_sleep = os_sleepto_ns(t);
 
 	if (did_sleep) {
+		if (precise_sleep)
+			profile_record(video_wake_error_name,
+					os_gettime_ns() - t);
+
 		*p_time = t;
 		count = 1;
 	} else {
@@ -1097,11 +1427,16 @@ static inline void video_sleep(struct obs_core_video *video,
 	pthread_mutex_lock(&video->frame_tracker_mutex);
 	info->tracked_id = video->tracked_frame_id;
 	video->tracked_frame_id = 0;
+	if (!info->tracked_id)
+		info->tracked_id = obs_frame_trace_sample(video);
 	pthread_mutex_unlock(&video->frame_tracker_mutex);
 
 	info->timestamp = cur_time;
 	info->count = count;
 
+	obs_frame_trace_begin(video, info->tracked_id, cur_time,
+			info->render_ts);
+
 	da_push_back(video->active_vframe_info, &info);
 	if (video->active_vframe_info.num > 10)
 		blog(LOG_ERROR, "video_sleep: Queued more than 10 frames, something's not quite right");
@@ -1132,21 +1467,23 @@ static inline void output_frame()
 {
 	struct obs_core_video *video = &obs->video;
 
-	if (!video->active_vframe_info.num)
-		return;
+	update_convert_pool(video);
 
-	struct obs_vframe_info *info = video->active_vframe_info.array[0];
-	if (info->uses)
-		return;
+	/* several frames can complete at once when the readback ring shrinks */
+	while (video->active_vframe_info.num) {
+		struct obs_vframe_info *info = video->active_vframe_info.array[0];
+		if (info->uses)
+			return;
 
-	if (info->data.num) {
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video->video, info);
-		profile_end(output_frame_output_video_data_name);
-	}
+		if (info->data.num) {
+			profile_start(output_frame_output_video_data_name);
+			output_video_data(video, info);
+			profile_end(output_frame_output_video_data_name);
+		}
 
-	da_push_back(video->vframe_info, video->active_vframe_info.array);
-	da_erase(video->active_vframe_info, 0);
+		da_push_back(video->vframe_info, video->active_vframe_info.array);
+		da_erase(video->active_vframe_info, 0);
+	}
 }
 
 
@@ -1494,6 +1831,10 @@ void *obs_video_thread(void *param)
 
 	os_set_thread_name("libobs: graphics thread");
 
+	if (obs->video.pacing_realtime && !os_set_thread_realtime())
+		blog(LOG_WARNING, "Failed to raise the graphics thread to "
+				"real-time priority");
+
 	bool outputs_were_active = obs->video.outputs.num > 0;
 
 	const char *video_thread_name = update_profiler_entry(outputs_were_active, interval);
@@ -1553,6 +1894,9 @@ void *obs_video_thread(void *param)
 		video_sleep(&obs->video, &obs->video.video_time, interval, &vframe_info);
 	}
 
+	free_convert_pool(&obs->video.convert_pool);
+	da_free(obs->video.convert_pool.bands);
+
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
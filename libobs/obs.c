@@ -33,7 +33,7 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->name    = "video";
 	vi->fps_num = ovi->fps_num;
 	vi->fps_den = ovi->fps_den;
-	vi->cache_size = 6;
+	vi->cache_size = ovi->video_cache_size;
 }
 
 static int obs_init_graphics(struct obs_video_info *ovi)
@@ -179,7 +179,7 @@ static void free_pipeline(obs_texture_pipeline_t *pipeline)
 	for (size_t i = 0; i < pipeline->active.num; i++)
 		da_free(pipeline->active.array[i].outputs);
 	for (size_t i = 0; i < pipeline->ready.num; i++)
-		da_free(pipeline->active.array[i].outputs);
+		da_free(pipeline->ready.array[i].outputs);
 	for (size_t i = 0; i < pipeline->idle_output_lists.num; i++)
 		da_free(pipeline->idle_output_lists.array[i]);
 
@@ -446,6 +446,8 @@ static const char *obs_signals[] = {
 	"void hotkey_unregister(ptr hotkey)",
 	"void hotkey_bindings_changed(ptr hotkey)",
 
+	"void frame_traced(int id, int stage)",
+
 	NULL
 };
 
@@ -565,6 +567,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 
 	if (pthread_mutex_init(&obs->video.frame_tracker_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&obs->video.frame_tracer.mutex, NULL) != 0)
+		return false;
 	if (pthread_mutex_init(&obs->video.deferred_cleanup.mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&obs->video.video_thread_time_mutex, NULL) != 0)
@@ -646,6 +650,7 @@ void obs_shutdown(void)
 	pthread_mutex_destroy(&obs->video.resize_mutex);
 	pthread_mutex_destroy(&obs->video.video_thread_time_mutex);
 	pthread_mutex_destroy(&obs->video.frame_tracker_mutex);
+	pthread_mutex_destroy(&obs->video.frame_tracer.mutex);
 
 	obs_free_data();
 	obs_free_video();
@@ -765,12 +770,34 @@ int obs_reset_video(struct obs_video_info *ovi)
 	video->base_height = ovi->base_height;
 	pthread_mutex_unlock(&video->resize_mutex);
 
+	os_atomic_set_long(&video->conversion_threads,
+			(long)ovi->conversion_threads);
+	os_atomic_set_long(&video->readback_depth,
+			(long)ovi->readback_depth);
+
+	video->pacing = ovi->pacing;
+	video->pacing_spin_ns = (ovi->pacing_spin_us ?
+			ovi->pacing_spin_us : OBS_DEFAULT_PACING_SPIN_US) * 1000ULL;
+	video->pacing_realtime = ovi->pacing_realtime;
+
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO, "video settings reset:\n"
 	               "\tbase resolution:   %dx%d\n"
-	               "\tfps:               %d/%d\n",
+	               "\tfps:               %d/%d\n"
+	               "\tconversion:        %u thread(s)\n"
+	               "\treadback depth:    %u%s\n"
+	               "\tframe cache:       %u%s\n"
+	               "\tframe pacing:      %s%s\n",
 	               ovi->base_width, ovi->base_height,
-	               ovi->fps_num, ovi->fps_den);
+	               ovi->fps_num, ovi->fps_den,
+	               ovi->conversion_threads,
+	               ovi->readback_depth,
+	               ovi->readback_depth ? "" : " (automatic)",
+	               ovi->video_cache_size,
+	               ovi->video_cache_size ? "" : " (default)",
+	               ovi->pacing == OBS_VIDEO_PACING_HYBRID ?
+	                       "hybrid" : "default",
+	               ovi->pacing_realtime ? ", real-time priority" : "");
 
 	return obs_init_video(ovi);
 }
@@ -794,15 +821,22 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.max_buffer_ms = oai->max_buffer_ms;
+	ai.tick_ms = oai->tick_ms;
+	ai.mix_threads = oai->mix_threads;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec:     %d\n"
 	               "\tspeakers:            %d\n"
-	               "\tmax buffering (ms):  %d",
+	               "\tmax buffering (ms):  %d\n"
+	               "\tmix interval (ms):   %d%s\n"
+	               "\tmix threads:         %d",
 	               (int)ai.samples_per_sec,
 	               (int)ai.speakers,
-	               (int)ai.max_buffer_ms);
+	               (int)ai.max_buffer_ms,
+	               ai.tick_ms ? (int)ai.tick_ms : 25,
+	               ai.tick_ms ? " (tick mode)" : " (polling)",
+	               ai.mix_threads > 1 ? (int)ai.mix_threads : 1);
 
 	return obs_init_audio(&ai);
 }
@@ -824,6 +858,14 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	ovi->base_height   = video->base_height;
 	ovi->fps_num       = info->fps_num;
 	ovi->fps_den       = info->fps_den;
+	ovi->conversion_threads = (uint32_t)os_atomic_load_long(
+			&video->conversion_threads);
+	ovi->readback_depth = (uint32_t)os_atomic_load_long(
+			&video->readback_depth);
+	ovi->video_cache_size = (uint32_t)info->cache_size;
+	ovi->pacing = video->pacing;
+	ovi->pacing_spin_us = (uint32_t)(video->pacing_spin_ns / 1000);
+	ovi->pacing_realtime = video->pacing_realtime;
 
 	return true;
 }
@@ -841,6 +883,8 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	oai->samples_per_sec = info->samples_per_sec;
 	oai->speakers = info->speakers;
 	oai->max_buffer_ms = info->max_buffer_ms;
+	oai->tick_ms = info->tick_ms;
+	oai->mix_threads = info->mix_threads;
 	return true;
 }
 
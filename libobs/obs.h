@@ -145,6 +145,14 @@ struct obs_transform_info {
 	struct vec2          bounds;
 };
 
+/**
+ * Frame pacing of the graphics thread while outputs are active
+ */
+enum obs_video_pacing {
+	OBS_VIDEO_PACING_DEFAULT, /**< relative sleep to the next frame */
+	OBS_VIDEO_PACING_HYBRID,  /**< absolute-deadline sleep, then spin */
+};
+
 /**
  * Video initialization structure
  */
@@ -162,6 +170,36 @@ struct obs_video_info {
 
 	/** Video adapter index to use (NOTE: avoid for optimus laptops) */
 	uint32_t            adapter;
+
+	/**
+	 * Threads used for CPU format conversion of output frames, including
+	 * the graphics thread (0 or 1 converts on the graphics thread only)
+	 */
+	uint32_t            conversion_threads;
+
+	/**
+	 * Frames a staged output frame may wait for its GPU copy before it is
+	 * mapped anyway (0 sizes the readback ring from the measured latency)
+	 */
+	uint32_t            readback_depth;
+
+	/**
+	 * Rendered frames that can be queued for encoders before the newest
+	 * one is repeated instead (0 for the default of 6, minimum 2)
+	 */
+	uint32_t            video_cache_size;
+
+	/** Frame pacing mode used while outputs are active */
+	enum obs_video_pacing pacing;
+
+	/**
+	 * Time hybrid pacing busy-waits before each frame deadline, in
+	 * microseconds (0 for the default of 500)
+	 */
+	uint32_t            pacing_spin_us;
+
+	/** Run the graphics thread at real-time priority (SCHED_FIFO) */
+	bool                pacing_realtime;
 };
 
 /**
@@ -171,6 +209,18 @@ struct obs_audio_info {
 	uint32_t            samples_per_sec;
 	enum speaker_layout speakers;
 	uint64_t            max_buffer_ms;
+
+	/**
+	 * Mix audio on absolute deadlines every tick_ms milliseconds (for
+	 * example 5 or 10) rather than polling every 25 ms (0)
+	 */
+	uint32_t            tick_ms;
+
+	/**
+	 * Threads mixing audio lines and outputting the mixes, including the
+	 * audio thread (0 or 1 to mix on the audio thread only, at most 16)
+	 */
+	uint32_t            mix_threads;
 };
 
 /**
@@ -238,6 +288,30 @@ struct obs_graphics_defer_cleanup {
 	enum obs_graphics_defer_cleanup_type type;
 };
 
+/** Pipeline stages recorded by the frame lifecycle tracer, in order */
+enum obs_frame_trace_stage {
+	OBS_FRAME_TRACE_RENDER,         /**< main texture rendered */
+	OBS_FRAME_TRACE_STAGE,          /**< output texture staged for download */
+	OBS_FRAME_TRACE_DOWNLOAD,       /**< staging surface mapped */
+	OBS_FRAME_TRACE_CONVERT,        /**< frame converted into video-io */
+	OBS_FRAME_TRACE_DISPATCH,       /**< frame received from video-io */
+	OBS_FRAME_TRACE_ENCODE_SUBMIT,  /**< frame submitted to the encoder */
+	OBS_FRAME_TRACE_ENCODE_RETURN,  /**< encoder returned the packet */
+	OBS_FRAME_TRACE_INTERLEAVE,     /**< packet left the interleave queue */
+	OBS_FRAME_TRACE_SEND,           /**< packet written to the socket */
+	OBS_FRAME_TRACE_STAGE_COUNT
+};
+
+/**
+ * Per-frame latency breakdown.  Stage times are os_gettime_ns() values of
+ * the first time the frame reached the stage, or 0 if it has not (yet).
+ */
+struct obs_frame_trace {
+	video_tracked_frame_id id;
+	uint64_t               timestamp;
+	uint64_t               stage_ts[OBS_FRAME_TRACE_STAGE_COUNT];
+};
+
 /* ------------------------------------------------------------------------- */
 /* OBS context */
 
@@ -312,6 +386,33 @@ EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
 EXPORT video_tracked_frame_id obs_track_next_frame(void);
 
+/**
+ * Sets how often frames are picked for lifecycle tracing.  Every Nth frame
+ * is given a tracked frame ID with VIDEO_FRAME_TRACE_SAMPLE_ID set, which
+ * doesn't emit "sent_tracked_frame"; 0 disables sampling.  Frames tracked with
+ * obs_track_next_frame are always traced.
+ */
+EXPORT void obs_frame_trace_set_sample_interval(uint32_t frames);
+EXPORT uint32_t obs_frame_trace_get_sample_interval(void);
+
+/**
+ * Records the time a tracked frame reached a pipeline stage.  Only the first
+ * mark of each stage is kept (frames can be output or encoded more than once).
+ * Marking OBS_FRAME_TRACE_INTERLEAVE or OBS_FRAME_TRACE_SEND emits the global
+ * "frame_traced" signal.
+ */
+EXPORT void obs_frame_trace_mark(video_tracked_frame_id id,
+		enum obs_frame_trace_stage stage);
+
+/**
+ * Gets the latency breakdown of a recently traced frame, returns false if
+ * the frame was not traced or has dropped out of the trace history
+ */
+EXPORT bool obs_frame_trace_get(video_tracked_frame_id id,
+		struct obs_frame_trace *trace);
+
+EXPORT const char *obs_frame_trace_stage_name(enum obs_frame_trace_stage stage);
+
 EXPORT bool obs_get_video_thread_time(uint64_t *val);
 
 
@@ -844,6 +945,10 @@ EXPORT void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers);
 /** Gets audio mixer flags */
 EXPORT uint32_t obs_source_get_audio_mixers(const obs_source_t *source);
 
+/** Gets buffering and drop statistics of the source's main audio line */
+EXPORT bool obs_source_get_audio_stats(const obs_source_t *source,
+		struct audio_line_stats *stats);
+
 /**
  * Increments the 'showing' reference counter to indicate that the source is
  * being shown somewhere.  If the reference counter was 0, will call the 'show'
@@ -1060,6 +1165,14 @@ EXPORT bool obs_scene_reorder_items(obs_scene_t *scene,
 /** Adds/creates a new scene item for a source */
 EXPORT obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source);
 
+/**
+ * Gets how many visible items the scene skipped during its last render,
+ * either because opaque items above them covered them completely or because
+ * they were entirely outside of the canvas.
+ */
+EXPORT void obs_scene_get_culled_items(const obs_scene_t *scene,
+		uint32_t *occluded, uint32_t *off_canvas);
+
 typedef void (*obs_scene_atomic_update_func)(void *, obs_scene_t *scene);
 EXPORT void obs_scene_atomic_update(obs_scene_t *scene,
 		obs_scene_atomic_update_func func, void *data);
@@ -1281,6 +1394,17 @@ EXPORT obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output);
 EXPORT obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
 		size_t idx);
 
+/**
+ * Returns the timestamp offset that is subtracted from the packets of an
+ * encoder before they are passed to this output, in the encoder's timebase.
+ *
+ * Outputs sharing encoders get packets with different timestamps if they
+ * were started at different times; adding the offset gives the timestamp
+ * of the packet as produced by the encoder.
+ */
+EXPORT int64_t obs_output_get_packet_offset(const obs_output_t *output,
+		enum obs_encoder_type type, size_t track_idx);
+
 /** Sets the current service associated with this output. */
 EXPORT void obs_output_set_service(obs_output_t *output,
 		obs_service_t *service);
@@ -1501,6 +1625,26 @@ EXPORT void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 
 EXPORT void obs_free_encoder_packet(struct encoder_packet *packet);
 
+/**
+ * Creates a reference counted copy of an encoder packet.  The packet data
+ * is shared between all references and is freed once the last reference
+ * has been released with obs_encoder_packet_release.
+ */
+EXPORT void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/**
+ * Adds a reference to a reference counted encoder packet.  Only packets
+ * created with obs_encoder_packet_create_instance can be referenced, which
+ * includes all packets passed to the encoded_packet callback of outputs that
+ * use both audio and video encoders or an output delay.
+ */
+EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/** Releases a reference to a reference counted encoder packet */
+EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
+
 
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
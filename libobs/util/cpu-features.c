@@ -0,0 +1,96 @@
+#include "cpu-features.h"
+#include "threading.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || \
+    defined(__i386__) || defined(__x86_64__)
+#define CPU_FEATURES_X86
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+enum cpu_feature {
+	CPU_FEATURE_AVX  = 1 << 0,
+	CPU_FEATURE_AVX2 = 1 << 1
+};
+
+#ifdef CPU_FEATURES_X86
+static inline void get_cpuid(uint32_t leaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex((int*)regs, (int)leaf, 0);
+#else
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static long detect_features(void)
+{
+	uint32_t regs[4];
+	uint32_t max_leaf;
+	long features = 0;
+
+	get_cpuid(0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return 0;
+
+	/* AVX and OSXSAVE, with the OS saving the YMM registers */
+	get_cpuid(1, regs);
+	if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+		return 0;
+	if ((get_xcr0() & 6) != 6)
+		return 0;
+
+	features |= CPU_FEATURE_AVX;
+
+	if (max_leaf >= 7) {
+		get_cpuid(7, regs);
+		if ((regs[1] & (1 << 5)) != 0)
+			features |= CPU_FEATURE_AVX2;
+	}
+
+	return features;
+}
+#else
+static long detect_features(void)
+{
+	return 0;
+}
+#endif
+
+static volatile long cpu_features = -1;
+
+static inline bool has_feature(long feature)
+{
+	long features = os_atomic_load_long(&cpu_features);
+	if (features < 0) {
+		features = detect_features();
+		os_atomic_set_long(&cpu_features, features);
+	}
+	return (features & feature) != 0;
+}
+
+bool os_cpu_has_avx(void)
+{
+	return has_feature(CPU_FEATURE_AVX);
+}
+
+bool os_cpu_has_avx2(void)
+{
+	return has_feature(CPU_FEATURE_AVX2);
+}
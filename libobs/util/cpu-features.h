@@ -0,0 +1,20 @@
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ *   Detects instruction set extensions of the CPU that code compiled for them
+ * can use, which also requires the OS to save the extended registers.  The
+ * results are cached, and always false on CPUs other than x86.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+EXPORT bool os_cpu_has_avx(void);
+EXPORT bool os_cpu_has_avx2(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -147,6 +147,33 @@ bool os_sleepto_ns(uint64_t time_target)
 	return true;
 }
 
+bool os_sleepto_ns_hybrid(uint64_t time_target, uint64_t spin_ns)
+{
+	uint64_t current = os_gettime_ns();
+	if (time_target < current)
+		return false;
+
+	if (time_target - current > spin_ns) {
+#if defined(__APPLE__)
+		os_sleepto_ns(time_target - spin_ns);
+#else
+		/* os_gettime_ns is CLOCK_MONOTONIC, so the deadline can be
+		 * slept to directly without drifting on interruptions */
+		uint64_t wake = time_target - spin_ns;
+		struct timespec req;
+		req.tv_sec = wake/1000000000;
+		req.tv_nsec = wake%1000000000;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req,
+					NULL) == EINTR);
+#endif
+	}
+
+	while (os_gettime_ns() < time_target);
+
+	return true;
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	usleep(duration*1000);
@@ -186,6 +186,25 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 }
 
+bool os_sleepto_ns_hybrid(uint64_t time_target, uint64_t spin_ns)
+{
+	uint64_t t = os_gettime_ns();
+	uint32_t milliseconds;
+
+	if (t >= time_target)
+		return false;
+
+	if (time_target - t > spin_ns) {
+		milliseconds = (uint32_t)((time_target - spin_ns - t)/1000000);
+		if (milliseconds)
+			Sleep(milliseconds);
+	}
+
+	while (os_gettime_ns() < time_target);
+
+	return true;
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	/* windows 8+ appears to have decreased sleep precision */
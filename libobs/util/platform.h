@@ -95,6 +95,13 @@ EXPORT void                   os_end_high_performance(os_performance_token_t *);
  * Returns false if already at or past target time.
  */
 EXPORT bool os_sleepto_ns(uint64_t time_target);
+
+/**
+ * Sleeps to a specific time (in nanoseconds) on an absolute deadline, waking
+ * spin_ns early and busy-waiting the rest so the target is hit as closely as
+ * possible.  Returns false if already at or past target time.
+ */
+EXPORT bool os_sleepto_ns_hybrid(uint64_t time_target, uint64_t spin_ns);
 EXPORT void os_sleep_ms(uint32_t duration);
 
 EXPORT uint64_t os_gettime_ns(void);
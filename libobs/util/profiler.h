@@ -20,6 +20,10 @@ EXPORT void profile_register_root(const char *name,
 EXPORT void profile_start(const char *name);
 EXPORT void profile_end(const char *name);
 
+/* records a value measured elsewhere (e.g. a wake-up error) as a call that
+ * took duration_ns, under the current profile_start scope if there is one */
+EXPORT void profile_record(const char *name, uint64_t duration_ns);
+
 EXPORT void profile_reenable_thread(void);
 
 /* ------------------------------------------------------------------------- */
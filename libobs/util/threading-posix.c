@@ -246,6 +246,17 @@ int  os_sem_wait(os_sem_t *sem)
 
 #endif
 
+bool os_set_thread_realtime(void)
+{
+	struct sched_param param = {0};
+
+	/* stay at the bottom of the real-time range, anything above normal
+	 * threads is enough and this leaves room for audio servers */
+	param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
 void os_set_thread_name(const char *name)
 {
 #if defined(__APPLE__)
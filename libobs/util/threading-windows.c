@@ -163,6 +163,12 @@ struct vs_threadname_info {
 #define THREADNAME_INFO_SIZE \
 	(sizeof(struct vs_threadname_info) / sizeof(ULONG_PTR))
 
+bool os_set_thread_realtime(void)
+{
+	return !!SetThreadPriority(GetCurrentThread(),
+			THREAD_PRIORITY_TIME_CRITICAL);
+}
+
 void os_set_thread_name(const char *name)
 {
 #ifdef __MINGW32__
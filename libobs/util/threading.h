@@ -78,6 +78,10 @@ EXPORT int  os_sem_wait(os_sem_t *sem);
 
 EXPORT void os_set_thread_name(const char *name);
 
+/* raises the calling thread to real-time priority (SCHED_FIFO on posix),
+ * returns false if the system does not permit it */
+EXPORT bool os_set_thread_realtime(void);
+
 
 #ifdef __cplusplus
 }
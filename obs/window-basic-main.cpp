@@ -153,7 +153,7 @@ OBSBasic::OBSBasic(QWidget *parent)
 	ui->sources->setAttribute(Qt::WA_MacShowFocusRect, false);
 
 	connect(windowHandle(), &QWindow::screenChanged, [this]() {
-		struct obs_video_info ovi;
+		struct obs_video_info ovi = {};
 
 		if (obs_get_video_info(&ovi))
 			ResizePreview(ovi.base_width, ovi.base_height);
@@ -917,7 +917,7 @@ void OBSBasic::OBSInit()
 		obs_display_add_draw_callback(window->GetDisplay(),
 				OBSBasic::RenderMain, this);
 
-		struct obs_video_info ovi;
+		struct obs_video_info ovi = {};
 		if (obs_get_video_info(&ovi))
 			ResizePreview(ovi.base_width, ovi.base_height);
 	};
@@ -2115,7 +2115,7 @@ int OBSBasic::ResetVideo()
 {
 	ProfileScope("OBSBasic::ResetVideo");
 
-	struct obs_video_info ovi;
+	struct obs_video_info ovi = {};
 	int ret;
 
 	GetConfigFPS(ovi.fps_num, ovi.fps_den);
@@ -2168,7 +2168,7 @@ bool OBSBasic::ResetAudio()
 {
 	ProfileScope("OBSBasic::ResetAudio");
 
-	struct obs_audio_info ai;
+	struct obs_audio_info ai = {};
 	ai.samples_per_sec = config_get_uint(basicConfig, "Audio",
 			"SampleRate");
 
@@ -2322,7 +2322,7 @@ void OBSBasic::changeEvent(QEvent *event)
 
 void OBSBasic::resizeEvent(QResizeEvent *event)
 {
-	struct obs_video_info ovi;
+	struct obs_video_info ovi = {};
 
 	if (obs_get_video_info(&ovi))
 		ResizePreview(ovi.base_width, ovi.base_height);
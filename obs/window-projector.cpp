@@ -70,7 +70,7 @@ void OBSProjector::OBSRender(void *data, uint32_t cx, uint32_t cy)
 		targetCX = std::max(obs_source_get_width(window->source), 1u);
 		targetCY = std::max(obs_source_get_height(window->source), 1u);
 	} else {
-		struct obs_video_info ovi;
+		struct obs_video_info ovi = {};
 		obs_get_video_info(&ovi);
 		targetCX = ovi.base_width;
 		targetCY = ovi.base_height;
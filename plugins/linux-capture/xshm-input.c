@@ -453,6 +453,15 @@ static void xshm_video_render(void *vptr, gs_effect_t *effect)
 	}
 }
 
+/**
+ * The capture is drawn opaque whenever the texture exists
+ */
+static bool xshm_is_opaque(void *vptr)
+{
+	XSHM_DATA(vptr);
+	return data->texture != NULL;
+}
+
 /**
  * Width of the captured data
  */
@@ -475,7 +484,8 @@ struct obs_source_info xshm_input = {
 	.id             = "xshm_input",
 	.type           = OBS_SOURCE_TYPE_INPUT,
 	.output_flags   = OBS_SOURCE_VIDEO |
-	                  OBS_SOURCE_CUSTOM_DRAW,
+	                  OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.get_name       = xshm_getname,
 	.create         = xshm_create,
 	.destroy        = xshm_destroy,
@@ -485,5 +495,6 @@ struct obs_source_info xshm_input = {
 	.video_tick     = xshm_video_tick,
 	.video_render   = xshm_video_render,
 	.get_width      = xshm_getwidth,
-	.get_height     = xshm_getheight
+	.get_height     = xshm_getheight,
+	.is_opaque      = xshm_is_opaque
 };
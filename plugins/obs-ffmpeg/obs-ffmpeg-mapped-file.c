@@ -0,0 +1,221 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/base.h>
+
+#include "obs-ffmpeg-mapped-file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+struct mapped_file {
+	uint8_t *data;
+	size_t  size;
+
+#ifdef _WIN32
+	HANDLE  file;
+	HANDLE  mapping;
+#else
+	int     fd;
+#endif
+};
+
+#ifdef _WIN32
+
+mapped_file_t *mapped_file_create(const char *path, size_t size)
+{
+	struct mapped_file *mf = bzalloc(sizeof(struct mapped_file));
+	wchar_t *wpath = NULL;
+	LARGE_INTEGER li;
+
+	os_utf8_to_wcs_ptr(path, 0, &wpath);
+
+	mf->size = size;
+	mf->file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+			CREATE_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+			NULL);
+	bfree(wpath);
+
+	if (mf->file == INVALID_HANDLE_VALUE) {
+		blog(LOG_WARNING, "mapped_file_create: Failed to create '%s': "
+				"%lu", path, GetLastError());
+		mf->file = NULL;
+		goto fail;
+	}
+
+	li.QuadPart = (LONGLONG)size;
+	mf->mapping = CreateFileMappingW(mf->file, NULL, PAGE_READWRITE,
+			li.HighPart, li.LowPart, NULL);
+	if (!mf->mapping) {
+		blog(LOG_WARNING, "mapped_file_create: Failed to create "
+				"mapping for '%s': %lu", path, GetLastError());
+		goto fail;
+	}
+
+	mf->data = MapViewOfFile(mf->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!mf->data) {
+		blog(LOG_WARNING, "mapped_file_create: Failed to map '%s': "
+				"%lu", path, GetLastError());
+		goto fail;
+	}
+
+	return mf;
+
+fail:
+	mapped_file_destroy(mf);
+	return NULL;
+}
+
+void mapped_file_destroy(mapped_file_t *mf)
+{
+	if (!mf)
+		return;
+
+	if (mf->data)
+		UnmapViewOfFile(mf->data);
+	if (mf->mapping)
+		CloseHandle(mf->mapping);
+	if (mf->file)
+		CloseHandle(mf->file);
+
+	bfree(mf);
+}
+
+#else
+
+mapped_file_t *mapped_file_create(const char *path, size_t size)
+{
+	struct mapped_file *mf;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd == -1) {
+		blog(LOG_WARNING, "mapped_file_create: Failed to create '%s'",
+				path);
+		return NULL;
+	}
+
+	/* the mapping keeps the file alive until it is unmapped */
+	unlink(path);
+
+#ifdef __linux__
+	if (posix_fallocate(fd, 0, (off_t)size) != 0) {
+#else
+	if (ftruncate(fd, (off_t)size) != 0) {
+#endif
+		blog(LOG_WARNING, "mapped_file_create: Failed to allocate "
+				"%llu bytes for '%s'",
+				(unsigned long long)size, path);
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		blog(LOG_WARNING, "mapped_file_create: Failed to map '%s'",
+				path);
+		close(fd);
+		return NULL;
+	}
+
+	/* the descriptor is kept for in-kernel copies */
+	mf = bzalloc(sizeof(struct mapped_file));
+	mf->data = data;
+	mf->size = size;
+	mf->fd = fd;
+	return mf;
+}
+
+void mapped_file_destroy(mapped_file_t *mf)
+{
+	if (!mf)
+		return;
+
+	munmap(mf->data, mf->size);
+	close(mf->fd);
+	bfree(mf);
+}
+
+#endif
+
+uint8_t *mapped_file_data(mapped_file_t *mf)
+{
+	return mf ? mf->data : NULL;
+}
+
+size_t mapped_file_size(mapped_file_t *mf)
+{
+	return mf ? mf->size : 0;
+}
+
+#ifdef __linux__
+static size_t copy_in_kernel(mapped_file_t *mf, size_t offset, size_t size,
+		FILE *dst)
+{
+	int out_fd = fileno(dst);
+	off_t in_offset = (off_t)offset;
+	size_t copied = 0;
+
+	if (fflush(dst) != 0)
+		return 0;
+
+	while (copied < size) {
+		ssize_t ret = sendfile(out_fd, mf->fd, &in_offset,
+				size - copied);
+		if (ret <= 0)
+			break;
+
+		copied += (size_t)ret;
+	}
+
+	/* sendfile bypasses the stream, so move the stream position to
+	 * where the data actually ended up */
+	fseek(dst, 0, SEEK_END);
+	return copied;
+}
+#endif
+
+bool mapped_file_write_to(mapped_file_t *mf, size_t offset, size_t size,
+		FILE *dst)
+{
+	if (!mf || !dst || offset + size > mf->size)
+		return false;
+
+#ifdef __linux__
+	size_t copied = copy_in_kernel(mf, offset, size, dst);
+	offset += copied;
+	size -= copied;
+#endif
+
+	if (!size)
+		return true;
+
+	return fwrite(mf->data + offset, 1, size, dst) == size;
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <util/c99defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Preallocated, read/write memory mapped scratch file.  The file is deleted
+ * as soon as the mapping is destroyed (or the process exits).
+ */
+
+struct mapped_file;
+typedef struct mapped_file mapped_file_t;
+
+mapped_file_t *mapped_file_create(const char *path, size_t size);
+void mapped_file_destroy(mapped_file_t *file);
+
+uint8_t *mapped_file_data(mapped_file_t *file);
+size_t mapped_file_size(mapped_file_t *file);
+
+/*
+ * Appends a range of the mapped file to an output file.  On Linux the kernel
+ * copies the data with sendfile, elsewhere it's written from the mapping.
+ */
+bool mapped_file_write_to(mapped_file_t *file, size_t offset, size_t size,
+		FILE *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -21,16 +21,20 @@
 #include <util/dstr.hpp>
 #include <util/pipe.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "obs-ffmpeg-mapped-file.h"
 
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -46,10 +50,25 @@ extern "C" {
 }
 
 const auto settings_buffer_length_name = "buffer_length";
+const auto settings_in_process_muxing_name = "in_process_muxing";
+const auto settings_writer_threads_name = "writer_threads";
+const auto settings_disk_buffer_path_name = "disk_buffer_path";
+const auto settings_disk_buffer_size_name = "disk_buffer_size";
+const auto settings_premux_segments_name = "premux_segments";
+const auto settings_shared_store_name = "shared_store";
+const auto settings_memory_budget_name = "memory_budget";
 
 using namespace std;
 
 namespace std {
+template <>
+struct default_delete<mapped_file_t> {
+	void operator()(mapped_file_t *file)
+	{
+		mapped_file_destroy(file);
+	}
+};
+
 template <>
 struct default_delete<os_process_pipe_t> {
 	void operator()(os_process_pipe_t *pipe)
@@ -77,40 +96,255 @@ struct default_delete<calldata_t> {
 
 #define LOCK(x) lock_guard<decltype(x)> lock ## __LINE__{x}
 
+#ifdef _WIN32
+#ifdef _WIN64
+#define FFMPEG_MUX "ffmpeg-mux64.exe"
+#else
+#define FFMPEG_MUX "ffmpeg-mux32.exe"
+#endif
+#else
+#define FFMPEG_MUX "ffmpeg-mux"
+#endif
+
 namespace {
 
 struct ffmpeg_muxer;
+struct mux_params;
+
+/* av_err2str relies on compound literals, which aren't valid C++ */
+struct av_error {
+	char str[AV_ERROR_MAX_STRING_SIZE];
+
+	explicit av_error(int err)
+	{
+		av_make_error_string(str, AV_ERROR_MAX_STRING_SIZE, err);
+	}
+};
 
 }
 
-static bool build_command_line(struct ffmpeg_muxer *stream, const dstr *path,
+static bool gather_mux_params(struct ffmpeg_muxer *stream,
+		struct mux_params &params);
+static void flush_fragments(struct ffmpeg_muxer *stream);
+static void stop_premux(struct ffmpeg_muxer *stream);
+static bool build_command_line(struct ffmpeg_muxer *stream,
+		const struct mux_params &params, const dstr *path,
 		struct dstr *cmd);
 static bool write_packet(struct ffmpeg_muxer *stream, os_process_pipe_t *pipe,
 		struct encoder_packet *packet);
 
 namespace {
 
+struct disk_ring;
+
+/* A contiguous block of the disk ring, released back to the ring once the
+ * last segment referencing it is gone */
+struct ring_region {
+	shared_ptr<disk_ring>  ring;
+	size_t                 offset;
+	size_t                 size;
+	uint8_t                *data;
+
+	~ring_region();
+};
+
+/* Preallocated memory mapped file that finalized segments are moved to, so
+ * only the packet index has to stay in memory.  Regions are handed out in
+ * order and freed (mostly) in order, like a ring buffer; if the oldest
+ * regions are still in use by clip writers when the ring wraps, new
+ * segments simply stay in memory until space becomes available again. */
+struct disk_ring : enable_shared_from_this<disk_ring> {
+	struct region_info {
+		size_t             offset;
+		size_t             size;
+		bool               freed;
+	};
+
+	unique_ptr<mapped_file_t> file;
+	uint8_t                *data;
+	size_t                 size;
+
+	mutex                  ring_mutex;
+	deque<region_info>     regions;
+	size_t                 head = 0;
+
+	explicit disk_ring(mapped_file_t *file_)
+		: file(file_),
+		  data(mapped_file_data(file_)),
+		  size(mapped_file_size(file_))
+	{}
+
+	shared_ptr<ring_region> Allocate(size_t bytes)
+	{
+		if (!bytes || bytes > size)
+			return nullptr;
+
+		size_t offset;
+
+		{
+			LOCK(ring_mutex);
+			if (!FindSpace(bytes, offset))
+				return nullptr;
+
+			regions.push_back({offset, bytes, false});
+			head = offset + bytes;
+		}
+
+		auto region = make_shared<ring_region>();
+		region->ring = shared_from_this();
+		region->offset = offset;
+		region->size = bytes;
+		region->data = data + offset;
+		return region;
+	}
+
+	void Free(size_t offset)
+	{
+		LOCK(ring_mutex);
+		for (auto &region : regions) {
+			if (region.offset == offset) {
+				region.freed = true;
+				break;
+			}
+		}
+
+		while (!regions.empty() && regions.front().freed)
+			regions.pop_front();
+
+		if (regions.empty())
+			head = 0;
+	}
+
+private:
+	bool FindSpace(size_t bytes, size_t &offset)
+	{
+		if (regions.empty()) {
+			offset = 0;
+			return true;
+		}
+
+		size_t tail = regions.front().offset;
+
+		/* used space is [tail, head), free space wraps around */
+		if (head > tail) {
+			if (size - head >= bytes) {
+				offset = head;
+				return true;
+			}
+
+			if (tail >= bytes) {
+				offset = 0;
+				return true;
+			}
+
+			return false;
+		}
+
+		/* used space wrapped around, free space is [head, tail) */
+		if (tail - head >= bytes) {
+			offset = head;
+			return true;
+		}
+
+		return false;
+	}
+};
+
+ring_region::~ring_region()
+{
+	ring->Free(offset);
+}
+
 struct packets_segment {
-	using data_t = std::vector<uint8_t>;
-	using offset_t = data_t::size_type;
 	vector<encoder_packet> pkts;
-	vector<offset_t>       offsets;
-	data_t                 data;
 	bool                   finalized = false;
 
+	/* set once the packet data has been moved to the disk ring, the
+	 * packets then point into the mapped region instead of holding
+	 * references to the encoder packets */
+	shared_ptr<ring_region> region;
+
+	/* muxed (fMP4) fragments of this segment when pre-muxing is enabled,
+	 * the packets then only carry metadata */
+	vector<uint8_t>        fragment;
+	size_t                 fragment_size = 0;
+	size_t                 fragment_offset = 0;
+
 	int64_t                keyframe_pts;
 	double                 first_pts;
 	double                 last_pts;
 	bool                   have_pts = false;
 
-	void AddPacket(const encoder_packet &pkt)
+	/* position of the segment within the encoded stream and the tracked
+	 * frames it contains, used for the segment index */
+	uint64_t               byte_offset = 0;
+	uint64_t               bytes = 0;
+	vector<video_tracked_frame_id> tracked_ids;
+
+	packets_segment() = default;
+
+	packets_segment(const packets_segment &other)
+	{
+		*this = other;
+	}
+
+	packets_segment &operator=(const packets_segment &other)
+	{
+		if (this == &other)
+			return *this;
+
+		Clear();
+
+		region = other.region;
+		if (region) {
+			pkts = other.pkts;
+		} else {
+			pkts.reserve(other.pkts.size());
+			for (auto &pkt : other.pkts) {
+				encoder_packet ref;
+				obs_encoder_packet_ref(&ref, &pkt);
+				pkts.push_back(ref);
+			}
+		}
+
+		fragment = other.fragment;
+		fragment_size = other.fragment_size;
+		fragment_offset = other.fragment_offset;
+
+		finalized = other.finalized;
+		keyframe_pts = other.keyframe_pts;
+		first_pts = other.first_pts;
+		last_pts = other.last_pts;
+		have_pts = other.have_pts;
+		byte_offset = other.byte_offset;
+		bytes = other.bytes;
+		tracked_ids = other.tracked_ids;
+		return *this;
+	}
+
+	~packets_segment()
+	{
+		Clear();
+	}
+
+	void AddPacket(const encoder_packet &pkt, bool keep_data=true)
 	{
 		if (finalized)
 			return;
 
-		pkts.push_back(pkt);
-		offsets.push_back(data.size());
-		data.insert(end(data), pkt.data, pkt.data + pkt.size);
+		encoder_packet ref;
+		if (keep_data) {
+			obs_encoder_packet_ref(&ref, &pkt);
+		} else {
+			ref = pkt;
+			ref.data = nullptr;
+		}
+		pkts.push_back(ref);
+
+		bytes += pkt.size;
+		if (pkt.tracked_id &&
+		    !video_frame_is_trace_sample(pkt.tracked_id))
+			tracked_ids.push_back(pkt.tracked_id);
 
 		auto pkt_pts = static_cast<double>(pkt.pts) * pkt.timebase_num / pkt.timebase_den;
 
@@ -127,63 +361,1195 @@ struct packets_segment {
 	}
 
 	void Finalize()
+	{
+		finalized = true;
+	}
+
+	/* releases all packet references, but keeps the allocated packet
+	 * list around so pooled segments don't have to grow it again */
+	void Clear()
+	{
+		if (!region) {
+			for (auto &pkt : pkts)
+				obs_encoder_packet_release(&pkt);
+		}
+
+		region.reset();
+		pkts.clear();
+		fragment.clear();
+		fragment_size = 0;
+		fragment_offset = 0;
+		byte_offset = 0;
+		bytes = 0;
+		tracked_ids.clear();
+		finalized = false;
+		have_pts = false;
+	}
+
+	void AppendFragment(const uint8_t *data, size_t size)
 	{
 		if (finalized)
 			return;
 
-		for (size_t i = 0, size = pkts.size(); i < size; i++)
-			pkts[i].data = data.data() + offsets[i];
+		fragment.insert(end(fragment), data, data + size);
+		fragment_size = fragment.size();
+	}
+
+	const uint8_t *FragmentData() const
+	{
+		return region ? region->data + fragment_offset :
+			fragment.data();
+	}
+
+	/* moves the packet data and fragments of a finalized segment to the
+	 * disk ring */
+	bool MoveTo(disk_ring &ring)
+	{
+		if (region || !finalized)
+			return false;
+
+		size_t data_size = 0;
+		for (auto &pkt : pkts)
+			if (pkt.data)
+				data_size += pkt.size;
+
+		auto new_region = ring.Allocate(data_size + fragment_size);
+		if (!new_region)
+			return false;
+
+		auto dst = new_region->data;
+		for (auto &pkt : pkts) {
+			if (!pkt.data)
+				continue;
+
+			auto moved = pkt;
+			memcpy(dst, pkt.data, pkt.size);
+			obs_encoder_packet_release(&pkt);
+
+			pkt = moved;
+			pkt.data = dst;
+			dst += pkt.size;
+		}
+
+		fragment_offset = data_size;
+		memcpy(dst, fragment.data(), fragment_size);
+		vector<uint8_t>().swap(fragment);
+
+		region = move(new_region);
+		return true;
+	}
+
+	double Length() const
+	{
+		return last_pts - first_pts;
+	}
+
+	/* memory held by the segment, packet data on the disk ring isn't
+	 * counted */
+	size_t MemoryBytes() const
+	{
+		size_t size = pkts.size() * sizeof(encoder_packet) +
+			fragment.size();
+
+		if (!region)
+			for (auto &pkt : pkts)
+				if (pkt.data)
+					size += pkt.size;
+
+		return size;
+	}
+
+	/* memory kept around by a cleared segment for reuse */
+	size_t PooledBytes() const
+	{
+		return pkts.capacity() * sizeof(encoder_packet) +
+			fragment.capacity() +
+			tracked_ids.capacity() * sizeof(video_tracked_frame_id);
+	}
+};
+
+/* Buffered segments are kept in time order, so the segment index is just
+ * the segment list itself searched with binary search */
+template <typename Segments>
+static auto first_segment_ending_after(Segments &segments, double pts)
+	-> decltype(begin(segments))
+{
+	return upper_bound(begin(segments), end(segments), pts,
+			[](double pts, const shared_ptr<const packets_segment> &seg)
+	{
+		return pts < seg->last_pts;
+	});
+}
+
+template <typename Segments>
+static auto first_segment_starting_after(Segments &segments, double pts)
+	-> decltype(begin(segments))
+{
+	return upper_bound(begin(segments), end(segments), pts,
+			[](double pts, const shared_ptr<const packets_segment> &seg)
+	{
+		return pts < seg->first_pts;
+	});
+}
+
+/* Segments only hold references to the (refcounted) packets created by
+ * libobs, so the only thing worth recycling is the segment objects and
+ * their packet lists.  The pool is shared by all recording buffer outputs
+ * and is kept alive by the segments that were created from it. */
+struct segment_pool : enable_shared_from_this<segment_pool> {
+	mutex                     pool_mutex;
+	vector<packets_segment*>  free_segments;
+	size_t                    used_segments = 0;
+
+	~segment_pool()
+	{
+		for (auto seg : free_segments)
+			delete seg;
+	}
+
+	shared_ptr<packets_segment> Create()
+	{
+		packets_segment *seg = nullptr;
+
+		{
+			LOCK(pool_mutex);
+			if (!free_segments.empty()) {
+				seg = free_segments.back();
+				free_segments.pop_back();
+			}
+
+			used_segments += 1;
+		}
+
+		if (!seg)
+			seg = new packets_segment;
+
+		auto pool = shared_from_this();
+		return {seg, [pool](packets_segment *seg)
+		{
+			pool->Recycle(seg);
+		}};
+	}
+
+	void Recycle(packets_segment *seg)
+	{
+		seg->Clear();
+
+		LOCK(pool_mutex);
+		free_segments.push_back(seg);
+		used_segments -= 1;
+	}
+
+	/* after a peak (e.g. a long keyframe interval or a buffer that got
+	 * evicted) most pooled segments would never be used again, only keep
+	 * a few of them around relative to the segments still in use */
+	void Trim()
+	{
+		vector<packets_segment*> trimmed;
+
+		{
+			LOCK(pool_mutex);
+			size_t keep = used_segments / 4 + 4;
+			if (free_segments.size() <= keep)
+				return;
+
+			trimmed.assign(begin(free_segments) + keep,
+					end(free_segments));
+			free_segments.resize(keep);
+		}
+
+		for (auto seg : trimmed)
+			delete seg;
+	}
+
+	size_t PooledBytes()
+	{
+		LOCK(pool_mutex);
+
+		size_t bytes = 0;
+		for (auto seg : free_segments)
+			bytes += sizeof(packets_segment) + seg->PooledBytes();
+
+		return bytes;
+	}
+
+	static shared_ptr<segment_pool> Get()
+	{
+		static mutex instance_mutex;
+		static weak_ptr<segment_pool> instance;
+
+		LOCK(instance_mutex);
+		auto pool = instance.lock();
+		if (!pool) {
+			pool = make_shared<segment_pool>();
+			instance = pool;
+		}
+
+		return pool;
+	}
+};
+
+struct buffer_output;
+
+/* A small fixed set of threads that write all clips of a recording buffer
+ * output.  Clip writers never block while waiting for future packets, they
+ * are rescheduled whenever there is new work for them instead. */
+struct writer_pool {
+	mutex                  jobs_mutex;
+	condition_variable     jobs_update;
+	deque<function<void()>> jobs;
+	vector<thread>         threads;
+	bool                   exit_threads = false;
+
+	explicit writer_pool(size_t num_threads)
+	{
+		for (size_t i = 0; i < num_threads; i++)
+			threads.emplace_back([this]()
+			{
+				WorkerThread();
+			});
+	}
+
+	~writer_pool()
+	{
+		{
+			LOCK(jobs_mutex);
+			exit_threads = true;
+		}
+		jobs_update.notify_all();
+
+		for (auto &thread : threads)
+			thread.join();
+	}
+
+	void Push(function<void()> job)
+	{
+		{
+			LOCK(jobs_mutex);
+			jobs.emplace_back(move(job));
+		}
+		jobs_update.notify_one();
+	}
+
+private:
+	void WorkerThread()
+	{
+		os_set_thread_name("recordingbuffer: writer");
+
+		for (;;) {
+			function<void()> job;
+
+			{
+				unique_lock<decltype(jobs_mutex)> lock(jobs_mutex);
+				jobs_update.wait(lock, [&]
+				{
+					return exit_threads || !jobs.empty();
+				});
+
+				/* pending jobs still have to run so that
+				 * cancelled clips get cleaned up */
+				if (jobs.empty())
+					return;
+
+				job = move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+};
+
+/* Lock-free handoff from any number of control threads to the packet
+ * thread, which takes all pushed items at once (in push order) */
+template <typename T>
+struct handoff_queue {
+	struct node {
+		T    value;
+		node *next;
+	};
+
+	atomic<node*>          head{nullptr};
+
+	~handoff_queue()
+	{
+		Take();
+	}
+
+	void Push(T value)
+	{
+		auto item = new node{move(value),
+			head.load(memory_order_relaxed)};
+
+		while (!head.compare_exchange_weak(item->next, item,
+					memory_order_release,
+					memory_order_relaxed));
+	}
+
+	vector<T> Take()
+	{
+		vector<T> items;
+		if (!head.load(memory_order_relaxed))
+			return items;
+
+		auto item = head.exchange(nullptr, memory_order_acquire);
+		while (item) {
+			items.push_back(move(item->value));
+
+			auto next = item->next;
+			delete item;
+			item = next;
+		}
+
+		reverse(begin(items), end(items));
+		return items;
+	}
+};
+
+/* Buffered segments are published as a singly linked list.  The packet
+ * thread only links new segments after the newest one, which snapshots never
+ * read past, so publishing a segment doesn't copy the list; dropped segments
+ * are freed along with the last snapshot that still includes them */
+struct segment_node {
+	shared_ptr<const packets_segment> segment;
+	shared_ptr<segment_node>          next;
+
+	static shared_ptr<segment_node> Create();
+};
+
+/* Releasing the last reference to a node releases its successor from
+ * within the deleter, so a plain shared_ptr would free a long list
+ * recursively.  Nested calls only queue their node for the outermost call
+ * instead, which frees the list one node at a time */
+struct segment_node_deleter {
+	void operator()(segment_node *node) const
+	{
+		static thread_local bool deleting = false;
+		static thread_local segment_node *queued = nullptr;
+
+		if (deleting) {
+			queued = node;
+			return;
+		}
+
+		deleting = true;
+		while (node) {
+			delete node;
+
+			node = queued;
+			queued = nullptr;
+		}
+		deleting = false;
+	}
+};
+
+shared_ptr<segment_node> segment_node::Create()
+{
+	return shared_ptr<segment_node>(new segment_node,
+			segment_node_deleter());
+}
+
+/* Immutable view of a store, republished by the packet thread whenever the
+ * buffered segments change.  Save requests and the segment index only ever
+ * look at a snapshot, so they never wait for packet ingestion (or the
+ * other way around) */
+struct segment_snapshot {
+	shared_ptr<const segment_node>      first;
+	size_t                              count = 0;
+	shared_ptr<const packets_segment>   headers;
+	shared_ptr<const vector<uint8_t>>   fragment_init;
+
+	/* number of segments added to the store before this snapshot */
+	uint64_t                            serial = 0;
+	uint64_t                            memory_bytes = 0;
+
+	vector<shared_ptr<const packets_segment>> Segments() const
+	{
+		vector<shared_ptr<const packets_segment>> segments;
+		segments.reserve(count);
+
+		for (auto node = first.get(); node; node = node->next.get()) {
+			segments.push_back(node->segment);
+			if (segments.size() == count)
+				break;
+		}
+
+		return segments;
+	}
+};
+
+/* Buffered packets of one set of encoders.  Recording buffer outputs that
+ * use the same "shared_store" name and the same encoders share a store:
+ * only one of them (the feeder) adds packets, and the store retains enough
+ * data for the longest buffer_length of all attached outputs.
+ *
+ * buffer_mutex is only taken on the packet thread and when outputs start,
+ * stop or get destroyed; save requests are handed to the packet thread
+ * through new_outputs instead */
+struct packet_store {
+	mutex             buffer_mutex;
+
+	ffmpeg_muxer      *feeder = nullptr;
+	vector<ffmpeg_muxer*> muxers;
+
+	/* packets are stored on the timeline of the output that started
+	 * feeding the store (its timestamp offsets are kept here), so that
+	 * another active output can take over feeding when the feeder stops.
+	 * Until the next keyframe the packets of the new feeder may overlap
+	 * with or miss packets of the previous one, so they're skipped */
+	int64_t           video_offset = 0;
+	int64_t           audio_offsets[MAX_AUDIO_MIXES] = {};
+	int64_t           last_video_dts = 0;
+	int64_t           last_audio_dts[MAX_AUDIO_MIXES] = {};
+	bool              hand_over = false;
+	bool              feeder_changed = false;
+
+	shared_ptr<segment_pool> pool = segment_pool::Get();
+
+	bool              have_headers = false;
+
+	shared_ptr<disk_ring> ring;
+	bool              ring_full = false;
+
+	bool              premux = false;
+	unique_ptr<struct fragment_muxer> fragments;
+	shared_ptr<const vector<uint8_t>> fragment_init;
+
+	shared_ptr<const packets_segment> encoder_headers =
+		make_shared<packets_segment>();
+	deque<shared_ptr<const packets_segment>> payload_data;
+	shared_ptr<packets_segment> current_segment;
+	uint64_t          pushed_segments = 0;
+
+	/* payload_data as published to the snapshots */
+	shared_ptr<segment_node> first_node;
+	shared_ptr<segment_node> last_node;
+
+	shared_ptr<const segment_snapshot> snapshot =
+		make_shared<segment_snapshot>();
+
+	handoff_queue<shared_ptr<buffer_output>> new_outputs;
+	vector<shared_ptr<buffer_output>> outputs;
+	vector<shared_ptr<buffer_output>> complete_outputs;
+
+	/* only used by the proc handlers */
+	mutex             interrupt_mutex;
+	uint32_t next_interruptiple_buffer_id = 0;
+	map<uint32_t, weak_ptr<buffer_output>> interruptible_buffers;
+
+	uint64_t          total_bytes = 0;
+
+	/* memory held by payload_data, limited by memory_budget (if set) by
+	 * evicting the oldest segments */
+	uint64_t          memory_bytes = 0;
+	uint64_t          memory_budget = 0;
+	bool              evicting = false;
+	atomic<uint64_t>  evicted_segments{0};
+	atomic<uint64_t>  evicted_bytes{0};
+
+	double BufferLength() const;
+
+	shared_ptr<const segment_snapshot> Snapshot() const
+	{
+		return atomic_load(&snapshot);
+	}
+
+	void Publish()
+	{
+		auto next = make_shared<segment_snapshot>();
+		next->first = first_node;
+		next->count = payload_data.size();
+		next->headers = encoder_headers;
+		next->fragment_init = fragment_init;
+		next->serial = pushed_segments;
+		next->memory_bytes = memory_bytes;
+
+		atomic_store(&snapshot,
+				shared_ptr<const segment_snapshot>(move(next)));
+	}
+
+	void PushSegment(shared_ptr<const packets_segment> seg)
+	{
+		auto node = segment_node::Create();
+		node->segment = seg;
+		if (last_node)
+			last_node->next = node;
+		else
+			first_node = node;
+		last_node = move(node);
+
+		memory_bytes += seg->MemoryBytes();
+		payload_data.emplace_back(move(seg));
+		pushed_segments += 1;
+	}
+
+	void EraseSegments(
+			deque<shared_ptr<const packets_segment>>::iterator last)
+	{
+		for (auto it = begin(payload_data); it != last; it++) {
+			memory_bytes -= (*it)->MemoryBytes();
+			first_node = first_node->next;
+		}
+
+		payload_data.erase(begin(payload_data), last);
+		if (payload_data.empty())
+			last_node.reset();
+	}
+
+	void ClearSegments()
+	{
+		payload_data.clear();
+		first_node.reset();
+		last_node.reset();
+		memory_bytes = 0;
+		Publish();
+	}
+
+	static shared_ptr<packet_store> GetShared(const string &key,
+			const function<shared_ptr<packet_store>()> &create)
+	{
+		static mutex stores_mutex;
+		static map<string, weak_ptr<packet_store>> stores;
+
+		LOCK(stores_mutex);
+		auto store = stores[key].lock();
+		if (!store) {
+			store = create();
+			stores[key] = store;
+		}
+
+		return store;
+	}
+};
+
+struct ffmpeg_muxer {
+	obs_output_t      *output;
+	bool              active = false;
+	bool              capturing = false;
+	double            buffer_length = 60.;
+	bool              in_process_muxing = true;
+
+	signal_handler_t  *signal;
+
+	DStr              shared_store;
+
+	/* replaced when the output starts on a shared store, proc handlers
+	 * can run at the same time and have to go through Store() */
+	shared_ptr<packet_store> store;
+
+	/* destroyed first, so all queued writes finish while the rest of
+	 * the muxer is still valid */
+	unique_ptr<writer_pool> writers;
+
+	shared_ptr<packet_store> Store() const
+	{
+		return atomic_load(&store);
+	}
+};
+
+double packet_store::BufferLength() const
+{
+	double length = 0.;
+	for (auto muxer : muxers) {
+		if (muxer->active)
+			length = max(length, muxer->buffer_length);
+	}
+
+	return length;
+}
+
+struct mux_audio_params {
+	DStr              name;
+	int               bitrate;
+	int               sample_rate;
+	int               channels;
+};
+
+struct mux_params {
+	bool              has_video = false;
+	int               vbitrate;
+	int               width;
+	int               height;
+	int               fps_num;
+	int               fps_den;
+
+	vector<mux_audio_params> audio;
+
+	DStr              muxer_settings;
+};
+
+struct clip_writer {
+	virtual ~clip_writer() {}
+
+	virtual bool Open(const char *path, const mux_params &params,
+			const packets_segment &headers)=0;
+	virtual bool WritePacket(encoder_packet &pkt)=0;
+	virtual bool Close()=0;
+
+	/* writers that write whole pre-muxed segments instead of packets */
+	virtual bool WritesSegments() const {return false;}
+	virtual bool WriteSegment(const packets_segment &) {return false;}
+
+	/* makes everything written so far readable from the file (as
+	 * complete fragments), size is set to the file size afterwards;
+	 * returns false if the writer can't do that */
+	virtual bool Flush(uint64_t &size) {UNUSED_PARAMETER(size); return false;}
+};
+
+/* Muxes clips with the ffmpeg-mux helper process, one process per clip */
+struct pipe_writer : clip_writer {
+	ffmpeg_muxer      *stream;
+	unique_ptr<os_process_pipe_t> pipe;
+
+	explicit pipe_writer(ffmpeg_muxer *stream) : stream(stream) {}
+
+	bool Open(const char *path, const mux_params &params,
+			const packets_segment &headers) override
+	{
+		DStr escaped_path;
+		dstr_copy(escaped_path, path);
+		dstr_replace(escaped_path, "\"", "\"\""); //?
+
+		DStr cmd;
+		if (!build_command_line(stream, params, escaped_path, cmd)) {
+			warn("Failed to build command line");
+			return false;
+		}
+
+		pipe.reset(os_process_pipe_create(cmd->array, "w"));
+		if (!pipe) {
+			warn("Failed to create process pipe");
+			return false;
+		}
+
+		for (auto pkt : headers.pkts) {
+			if (!write_packet(stream, pipe.get(), &pkt)) {
+				warn("Failed to write headers");
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool WritePacket(encoder_packet &pkt) override
+	{
+		return write_packet(stream, pipe.get(), &pkt);
+	}
+
+	bool Close() override
+	{
+		/* waits for ffmpeg-mux to finish writing the file */
+		pipe.reset();
+		return true;
+	}
+};
+
+/* Muxes clips with libavformat on the writer thread itself */
+struct avformat_writer : clip_writer {
+	ffmpeg_muxer      *stream;
+	AVFormatContext   *output = nullptr;
+	AVStream          *video_stream = nullptr;
+	vector<AVStream*> audio_streams;
+	bool              initialized = false;
+
+	/* write fragmented mp4/mov that can be flushed while the clip is
+	 * still being written */
+	bool              progressive = false;
+	bool              fragmented = false;
+
+	explicit avformat_writer(ffmpeg_muxer *stream, bool progressive=false)
+		: stream(stream),
+		  progressive(progressive)
+	{}
+
+	~avformat_writer()
+	{
+		Close();
+	}
+
+	bool Open(const char *path, const mux_params &params,
+			const packets_segment &headers) override
+	{
+		AVOutputFormat *format = av_guess_format(NULL, path, NULL);
+		if (!format) {
+			warn("Couldn't find an appropriate muxer for '%s'", path);
+			return false;
+		}
+
+		if (!CreateContext(format, params, headers))
+			return false;
+
+		if ((format->flags & AVFMT_NOFILE) == 0) {
+			int ret = avio_open(&output->pb, path, AVIO_FLAG_WRITE);
+			if (ret < 0) {
+				warn("Couldn't open '%s', %s", path,
+						av_error{ret}.str);
+				return false;
+			}
+		}
+
+		strncpy(output->filename, path, sizeof(output->filename));
+		output->filename[sizeof(output->filename) - 1] = 0;
+
+		DStr settings;
+		dstr_copy(settings, params.muxer_settings);
+
+		fragmented = progressive && (strstr(format->name, "mp4") ||
+				strstr(format->name, "mov"));
+		if (fragmented) {
+			/* packets are already interleaved by libobs, and
+			 * anything queued for interleaving would miss the
+			 * next flush */
+			interleave = false;
+			dstr_cat(settings, " movflags=frag_custom+empty_moov+"
+					"default_base_moof");
+		}
+
+		return WriteHeader(path, settings->array ? settings->array : "");
+	}
+
+	bool WritePacket(encoder_packet &pkt) override
+	{
+		AVStream *avstream = nullptr;
+		if (pkt.type == OBS_ENCODER_VIDEO)
+			avstream = video_stream;
+		else if (pkt.track_idx < audio_streams.size())
+			avstream = audio_streams[pkt.track_idx];
+
+		/* The muxer might not support video/audio, or multiple
+		 * audio tracks */
+		if (!avstream)
+			return true;
+
+		AVRational timebase{pkt.timebase_num, pkt.timebase_den};
+
+		AVPacket packet;
+		av_init_packet(&packet);
+		packet.data = pkt.data;
+		packet.size = static_cast<int>(pkt.size);
+		packet.stream_index = avstream->index;
+		packet.pts = av_rescale_q_rnd(pkt.pts, timebase,
+				avstream->time_base,
+				static_cast<AVRounding>(AV_ROUND_NEAR_INF |
+					AV_ROUND_PASS_MINMAX));
+		packet.dts = av_rescale_q_rnd(pkt.dts, timebase,
+				avstream->time_base,
+				static_cast<AVRounding>(AV_ROUND_NEAR_INF |
+					AV_ROUND_PASS_MINMAX));
+
+		if (pkt.keyframe)
+			packet.flags = AV_PKT_FLAG_KEY;
+
+		if (!interleave)
+			return av_write_frame(output, &packet) >= 0;
+
+		return av_interleaved_write_frame(output, &packet) >= 0;
+	}
+
+	bool Flush(uint64_t &size) override
+	{
+		if (!fragmented)
+			return false;
+
+		if (av_write_frame(output, nullptr) < 0)
+			return false;
+
+		avio_flush(output->pb);
+		size = static_cast<uint64_t>(avio_tell(output->pb));
+		return true;
+	}
+
+	bool Close() override
+	{
+		bool success = true;
+
+		if (initialized) {
+			success = av_write_trailer(output) >= 0;
+			initialized = false;
+		}
+
+		if (output) {
+			if (custom_io) {
+				av_free(output->pb->buffer);
+				av_free(output->pb);
+			} else if ((output->oformat->flags & AVFMT_NOFILE) == 0) {
+				avio_close(output->pb);
+			}
+
+			avformat_free_context(output);
+			output = nullptr;
+		}
+
+		return success;
+	}
+
+protected:
+	bool              custom_io = false;
+	bool              interleave = true;
+
+	bool CreateContext(AVOutputFormat *format, const mux_params &params,
+			const packets_segment &headers)
+	{
+		int ret = avformat_alloc_output_context2(&output, format,
+				NULL, NULL);
+		if (ret < 0) {
+			warn("Couldn't initialize output context: %s",
+					av_error{ret}.str);
+			return false;
+		}
+
+		if (params.has_video && !AddVideoStream(params, headers))
+			return false;
+
+		for (size_t i = 0; i < params.audio.size(); i++)
+			if (!AddAudioStream(params.audio[i], i, headers))
+				return false;
+
+		return true;
+	}
+
+	bool WriteHeader(const char *name, const char *settings)
+	{
+		int ret;
+
+		AVDictionary *dict = NULL;
+		if ((ret = av_dict_parse_string(&dict, settings, "=", " ", 0)))
+			warn("Failed to parse muxer settings: %s\n%s",
+					av_error{ret}.str, settings);
+
+		ret = avformat_write_header(output, &dict);
+		av_dict_free(&dict);
+
+		if (ret < 0) {
+			warn("Error opening '%s': %s", name, av_error{ret}.str);
+			return false;
+		}
+
+		initialized = true;
+		return true;
+	}
+
+private:
+	static void SetExtraData(AVCodecContext *context,
+			const encoder_packet *header)
+	{
+		if (!header || !header->size)
+			return;
+
+		context->extradata = static_cast<uint8_t*>(
+				av_mallocz(header->size +
+					FF_INPUT_BUFFER_PADDING_SIZE));
+		memcpy(context->extradata, header->data, header->size);
+		context->extradata_size = static_cast<int>(header->size);
+	}
+
+	static const encoder_packet *FindHeader(const packets_segment &headers,
+			obs_encoder_type type, size_t track_idx)
+	{
+		for (auto &pkt : headers.pkts)
+			if (pkt.type == type && (type == OBS_ENCODER_VIDEO ||
+						pkt.track_idx == track_idx))
+				return &pkt;
+
+		return nullptr;
+	}
+
+	bool AddVideoStream(const mux_params &params,
+			const packets_segment &headers)
+	{
+		video_stream = avformat_new_stream(output, NULL);
+		if (!video_stream) {
+			warn("Couldn't create video stream");
+			return false;
+		}
+
+		AVCodecContext *context = video_stream->codec;
+		context->codec_type     = AVMEDIA_TYPE_VIDEO;
+		context->codec_id       = AV_CODEC_ID_H264;
+		context->bit_rate       = params.vbitrate * 1000;
+		context->width          = params.width;
+		context->height         = params.height;
+		context->coded_width    = params.width;
+		context->coded_height   = params.height;
+		context->time_base      = {params.fps_den, params.fps_num};
+
+		SetExtraData(context, FindHeader(headers,
+					OBS_ENCODER_VIDEO, 0));
+
+		video_stream->time_base = context->time_base;
+
+		if (output->oformat->flags & AVFMT_GLOBALHEADER)
+			context->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+		return true;
+	}
+
+	bool AddAudioStream(const mux_audio_params &audio, size_t idx,
+			const packets_segment &headers)
+	{
+		AVStream *avstream = avformat_new_stream(output, NULL);
+		if (!avstream) {
+			warn("Couldn't create audio stream %d",
+					static_cast<int>(idx));
+			return false;
+		}
+
+		av_dict_set(&avstream->metadata, "title", audio.name, 0);
+
+		avstream->time_base = {1, audio.sample_rate};
+
+		AVCodecContext *context = avstream->codec;
+		context->codec_type     = AVMEDIA_TYPE_AUDIO;
+		context->codec_id       = AV_CODEC_ID_AAC;
+		context->bit_rate       = audio.bitrate * 1000;
+		context->channels       = audio.channels;
+		context->sample_rate    = audio.sample_rate;
+		context->sample_fmt     = AV_SAMPLE_FMT_S16;
+		context->time_base      = avstream->time_base;
+		context->channel_layout =
+			av_get_default_channel_layout(context->channels);
+
+		SetExtraData(context, FindHeader(headers,
+					OBS_ENCODER_AUDIO, idx));
+
+		if (output->oformat->flags & AVFMT_GLOBALHEADER)
+			context->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+		audio_streams.push_back(avstream);
+		return true;
+	}
+};
+
+/* Continuously muxes all incoming packets into fragmented MP4, the
+ * fragments are cut at segment boundaries (or whenever a clip needs the
+ * current, incomplete segment) and stored with the segments, so saving a
+ * clip only requires writing the init segment and the cached fragments */
+struct fragment_muxer : avformat_writer {
+	enum {
+		io_buffer_size = 64 * 1024
+	};
+
+	vector<uint8_t>   pending;
+	bool              have_packets = false;
+
+	explicit fragment_muxer(ffmpeg_muxer *stream)
+		: avformat_writer(stream)
+	{}
+
+	/* the base destructor would write the trailer through WriteCallback
+	 * after pending is already gone */
+	~fragment_muxer()
+	{
+		Close();
+	}
+
+	bool Open(const mux_params &params, const packets_segment &headers,
+			vector<uint8_t> &init)
+	{
+		AVOutputFormat *format = av_guess_format("mp4", NULL, NULL);
+		if (!format) {
+			warn("Couldn't find the mp4 muxer");
+			return false;
+		}
+
+		if (!CreateContext(format, params, headers))
+			return false;
+
+		auto buffer = static_cast<uint8_t*>(av_malloc(io_buffer_size));
+		output->pb = avio_alloc_context(buffer, io_buffer_size, 1,
+				this, nullptr, WriteCallback, nullptr);
+		if (!output->pb) {
+			av_free(buffer);
+			warn("Couldn't allocate fragment io context");
+			return false;
+		}
+
+		custom_io = true;
+
+		/* packets are already interleaved by libobs, and anything
+		 * queued for interleaving would miss the next flush */
+		interleave = false;
+
+		if (!WriteHeader("pre-muxed segments", "movflags="
+					"frag_custom+empty_moov+"
+					"default_base_moof"))
+			return false;
+
+		avio_flush(output->pb);
+		init.swap(pending);
+		pending.clear();
+		return true;
+	}
+
+	bool WritePacket(encoder_packet &pkt) override
+	{
+		have_packets = true;
+		return avformat_writer::WritePacket(pkt);
+	}
+
+	/* cuts a fragment containing everything written since the last
+	 * flush and appends it to the segment */
+	bool Flush(packets_segment &seg)
+	{
+		if (!have_packets)
+			return true;
+
+		have_packets = false;
+
+		if (av_write_frame(output, nullptr) < 0)
+			return false;
+
+		avio_flush(output->pb);
+
+		seg.AppendFragment(pending.data(), pending.size());
+		pending.clear();
+		return true;
+	}
+
+	bool Close() override
+	{
+		/* the trailer of a fragmented file isn't needed by anyone */
+		initialized = false;
+		return avformat_writer::Close();
+	}
+
+private:
+	static int WriteCallback(void *opaque, uint8_t *buf, int size)
+	{
+		auto muxer = static_cast<fragment_muxer*>(opaque);
+		muxer->pending.insert(end(muxer->pending), buf, buf + size);
+		return size;
+	}
+};
+
+/* Writes clips by concatenating pre-muxed fragments */
+struct premux_writer : clip_writer {
+	ffmpeg_muxer      *stream;
+	shared_ptr<const vector<uint8_t>> init;
+	FILE              *file = nullptr;
+
+	premux_writer(ffmpeg_muxer *stream,
+			shared_ptr<const vector<uint8_t>> init)
+		: stream(stream),
+		  init(move(init))
+	{}
+
+	~premux_writer()
+	{
+		Close();
+	}
+
+	bool Open(const char *path, const mux_params &,
+			const packets_segment &) override
+	{
+		file = os_fopen(path, "wb");
+		if (!file) {
+			warn("Couldn't open '%s'", path);
+			return false;
+		}
+
+		return fwrite(init->data(), 1, init->size(), file) ==
+			init->size();
+	}
+
+	bool WritePacket(encoder_packet &) override
+	{
+		return false;
+	}
+
+	bool WritesSegments() const override
+	{
+		return true;
+	}
+
+	bool WriteSegment(const packets_segment &seg) override
+	{
+		if (!seg.fragment_size)
+			return true;
+
+		if (seg.region)
+			return mapped_file_write_to(seg.region->ring->file.get(),
+					seg.region->offset + seg.fragment_offset,
+					seg.fragment_size, file);
+
+		return fwrite(seg.FragmentData(), 1, seg.fragment_size, file) ==
+			seg.fragment_size;
+	}
+
+	bool Flush(uint64_t &size) override
+	{
+		if (fflush(file) != 0)
+			return false;
 
-		finalized = true;
+		size = static_cast<uint64_t>(os_ftelli64(file));
+		return true;
 	}
 
-	double Length() const
+	bool Close() override
 	{
-		return last_pts - first_pts;
+		if (!file)
+			return true;
+
+		bool success = fclose(file) == 0;
+		file = nullptr;
+		return success;
 	}
 };
 
-struct buffer_output;
-
-struct ffmpeg_muxer {
-	obs_output_t      *output;
-	bool              have_headers = false;
-	bool              active = false;
-	bool              capturing = false;
-	double            buffer_length = 60.;
+static unique_ptr<clip_writer> create_writer(ffmpeg_muxer *stream,
+		const char *path, const mux_params &params,
+		const packets_segment &headers,
+		const shared_ptr<const vector<uint8_t>> &fragment_init,
+		bool progressive)
+{
+	unique_ptr<clip_writer> writer;
 
-	signal_handler_t  *signal;
+	if (fragment_init) {
+		writer.reset(new premux_writer{stream, fragment_init});
+		if (!writer->Open(path, params, headers))
+			return nullptr;
 
-	mutex             buffers_mutex;
-	vector<packets_segment::data_t> buffers;
+		return writer;
+	}
 
-	mutex             buffer_mutex;
+	if (stream->in_process_muxing) {
+		writer.reset(new avformat_writer{stream, progressive});
+		if (writer->Open(path, params, headers))
+			return writer;
 
-	packets_segment   encoder_headers;
-	deque<shared_ptr<packets_segment>> payload_data;
-	shared_ptr<packets_segment> current_segment;
+		warn("Failed to open '%s' with the in-process muxer, "
+				"falling back to " FFMPEG_MUX, path);
+		writer.reset();
+		os_unlink(path);
+	}
 
-	vector<unique_ptr<buffer_output>> outputs;
-	vector<unique_ptr<buffer_output>> complete_outputs;
+	writer.reset(new pipe_writer{stream});
+	if (!writer->Open(path, params, headers))
+		return nullptr;
 
-	uint32_t next_interruptiple_buffer_id = 0;
-	map<uint32_t, buffer_output*> interruptible_buffers;
-};
+	return writer;
+}
 
-struct buffer_output {
+struct buffer_output : enable_shared_from_this<buffer_output> {
 	ffmpeg_muxer      *stream;
-	unique_ptr<os_process_pipe_t> pipe;
+	shared_ptr<packet_store> store;
+	unique_ptr<clip_writer> writer;
+	mux_params        params;
 	DStr              path;
 	video_tracked_frame_id tracked_id;
 	bool              tracked_frame_pts_valid = false;
-	double            tracked_frame_pts;
-	bool              stop_frame_id_valid = false;
+	double            tracked_frame_pts = 0.;
 	bool              stop_frame_id_found = false;
-	video_tracked_frame_id stop_frame_id;
+	atomic<video_tracked_frame_id> stop_frame_id{0};
 	bool              keep_recording = false;
 	double            keep_recording_time = 0.;
 	double            save_duration = 0.;
 
+	/* write (and signal) each segment while the clip is still being
+	 * recorded instead of waiting for the end of the clip */
+	bool              progressive = false;
+
 	bool              buffer_id_valid = false;
 	uint32_t          buffer_id;
 
@@ -192,28 +1558,34 @@ struct buffer_output {
 	int64_t           end_dts;
 	bool              wait_for_dts = false;
 
-	packets_segment   &headers;
-	vector<shared_ptr<packets_segment>> initial_segments;
-	vector<shared_ptr<packets_segment>> new_segments;
+	shared_ptr<const packets_segment> headers;
+	shared_ptr<const vector<uint8_t>> fragment_init;
+	uint64_t          snapshot_serial;
+	vector<shared_ptr<const packets_segment>> initial_segments;
+	vector<shared_ptr<const packets_segment>> new_segments;
 	packets_segment   final_segment;
 
-	thread            output_thread;
 	mutex             output_mutex;
-	condition_variable output_update;
 	bool              finish_output = false;
 	bool              exit_thread = false;
+	bool              scheduled = false;
+	bool              reschedule = false;
 
 	atomic<bool>      thread_finished{};
 	int               total_frames = 0;
 
+	uint64_t          request_time_ns;
+	uint64_t          open_time_ns = 0;
+
 	unique_ptr<calldata_t> signal_data;
 
 	buffer_output(ffmpeg_muxer *stream, const char *path_,
 			video_tracked_frame_id tracked_id=0, double save_duration=0.)
 		: stream(stream),
+		  store(stream->Store()),
 		  tracked_id(tracked_id),
-		  headers(stream->encoder_headers),
-		  save_duration(save_duration)
+		  save_duration(save_duration),
+		  request_time_ns(os_gettime_ns())
 	{
 		dstr_copy(path, path_);
 
@@ -222,53 +1594,42 @@ struct buffer_output {
 		calldata_set_ptr(signal_data.get(), "output", stream->output);
 		calldata_set_string(signal_data.get(), "filename", path);
 
-		DStr escaped_path;
-		dstr_copy_dstr(escaped_path, path);
-		dstr_replace(escaped_path, "\"", "\"\""); //?
-
-		DStr cmd;
-		if (!build_command_line(stream, escaped_path, cmd)) {
-			warn("Failed to build command line");
-			thread_finished = true;
+		finish_output = !tracked_id;
 
-			SignalFailure();
-			return;
-		}
+		auto snapshot = store->Snapshot();
+		headers = snapshot->headers;
+		fragment_init = snapshot->fragment_init;
+		snapshot_serial = snapshot->serial;
+
+		/* the store may hold more than this output was asked to keep */
+		auto payload = snapshot->Segments();
+		if (!payload.empty())
+			initial_segments.assign(first_segment_starting_after(
+					payload, payload.back()->first_pts -
+					stream->buffer_length), end(payload));
+	}
 
-		pipe.reset(os_process_pipe_create(cmd->array, "w"));
-		if (!pipe) {
-			warn("Failed to create process pipe");
+	/* has to be called after construction, the writer jobs keep the
+	 * output alive until they are done */
+	void Start()
+	{
+		if (!gather_mux_params(stream, params)) {
+			warn("Failed to gather muxer parameters");
 			thread_finished = true;
 
 			SignalFailure();
 			return;
 		}
 
-		finish_output = !tracked_id;
-
-		initial_segments.assign(begin(stream->payload_data),
-			end(stream->payload_data));
-
-		output_thread = thread([=]()
-		{
-			OutputThread();
-		});
+		NotifyThread([]{});
 	}
 
-	~buffer_output()
+	void Cancel()
 	{
-		if (!output_thread.joinable())
-			return;
-
 		NotifyThread([&]
 		{
 			exit_thread = true;
 		});
-
-		if (output_thread.get_id() != this_thread::get_id())
-			output_thread.join();
-		else
-			output_thread.detach(); // FIXME: investigate when this is necessary
 	}
 
 	template <typename Fun>
@@ -277,8 +1638,20 @@ struct buffer_output {
 		{
 			LOCK(output_mutex);
 			fun();
+
+			if (scheduled) {
+				reschedule = true;
+				return;
+			}
+
+			scheduled = true;
 		}
-		output_update.notify_one();
+
+		auto self = shared_from_this();
+		stream->writers->Push([self]()
+		{
+			self->RunJob();
+		});
 	}
 
 	bool NewPacket(const encoder_packet &pkt, const packets_segment &seg)
@@ -287,11 +1660,13 @@ struct buffer_output {
 			return false;
 
 		if (tracked_id == pkt.tracked_id) {
+			LOCK(output_mutex);
 			tracked_frame_pts_valid = true;
 			tracked_frame_pts = static_cast<double>(pkt.pts) * pkt.timebase_num / pkt.timebase_den;
 		}
 
-		if (stop_frame_id_valid && stop_frame_id == pkt.tracked_id)
+		auto stop_id = stop_frame_id.load(memory_order_relaxed);
+		if (stop_id && stop_id == pkt.tracked_id)
 			stop_frame_id_found = true;
 
 		if (keep_recording && keep_recording_time <= 0 && !stop_frame_id_found)
@@ -303,7 +1678,7 @@ struct buffer_output {
 		if (wait_for_dts && end_dts > pkt.dts)
 			return true;
 		else if (!wait_for_dts) {
-			if (tracked_id != pkt.tracked_id && (!wait_for_end_time || pkt.pts < end_pts) && (!stop_frame_id_valid || !stop_frame_id_found))
+			if (tracked_id != pkt.tracked_id && (!wait_for_end_time || pkt.pts < end_pts) && (!stop_id || !stop_frame_id_found))
 				return true;
 			if (keep_recording && !wait_for_end_time) {
 				wait_for_end_time = true;
@@ -317,6 +1692,7 @@ struct buffer_output {
 			}
 		}
 
+		flush_fragments(stream);
 		final_segment = seg;
 
 		NotifyThread([&]
@@ -326,20 +1702,39 @@ struct buffer_output {
 		return false;
 	}
 
-	void AppendSegment(const shared_ptr<packets_segment> &seg)
+	void AppendSegment(const shared_ptr<const packets_segment> &seg)
 	{
 		if (finish_output)
 			return;
 
-		new_segments.push_back(seg);
+		if (!progressive) {
+			new_segments.push_back(seg);
+			return;
+		}
+
+		NotifyThread([&]
+		{
+			new_segments.push_back(seg);
+		});
 	}
 
 private:
 	using stream_id_t = std::pair<obs_encoder_type, decltype(encoder_packet::track_idx)>;
 	using first_stream_packet_t = std::map<stream_id_t, encoder_packet>;
 
-	packets_segment *first_output_segment = nullptr;
-	packets_segment *last_output_segment = nullptr;
+	const packets_segment *first_output_segment = nullptr;
+	const packets_segment *last_output_segment = nullptr;
+
+	first_stream_packet_t first_packets;
+	bool              write_all_segments = false;
+	bool              opened = false;
+
+	size_t            initial_done = 0;
+	size_t            new_done = 0;
+
+	bool              flush_supported = true;
+	const packets_segment *flushed_segment = nullptr;
+	uint64_t          flushed_bytes = 0;
 
 	void RebaseTimestamp(encoder_packet &pkt,
 			first_stream_packet_t *first_packets=nullptr)
@@ -364,20 +1759,34 @@ private:
 		pkt.pts -= idx->second.dts;
 	}
 
-	bool OutputPackets(packets_segment &seg,
+	bool OutputPackets(const packets_segment &seg,
 			first_stream_packet_t *first_packets=nullptr)
 	{
-		seg.Finalize();
-
 		if (!first_output_segment)
 			first_output_segment = &seg;
 
 		last_output_segment = &seg;
 
+		if (writer->WritesSegments()) {
+			if (!writer->WriteSegment(seg))
+				return false;
+
+			for (auto &pkt : seg.pkts)
+				if (pkt.type == OBS_ENCODER_VIDEO)
+					total_frames += 1;
+
+			return true;
+		}
+
 		for (auto pkt : seg.pkts) {
 			RebaseTimestamp(pkt, first_packets);
-				
-			if (!write_packet(stream, pipe.get(), &pkt))
+
+			if (pkt.tracked_id &&
+			    !video_frame_is_trace_sample(pkt.tracked_id))
+				blog(LOG_INFO, "writing tracked packet %lld (%lld)",
+						pkt.pts, pkt.tracked_id);
+
+			if (!writer->WritePacket(pkt))
 				return false;
 
 			if (pkt.type == OBS_ENCODER_VIDEO)
@@ -387,11 +1796,20 @@ private:
 		return true;
 	}
 
-	bool OutputSegments(const vector<shared_ptr<packets_segment>> &segments,
-			first_stream_packet_t *first_packets=nullptr)
+	/* writes the segments from index done on; until anything was written
+	 * limited outputs skip the segments ending before start_pts */
+	bool OutputSegmentsFrom(
+			const vector<shared_ptr<const packets_segment>> &segments,
+			size_t &done, double start_pts)
 	{
-		for (auto &seg : segments)
-			if (!OutputPackets(*seg, first_packets))
+		if (!write_all_segments && first_packets.empty()) {
+			size_t first = first_segment_ending_after(segments,
+					start_pts) - begin(segments);
+			done = max(done, first);
+		}
+
+		for (; done < segments.size(); done++)
+			if (!OutputPackets(*segments[done], &first_packets))
 				return false;
 
 		return true;
@@ -399,36 +1817,17 @@ private:
 
 	bool WriteLimitedOutput()
 	{
-		first_stream_packet_t first_packets;
-
 		auto last_pts = tracked_frame_pts_valid ?
 			tracked_frame_pts : final_segment.last_pts;
+		auto start_pts = last_pts - save_duration;
 
-		auto find_and_output = [&](vector<shared_ptr<packets_segment>> &seg)
-		{
-			auto it = begin(seg);
-			auto end_ = end(seg);
-			if (first_packets.empty()) {
-				for (; it != end_; it++) {
-					if ((last_pts - (*it)->last_pts) < save_duration)
-						break;
-				}
-			}
-
-			for (; it != end_; it++) {
-				if (!OutputPackets(**it, &first_packets))
-					return false;
-			}
-
-			return true;
-		};
-
-		if (!find_and_output(initial_segments)) {
+		if (!OutputSegmentsFrom(initial_segments, initial_done,
+					start_pts)) {
 			warn("Failed to write limited initial segments");
 			return false;
 		}
 
-		if (!find_and_output(new_segments)) {
+		if (!OutputSegmentsFrom(new_segments, new_done, start_pts)) {
 			warn("Failed to write limited new segments");
 			return false;
 		}
@@ -441,133 +1840,472 @@ private:
 		return true;
 	}
 
-	bool WriteOutput()
-	{
-		first_stream_packet_t first_packets;
+	bool WriteInitialOutput()
+	{
+		writer = create_writer(stream, path, params, *headers,
+				fragment_init, progressive);
+		if (!writer)
+			return false;
+
+		open_time_ns = os_gettime_ns();
+
+		write_all_segments = save_duration < .25;
+		if (write_all_segments && !OutputSegmentsFrom(initial_segments,
+					initial_done, 0.)) {
+			warn("Failed to write initial segments");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool WriteFinalOutput()
+	{
+		if (!write_all_segments)
+			return WriteLimitedOutput();
+
+		if (!OutputSegmentsFrom(new_segments, new_done, 0.)) {
+			warn("Failed to write new segments");
+			return false;
+		}
+
+		if (!OutputPackets(final_segment, &first_packets)) {
+			warn("Failed to write final segment");
+			return false;
+		}
+
+		return true;
+	}
+
+	/* writes the segments completed since the last call while the clip
+	 * is still being recorded */
+	bool WriteProgressiveOutput()
+	{
+		if (!flush_supported)
+			return true;
+
+		vector<shared_ptr<const packets_segment>> segments;
+		double start_pts;
+
+		{
+			LOCK(output_mutex);
+			if (!write_all_segments && !tracked_frame_pts_valid)
+				return true;
+
+			/* outputs writing all segments don't have a start */
+			start_pts = write_all_segments ? 0. :
+				tracked_frame_pts - save_duration;
+			segments.assign(begin(new_segments) + new_done,
+					end(new_segments));
+		}
+
+		if (!write_all_segments && !OutputSegmentsFrom(
+					initial_segments, initial_done,
+					start_pts)) {
+			warn("Failed to write progressive initial segments");
+			return false;
+		}
+
+		size_t done = 0;
+		bool success = OutputSegmentsFrom(segments, done, start_pts);
+		new_done += done;
+
+		if (!success) {
+			warn("Failed to write progressive segments");
+			return false;
+		}
+
+		FlushProgressiveOutput();
+		return true;
+	}
+
+	/* signals the byte and time range written since the last flush */
+	void FlushProgressiveOutput()
+	{
+		if (!flush_supported || last_output_segment == flushed_segment)
+			return;
+
+		uint64_t size = 0;
+		if (!writer->Flush(size)) {
+			warn("Can't flush '%s', writing it progressively "
+					"isn't supported", path->array);
+			flush_supported = false;
+			return;
+		}
+
+		double start_pts = flushed_segment ?
+			flushed_segment->last_pts :
+			first_output_segment->first_pts;
+
+		calldata_t data{};
+		calldata_init(&data);
+		calldata_set_ptr(&data, "output", stream->output);
+		calldata_set_string(&data, "filename", path);
+		calldata_set_ptr(&data, "buffer_id",
+				buffer_id_valid ? &buffer_id : nullptr);
+		calldata_set_int(&data, "tracked_frame_id", tracked_id);
+		calldata_set_int(&data, "byte_start", flushed_bytes);
+		calldata_set_int(&data, "byte_end", size);
+		calldata_set_float(&data, "start_pts", start_pts);
+		calldata_set_float(&data, "end_pts",
+				last_output_segment->last_pts);
+		signal_handler_signal(stream->signal,
+				"buffer_output_fragment", &data);
+		calldata_free(&data);
+
+		flushed_segment = last_output_segment;
+		flushed_bytes = size;
+	}
+
+	int64_t GetStartPTS()
+	{
+		if (first_output_segment)
+			return first_output_segment->keyframe_pts;
+
+		if (initial_segments.size())
+			return initial_segments.front()->keyframe_pts;
+		if (new_segments.size())
+			return new_segments.front()->keyframe_pts;
+		return final_segment.keyframe_pts;
+	}
+
+	double CalculateDuration()
+	{
+		if (first_output_segment && last_output_segment)
+			return last_output_segment->last_pts - first_output_segment->first_pts;
+
+		auto start = DBL_MAX;
+		auto end_ = 0.;
+
+		auto update = [&](double val)
+		{
+			start = min(start, val);
+			end_ = max(end_, val);
+		};
+
+		if (initial_segments.size())
+			update(initial_segments.front()->first_pts);
+		if (new_segments.size())
+			update(new_segments.back()->first_pts);
+		if (final_segment.pkts.size())
+			update(final_segment.last_pts);
+
+		return end_ - start;
+	}
+
+	void RunJob()
+	{
+		for (;;) {
+			if (!thread_finished)
+				Process();
+
+			LOCK(output_mutex);
+			if (!reschedule) {
+				scheduled = false;
+				return;
+			}
+
+			reschedule = false;
+		}
+	}
+
+	/* does whatever can be written right now; the initial segments are
+	 * written as soon as possible, the rest once the clip end is known */
+	void Process()
+	{
+		bool finish;
+		bool exit;
+
+		{
+			LOCK(output_mutex);
+			finish = finish_output;
+			exit = exit_thread;
+		}
+
+		if (!exit && !opened) {
+			opened = true;
+
+			if (!WriteInitialOutput()) {
+				FinishFailed();
+				return;
+			}
+		}
+
+		if (exit) {
+			FinishFailed();
+			return;
+		}
+
+		if (!finish) {
+			if (progressive && !WriteProgressiveOutput())
+				FinishFailed();
+			return;
+		}
+
+		if (!WriteFinalOutput()) {
+			FinishFailed();
+			return;
+		}
+
+		if (progressive)
+			FlushProgressiveOutput();
+
+		if (!writer->Close()) {
+			FinishFailed();
+			return;
+		}
+
+		writer.reset();
+
+		auto finish_time_ns = os_gettime_ns();
+		auto start_pts = GetStartPTS();
+		auto duration = CalculateDuration();
+
+		calldata_set_int(signal_data.get(), "frames", total_frames);
+		calldata_set_int(signal_data.get(), "start_pts", start_pts);
+		calldata_set_float(signal_data.get(), "duration", duration);
+
+		if (tracked_id)
+			calldata_set_int(signal_data.get(), "tracked_frame_id", tracked_id);
+
+		calldata_set_ptr(signal_data.get(), "buffer_id", buffer_id_valid ? &buffer_id : nullptr);
+
+		/* time spent opening the muxer and the total time from the
+		 * save request until the file was completely written */
+		calldata_set_float(signal_data.get(), "open_latency",
+				(open_time_ns - request_time_ns) / 1000000000.);
+		calldata_set_float(signal_data.get(), "save_latency",
+				(finish_time_ns - request_time_ns) / 1000000000.);
+
+		thread_finished = true;
+
+		signal_handler_signal(stream->signal,
+				"buffer_output_finished", signal_data.get());
+	}
+
+	void FinishFailed()
+	{
+		if (writer) {
+			writer->Close();
+			writer.reset();
+		}
+
+		if (opened)
+			os_unlink(path);
+
+		thread_finished = true;
+
+		SignalFailure();
+	}
+
+	void SignalFailure()
+	{
+		calldata_set_ptr(signal_data.get(), "buffer_id", buffer_id_valid ? &buffer_id : nullptr);
+		signal_handler_signal(stream->signal,
+				"buffer_output_failed", signal_data.get());
+	}
+};
+
+}
+
+static const char *ffmpeg_mux_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("FFmpegMuxer");
+}
+
+/* feeds the packets of a segment to an output the way the packet thread
+ * did when they arrived, returns false once the output is complete */
+static bool replay_segment(buffer_output &out, const packets_segment &seg)
+{
+	for (auto &pkt : seg.pkts) {
+		if (!out.NewPacket(pkt, seg))
+			return false;
+	}
+
+	return true;
+}
 
-		for (auto &pkt : headers.pkts) {
-			if (!write_packet(stream, pipe.get(), &pkt)) {
-				warn("Failed to write headers");
-				return false;
-			}
+/* takes over outputs requested since the last packet; the packets of the
+ * segments completed after the snapshot the output was created from (and
+ * of the current segment) are replayed in case the tracked frame arrived in
+ * between.  Has to be called with buffer_mutex held */
+static void adopt_outputs(packet_store &store)
+{
+	for (auto &out : store.new_outputs.Take()) {
+		if (out->finish_output) {
+			store.complete_outputs.emplace_back(move(out));
+			continue;
 		}
 
-		bool write_all_segments = save_duration < .25;
-		if (write_all_segments && !OutputSegments(initial_segments, &first_packets)) {
-			warn("Failed to write initial segments");
-			finish_output = false;
-			return false;
-		}
+		auto &payload = store.payload_data;
+		auto missed = min<uint64_t>(
+				store.pushed_segments - out->snapshot_serial,
+				payload.size());
 
-		{
-			unique_lock<decltype(output_mutex)> lock(output_mutex);
-			output_update.wait(lock, [&]
-			{
-				return exit_thread || finish_output;
-			});
+		bool done = false;
+		for (auto it = end(payload) - missed; it != end(payload); it++) {
+			if (!replay_segment(*out, **it)) {
+				done = true;
+				break;
+			}
 
-			if (exit_thread)
-				return false;
+			out->AppendSegment(*it);
 		}
 
-		if (!write_all_segments)
-			return WriteLimitedOutput();
-		
-		if (!OutputSegments(new_segments, &first_packets)) {
-			warn("Failed to write new segments");
-			return false;
-		}
+		if (!done && store.current_segment)
+			done = !replay_segment(*out, *store.current_segment);
+
+		if (done)
+			store.complete_outputs.emplace_back(move(out));
+		else
+			store.outputs.emplace_back(move(out));
+	}
+}
 
+/* cancels the outputs requested through stream (or all outputs of the
+ * store if stream is null) that are still waiting for packets; outputs
+ * that have all their packets finish writing their clips.  Has to be
+ * called with buffer_mutex held */
+static void cancel_outputs(packet_store &store, ffmpeg_muxer *stream)
+{
+	adopt_outputs(store);
 
-		if (!OutputPackets(final_segment, &first_packets)) {
-			warn("Failed to write final segment");
+	auto it = remove_if(begin(store.outputs), end(store.outputs),
+			[&](const shared_ptr<buffer_output> &out)
+	{
+		if (stream && out->stream != stream)
 			return false;
-		}
 
+		out->Cancel();
 		return true;
+	});
+	store.outputs.erase(it, end(store.outputs));
+}
+
+static bool other_muxer_active(ffmpeg_muxer *stream)
+{
+	for (auto muxer : stream->store->muxers) {
+		if (muxer != stream && muxer->active)
+			return true;
 	}
 
-	int64_t GetStartPTS()
-	{
-		if (first_output_segment)
-			return first_output_segment->keyframe_pts;
+	return false;
+}
 
-		if (initial_segments.size())
-			return initial_segments.front()->keyframe_pts;
-		if (new_segments.size())
-			return new_segments.front()->keyframe_pts;
-		return final_segment.keyframe_pts;
+/* another active output of the store continues feeding it with its next
+ * keyframe.  Pre-muxed fragments can't be continued by a new fragment
+ * muxer though, and without other active outputs the next feeder may
+ * start after the encoders were restarted, so the buffer is dropped in
+ * those cases */
+static void release_feeder(ffmpeg_muxer *stream)
+{
+	auto &store = *stream->store;
+	bool others_active = other_muxer_active(stream);
+
+	store.hand_over = others_active && !store.fragments;
+
+	if (store.fragments) {
+		cancel_outputs(store, nullptr);
+		stop_premux(stream);
+	} else if (!others_active && store.muxers.size() > 1) {
+		store.ClearSegments();
+		store.current_segment.reset();
 	}
 
-	double CalculateDuration()
-	{
-		if (first_output_segment && last_output_segment)
-			return last_output_segment->last_pts - first_output_segment->first_pts;
+	store.have_headers = false;
+	store.feeder = nullptr;
+}
 
-		auto start = DBL_MAX;
-		auto end_ = 0.;
+static void take_over_feeder(ffmpeg_muxer *stream)
+{
+	auto &store = *stream->store;
+	store.feeder = stream;
 
-		auto update = [&](double val)
-		{
-			start = min(start, val);
-			end_ = max(end_, val);
-		};
+	bool empty = store.payload_data.empty() &&
+		(!store.current_segment || store.current_segment->pkts.empty());
 
-		if (initial_segments.size())
-			update(initial_segments.front()->first_pts);
-		if (new_segments.size())
-			update(new_segments.back()->first_pts);
-		if (final_segment.pkts.size())
-			update(final_segment.last_pts);
+	store.feeder_changed = store.hand_over && !empty;
+	store.hand_over = false;
+	if (store.feeder_changed)
+		return;
 
-		return end_ - start;
-	}
+	store.video_offset = obs_output_get_packet_offset(stream->output,
+			OBS_ENCODER_VIDEO, 0);
+	store.last_video_dts = numeric_limits<int64_t>::min();
 
-	void OutputThread()
-	{
-		if (WriteOutput()) {
-			auto start_pts = GetStartPTS();
-			auto duration = CalculateDuration();
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		store.audio_offsets[i] = obs_output_get_packet_offset(
+				stream->output, OBS_ENCODER_AUDIO, i);
+		store.last_audio_dts[i] = numeric_limits<int64_t>::min();
+	}
+}
 
-			calldata_set_int(signal_data.get(), "frames", total_frames);
-			calldata_set_int(signal_data.get(), "start_pts", start_pts);
-			calldata_set_float(signal_data.get(), "duration", duration);
+/* moves a packet of the feeder onto the timeline of the store, returns
+ * false if the packet is already stored or has to be skipped */
+static bool rebase_packet(ffmpeg_muxer *stream, encoder_packet &pkt)
+{
+	auto &store = *stream->store;
+	bool video = pkt.type == OBS_ENCODER_VIDEO;
+	if (!video && pkt.track_idx >= MAX_AUDIO_MIXES)
+		return false;
 
-			if (tracked_id)
-				calldata_set_int(signal_data.get(), "tracked_frame_id", tracked_id);
+	int64_t offset = video ?
+		store.video_offset : store.audio_offsets[pkt.track_idx];
+	int64_t shift = obs_output_get_packet_offset(stream->output,
+			pkt.type, pkt.track_idx) - offset;
 
-			calldata_set_ptr(signal_data.get(), "buffer_id", buffer_id_valid ? &buffer_id : nullptr);
+	pkt.pts += shift;
+	pkt.dts += shift;
 
-			signal_handler_signal(stream->signal,
-					"buffer_output_finished", signal_data.get());
-		} else {
-			os_unlink(path);
+	auto &last_dts = video ?
+		store.last_video_dts : store.last_audio_dts[pkt.track_idx];
+	if (pkt.dts <= last_dts)
+		return false;
 
-			SignalFailure();
-		}
+	if (store.feeder_changed) {
+		if (!video || !pkt.keyframe)
+			return false;
 
-		thread_finished = true;
+		store.feeder_changed = false;
 	}
 
-	void SignalFailure()
-	{
-		calldata_set_ptr(signal_data.get(), "buffer_id", buffer_id_valid ? &buffer_id : nullptr);
-		signal_handler_signal(stream->signal,
-				"buffer_output_failed", signal_data.get());
-	}
-};
+	last_dts = pkt.dts;
+	return true;
+}
 
+static void attach_store(ffmpeg_muxer *stream, shared_ptr<packet_store> store)
+{
+	LOCK(store->buffer_mutex);
+	store->muxers.push_back(stream);
+	atomic_store(&stream->store, move(store));
 }
 
-static const char *ffmpeg_mux_getname(void *unused)
+static void detach_store(ffmpeg_muxer *stream)
 {
-	UNUSED_PARAMETER(unused);
-	return obs_module_text("FFmpegMuxer");
+	auto &store = *stream->store;
+
+	LOCK(store.buffer_mutex);
+	cancel_outputs(store, stream);
+	if (store.feeder == stream)
+		release_feeder(stream);
+
+	/* the writer pool of the stream finishes the remaining clips */
+	auto &complete = store.complete_outputs;
+	complete.erase(remove_if(begin(complete), end(complete),
+			[&](const shared_ptr<buffer_output> &out)
+	{
+		return out->stream == stream;
+	}), end(complete));
+
+	store.muxers.erase(find(begin(store.muxers), end(store.muxers),
+				stream));
 }
 
 static void ffmpeg_mux_destroy(void *data)
 {
 	auto stream = static_cast<ffmpeg_muxer*>(data);
+	detach_store(stream);
 	delete stream;
 }
 
@@ -577,9 +2315,10 @@ static void output_buffer_handler(void *data, calldata_t *calldata)
 	DStr filename;
 	dstr_copy(filename, calldata_string(calldata, "filename"));
 
-	LOCK(stream->buffer_mutex);
-	stream->complete_outputs.emplace_back(
-			new buffer_output{stream, filename});
+	auto out = make_shared<buffer_output>(stream, filename);
+	auto store = out->store;
+	out->Start();
+	store->new_outputs.Push(move(out));
 }
 
 static void output_precise_buffer_handler(void *data, calldata_t *calldata)
@@ -589,10 +2328,12 @@ static void output_precise_buffer_handler(void *data, calldata_t *calldata)
 	DStr filename;
 	dstr_copy(filename, calldata_string(calldata, "filename"));
 
-	LOCK(stream->buffer_mutex);
 	auto frame_id = obs_track_next_frame();
-	stream->outputs.emplace_back(
-			new buffer_output{stream, filename, frame_id, duration});
+	auto out = make_shared<buffer_output>(stream, filename, frame_id,
+			duration);
+	auto store = out->store;
+	out->Start();
+	store->new_outputs.Push(move(out));
 
 	calldata_set_int(calldata, "tracked_frame_id", frame_id);
 }
@@ -604,13 +2345,14 @@ static void output_precise_buffer_and_keep_recording_handler(
 	DStr filename;
 	dstr_copy(filename, calldata_string(calldata, "filename"));
 
-	LOCK(stream->buffer_mutex);
 	auto frame_id = obs_track_next_frame();
-	stream->outputs.emplace_back(
-			new buffer_output{stream, filename, frame_id});
-	auto &out = stream->outputs.back();
+	auto out = make_shared<buffer_output>(stream, filename, frame_id);
 	out->keep_recording = true;
 	out->keep_recording_time = calldata_float(calldata, "extra_recording_duration");
+	out->progressive = calldata_bool(calldata, "progressive");
+	auto store = out->store;
+	out->Start();
+	store->new_outputs.Push(move(out));
 
 	calldata_set_int(calldata, "tracked_frame_id", frame_id);
 }
@@ -621,19 +2363,37 @@ static void output_interruptible_future_buffer(void *data, calldata_t *calldata)
 	DStr filename;
 	dstr_copy(filename, calldata_string(calldata, "filename"));
 
-	LOCK(stream->buffer_mutex);
 	auto frame_id = obs_track_next_frame();
-	stream->outputs.emplace_back(
-		new buffer_output{ stream, filename, frame_id, .25 });
-	auto &out = stream->outputs.back();
+	auto out = make_shared<buffer_output>(stream, filename, frame_id, .25);
+	auto store_ref = out->store;
+	auto &store = *store_ref;
 	out->keep_recording = true;
 	out->keep_recording_time = calldata_float(calldata, "maximum_recording_duration");
+	out->progressive = calldata_bool(calldata, "progressive");
+
+	uint32_t buffer_id;
+	{
+		LOCK(store.interrupt_mutex);
+
+		/* forget about buffers that are done */
+		auto &buffers = store.interruptible_buffers;
+		for (auto it = begin(buffers); it != end(buffers);) {
+			if (it->second.expired())
+				it = buffers.erase(it);
+			else
+				it++;
+		}
+
+		buffer_id = store.next_interruptiple_buffer_id++;
+		buffers.emplace(buffer_id, out);
+	}
 
-	auto buffer_id = stream->next_interruptiple_buffer_id++;
-	stream->interruptible_buffers.emplace(buffer_id, out.get());
 	out->buffer_id = buffer_id;
 	out->buffer_id_valid = true;
 
+	out->Start();
+	store.new_outputs.Push(move(out));
+
 	calldata_set_int(calldata, "tracked_frame_id", frame_id);
 	calldata_set_int(calldata, "buffer_id", buffer_id);
 }
@@ -643,21 +2403,139 @@ static void interrupt_buffer(void *data, calldata_t *calldata)
 	auto stream = static_cast<ffmpeg_muxer*>(data);
 	auto buffer_id = static_cast<uint32_t>(calldata_int(calldata, "buffer_id"));
 
-	LOCK(stream->buffer_mutex);
-	auto it = stream->interruptible_buffers.find(buffer_id);
-	if (it == end(stream->interruptible_buffers)) {
+	auto store_ref = stream->Store();
+	auto &store = *store_ref;
+	LOCK(store.interrupt_mutex);
+
+	auto it = store.interruptible_buffers.find(buffer_id);
+	auto buffer = it != end(store.interruptible_buffers) ?
+		it->second.lock() : nullptr;
+	if (!buffer || buffer->stream != stream) {
 		warn("got invalid/unknown buffer_id: %d", buffer_id);
 		return;
 	}
 
-	auto &buffer = it->second;
 	auto frame_id = obs_track_next_frame();
 	buffer->stop_frame_id = frame_id;
-	buffer->stop_frame_id_valid = true;
 
 	calldata_set_int(calldata, "tracked_frame_id", frame_id);
 }
 
+static void create_disk_ring(ffmpeg_muxer *stream, packet_store &store,
+		obs_data_t *settings)
+{
+	auto dir = obs_data_get_string(settings, settings_disk_buffer_path_name);
+	auto size_mb = obs_data_get_int(settings, settings_disk_buffer_size_name);
+
+	if (!dir || !*dir || size_mb <= 0)
+		return;
+
+	DStr path;
+	dstr_printf(path, "%s/obs-recordingbuffer-%p.ring", dir,
+			static_cast<void*>(&store));
+
+	auto size = static_cast<size_t>(size_mb) * 1024 * 1024;
+	auto file = mapped_file_create(path, size);
+	if (!file) {
+		warn("Failed to create %lld MB disk buffer '%s', keeping "
+				"the buffer in memory", size_mb, path->array);
+		return;
+	}
+
+	store.ring = make_shared<disk_ring>(file);
+
+	info("Using %lld MB disk buffer '%s'", size_mb, path->array);
+}
+
+static shared_ptr<packet_store> create_store(ffmpeg_muxer *stream,
+		obs_data_t *settings)
+{
+	auto store = make_shared<packet_store>();
+
+	create_disk_ring(stream, *store, settings);
+
+	store->premux = obs_data_get_bool(settings,
+			settings_premux_segments_name);
+
+	auto budget_mb = obs_data_get_int(settings,
+			settings_memory_budget_name);
+	if (budget_mb > 0)
+		store->memory_budget = static_cast<uint64_t>(budget_mb) *
+			1024 * 1024;
+
+	return store;
+}
+
+static obs_data_t *segment_index_entry(const packets_segment &seg)
+{
+	obs_data_t *entry = obs_data_create();
+	obs_data_set_int(entry, "keyframe_pts", seg.keyframe_pts);
+	obs_data_set_double(entry, "first_pts", seg.first_pts);
+	obs_data_set_double(entry, "last_pts", seg.last_pts);
+	obs_data_set_int(entry, "byte_offset", seg.byte_offset);
+	obs_data_set_int(entry, "size", seg.bytes);
+
+	obs_data_array_t *ids = obs_data_array_create();
+	for (auto id : seg.tracked_ids) {
+		obs_data_t *item = obs_data_create();
+		obs_data_set_int(item, "id", id);
+		obs_data_array_push_back(ids, item);
+		obs_data_release(item);
+	}
+
+	obs_data_set_array(entry, "tracked_frame_ids", ids);
+	obs_data_array_release(ids);
+	return entry;
+}
+
+static void get_buffer_index(void *data, calldata_t *calldata)
+{
+	auto stream = static_cast<ffmpeg_muxer*>(data);
+	double start_pts = calldata_float(calldata, "start_pts");
+	double end_pts = calldata_float(calldata, "end_pts");
+
+	obs_data_t *index = obs_data_create();
+	obs_data_array_t *segments = obs_data_array_create();
+	int count = 0;
+
+	auto snapshot = stream->Store()->Snapshot();
+	auto payload = snapshot->Segments();
+	auto first = first_segment_ending_after(payload, start_pts);
+	auto last = first_segment_starting_after(payload, end_pts);
+
+	for (auto it = first; it < last; it++, count++) {
+		obs_data_t *entry = segment_index_entry(**it);
+		obs_data_array_push_back(segments, entry);
+		obs_data_release(entry);
+	}
+
+	obs_data_set_array(index, "segments", segments);
+	calldata_set_string(calldata, "index", obs_data_get_json(index));
+	calldata_set_int(calldata, "count", count);
+
+	obs_data_array_release(segments);
+	obs_data_release(index);
+}
+
+/* the segment pool is shared by all recording buffer outputs, so
+ * process_pooled_bytes is the same for every output */
+static void get_buffer_stats(void *data, calldata_t *calldata)
+{
+	auto stream = static_cast<ffmpeg_muxer*>(data);
+	auto store_ref = stream->Store();
+	auto &store = *store_ref;
+	auto snapshot = store.Snapshot();
+
+	calldata_set_int(calldata, "memory_bytes", snapshot->memory_bytes);
+	calldata_set_int(calldata, "process_pooled_bytes",
+			store.pool->PooledBytes());
+	calldata_set_int(calldata, "segment_count", snapshot->count);
+	calldata_set_float(calldata, "oldest_pts", snapshot->count ?
+			snapshot->first->segment->first_pts : 0.);
+	calldata_set_int(calldata, "evicted_segments", store.evicted_segments);
+	calldata_set_int(calldata, "evicted_bytes", store.evicted_bytes);
+}
+
 static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 {
 	auto stream = new ffmpeg_muxer;
@@ -669,6 +2547,29 @@ static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 		stream->buffer_length = 1.;
 	}
 
+	stream->in_process_muxing = obs_data_get_bool(settings,
+			settings_in_process_muxing_name);
+
+	auto writer_threads = obs_data_get_int(settings,
+			settings_writer_threads_name);
+	if (writer_threads < 1) {
+		warn("Supplied writer thread count (%lld) is less than 1, using 1 instead", writer_threads);
+		writer_threads = 1;
+	}
+
+	stream->writers.reset(new writer_pool{
+			static_cast<size_t>(writer_threads)});
+
+	/* a shared store is looked up once the encoders are known, see
+	 * attach_shared_store */
+	dstr_copy(stream->shared_store, obs_data_get_string(settings,
+				settings_shared_store_name));
+	attach_store(stream, dstr_is_empty(stream->shared_store) ?
+			create_store(stream, settings) :
+			make_shared<packet_store>());
+
+	av_register_all();
+
 	auto proc = obs_output_get_proc_handler(output);
 	proc_handler_add(proc, "void output_buffer(string filename)",
 			output_buffer_handler, stream);
@@ -677,41 +2578,46 @@ static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 			"out int tracked_frame_id)",
 			output_precise_buffer_handler, stream);
 	proc_handler_add(proc, "void output_precise_buffer_and_keep_recording(string filename, "
-			"out int tracked_frame_id, float extra_recording_duration)",
+			"out int tracked_frame_id, float extra_recording_duration, "
+			"bool progressive)",
 			output_precise_buffer_and_keep_recording_handler, stream);
 
 	proc_handler_add(proc, "void output_interruptible_future_buffer(string filename, "
-			"out int tracked_frame_id, float maximum_recording_duration, out int buffer_id)",
+			"out int tracked_frame_id, float maximum_recording_duration, out int buffer_id, "
+			"bool progressive)",
 			output_interruptible_future_buffer, stream);
 	proc_handler_add(proc, "void interrupt_buffer(int buffer_id, out int tracked_frame_id)",
 			interrupt_buffer, stream);
+	proc_handler_add(proc, "void get_buffer_index(float start_pts, float end_pts, "
+			"out string index, out int count)",
+			get_buffer_index, stream);
+	proc_handler_add(proc, "void get_buffer_stats(out int memory_bytes, "
+			"out int process_pooled_bytes, out int segment_count, "
+			"out float oldest_pts, out int evicted_segments, "
+			"out int evicted_bytes)",
+			get_buffer_stats, stream);
 
 	auto signal = obs_output_get_signal_handler(output);
 	signal_handler_add(signal,
 			"void buffer_output_finished(ptr output, string filename, "
-			"int frames, float duration, int start_pts, int tracked_frame_id, ptr buffer_id)");
+			"int frames, float duration, int start_pts, int tracked_frame_id, ptr buffer_id, "
+			"float open_latency, float save_latency)");
 	signal_handler_add(signal,
 			"void buffer_output_failed(ptr output, string filename, ptr buffer_id)");
+	signal_handler_add(signal,
+			"void buffer_output_fragment(ptr output, string filename, "
+			"ptr buffer_id, int tracked_frame_id, int byte_start, "
+			"int byte_end, float start_pts, float end_pts)");
 	stream->signal = signal;
 
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
 
-#ifdef _WIN32
-#ifdef _WIN64
-#define FFMPEG_MUX "ffmpeg-mux64.exe"
-#else
-#define FFMPEG_MUX "ffmpeg-mux32.exe"
-#endif
-#else
-#define FFMPEG_MUX "ffmpeg-mux"
-#endif
-
 /* TODO: allow codecs other than h264 whenever we start using them */
 
-static bool add_video_encoder_params(struct ffmpeg_muxer *stream,
-		struct dstr *cmd, obs_encoder_t *vencoder)
+static bool get_video_encoder_params(struct ffmpeg_muxer *stream,
+		mux_params &params, obs_encoder_t *vencoder)
 {
 	obs_data_t *settings = obs_encoder_get_settings(vencoder);
 	int bitrate = (int)obs_data_get_int(settings, "bitrate");
@@ -723,39 +2629,35 @@ static bool add_video_encoder_params(struct ffmpeg_muxer *stream,
 	if (!info)
 		return false;
 
-	dstr_catf(cmd, "%s %d %d %d %d %d ",
-			"h264",
-			bitrate,
-			obs_output_get_width(stream->output),
-			obs_output_get_height(stream->output),
-			(int)info->fps_num,
-			(int)info->fps_den);
+	params.has_video = true;
+	params.vbitrate  = bitrate;
+	params.width     = obs_output_get_width(stream->output);
+	params.height    = obs_output_get_height(stream->output);
+	params.fps_num   = (int)info->fps_num;
+	params.fps_den   = (int)info->fps_den;
 
 	return true;
 }
 
-static bool add_audio_encoder_params(struct dstr *cmd, obs_encoder_t *aencoder)
+static bool get_audio_encoder_params(mux_params &params,
+		obs_encoder_t *aencoder)
 {
 	obs_data_t *settings = obs_encoder_get_settings(aencoder);
 	int bitrate = (int)obs_data_get_int(settings, "bitrate");
 	audio_t *audio = obs_get_audio();
-	struct dstr name = {0};
 
 	obs_data_release(settings);
 
 	if (!audio)
 		return false;
 
-	dstr_copy(&name, obs_encoder_get_name(aencoder));
-	dstr_replace(&name, "\"", "\"\"");
-
-	dstr_catf(cmd, "\"%s\" %d %d %d ",
-			name.array,
-			bitrate,
-			(int)obs_encoder_get_sample_rate(aencoder),
-			(int)audio_output_get_channels(audio));
+	mux_audio_params track;
+	dstr_copy(track.name, obs_encoder_get_name(aencoder));
+	track.bitrate     = bitrate;
+	track.sample_rate = (int)obs_encoder_get_sample_rate(aencoder);
+	track.channels    = (int)audio_output_get_channels(audio);
 
-	dstr_free(&name);
+	params.audio.emplace_back(move(track));
 
 	return true;
 }
@@ -770,11 +2672,8 @@ static void log_muxer_params(struct ffmpeg_muxer *stream, const char *settings)
 
 	AVDictionary *dict = NULL;
 	if ((ret = av_dict_parse_string(&dict, settings, "=", " ", 0))) {
-		char str[AV_ERROR_MAX_STRING_SIZE];
 		warn("Failed to parse muxer settings: %s\n%s",
-				av_make_error_string(str,
-					AV_ERROR_MAX_STRING_SIZE, ret),
-				settings);
+				av_error{ret}.str, settings);
 
 		av_dict_free(&dict);
 		return;
@@ -795,63 +2694,115 @@ static void log_muxer_params(struct ffmpeg_muxer *stream, const char *settings)
 	av_dict_free(&dict);
 }
 
-static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
+static bool gather_mux_params(struct ffmpeg_muxer *stream, mux_params &params)
 {
-	obs_data_t *settings = obs_output_get_settings(stream->output);
-	struct dstr mux = {0};
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
 
-	dstr_copy(&mux, obs_data_get_string(settings, "muxer_settings"));
+	if (vencoder && !get_video_encoder_params(stream, params, vencoder))
+		return false;
+
+	for (size_t idx = 0;; idx++) {
+		obs_encoder_t *aencoder = obs_output_get_audio_encoder(
+				stream->output, idx);
+		if (!aencoder)
+			break;
 
-	log_muxer_params(stream, mux.array);
+		if (!get_audio_encoder_params(params, aencoder))
+			return false;
+	}
 
-	dstr_replace(&mux, "\"", "\\\"");
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	dstr_copy(params.muxer_settings,
+			obs_data_get_string(settings, "muxer_settings"));
 	obs_data_release(settings);
 
-	dstr_catf(cmd, "\"%s\" ", mux.array ? mux.array : "");
+	log_muxer_params(stream, params.muxer_settings);
 
-	dstr_free(&mux);
+	return true;
 }
 
-static bool build_command_line(struct ffmpeg_muxer *stream, const dstr *path,
-		struct dstr *cmd)
+static bool build_command_line(struct ffmpeg_muxer *stream,
+		const mux_params &params, const dstr *path, struct dstr *cmd)
 {
-	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
-	obs_encoder_t *aencoders[MAX_AUDIO_MIXES];
-	int num_tracks = 0;
-
-	for (;;) {
-		obs_encoder_t *aencoder = obs_output_get_audio_encoder(
-				stream->output, num_tracks);
-		if (!aencoder)
-			break;
-
-		aencoders[num_tracks] = aencoder;
-		num_tracks++;
-	}
+	UNUSED_PARAMETER(stream);
 
 	dstr_init_move_array(cmd, obs_module_file(FFMPEG_MUX));
 	dstr_insert_ch(cmd, 0, '\"');
 	dstr_cat(cmd, "\" \"");
 	dstr_cat_dstr(cmd, path);
-	dstr_catf(cmd, "\" %d %d ", vencoder ? 1 : 0, num_tracks);
-
-	if (vencoder && !add_video_encoder_params(stream, cmd, vencoder))
-		return false;
-
-	if (num_tracks) {
+	dstr_catf(cmd, "\" %d %d ", params.has_video ? 1 : 0,
+			(int)params.audio.size());
+
+	if (params.has_video)
+		dstr_catf(cmd, "%s %d %d %d %d %d ",
+				"h264",
+				params.vbitrate,
+				params.width,
+				params.height,
+				params.fps_num,
+				params.fps_den);
+
+	if (params.audio.size()) {
 		dstr_cat(cmd, "aac ");
 
-		for (int i = 0; i < num_tracks; i++) {
-			if (!add_audio_encoder_params(cmd, aencoders[i]))
-				return false;
+		for (auto &track : params.audio) {
+			DStr name;
+			dstr_copy(name, track.name);
+			dstr_replace(name, "\"", "\"\"");
+
+			dstr_catf(cmd, "\"%s\" %d %d %d ",
+					name->array,
+					track.bitrate,
+					track.sample_rate,
+					track.channels);
 		}
 	}
 
-	add_muxer_params(cmd, stream);
+	DStr mux;
+	dstr_copy(mux, params.muxer_settings);
+	dstr_replace(mux, "\"", "\\\"");
+
+	dstr_catf(cmd, "\"%s\" ", mux->array ? mux->array : "");
 
 	return true;
 }
 
+/* stores are shared between outputs with the same store name that use the
+ * same encoders; disk buffer and pre-muxing settings of the output that
+ * creates the store are used */
+static void attach_shared_store(ffmpeg_muxer *stream)
+{
+	if (dstr_is_empty(stream->shared_store))
+		return;
+
+	DStr key;
+	dstr_printf(key, "%s|%p", stream->shared_store->array,
+			static_cast<void*>(obs_output_get_video_encoder(
+					stream->output)));
+
+	obs_encoder_t *aencoder;
+	for (size_t idx = 0;
+	     (aencoder = obs_output_get_audio_encoder(stream->output, idx));
+	     idx++)
+		dstr_catf(key, "|%p", static_cast<void*>(aencoder));
+
+	auto store = packet_store::GetShared(key->array, [&]
+	{
+		obs_data_t *settings = obs_output_get_settings(stream->output);
+		auto store = create_store(stream, settings);
+		obs_data_release(settings);
+		return store;
+	});
+
+	if (store == stream->store)
+		return;
+
+	detach_store(stream);
+	attach_store(stream, move(store));
+
+	info("Using shared packet store '%s'", key->array);
+}
+
 static bool ffmpeg_mux_start(void *data)
 {
 	auto stream = static_cast<ffmpeg_muxer*>(data);
@@ -861,8 +2812,13 @@ static bool ffmpeg_mux_start(void *data)
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
 
+	attach_shared_store(stream);
+
 	/* write headers and start capture */
-	stream->active = true;
+	{
+		LOCK(stream->store->buffer_mutex);
+		stream->active = true;
+	}
 	stream->capturing = true;
 	obs_output_begin_data_capture(stream->output, 0);
 
@@ -874,10 +2830,14 @@ static int deactivate(struct ffmpeg_muxer *stream)
 	int ret = -1;
 
 	if (stream->active) {
-		stream->outputs.clear();
-		stream->complete_outputs.clear();
+		auto &store = *stream->store;
+		LOCK(store.buffer_mutex);
+
+		cancel_outputs(store, stream);
+		if (store.feeder == stream)
+			release_feeder(stream);
+
 		stream->active = false;
-		stream->have_headers = false;
 
 		info("stopped buffering");
 	}
@@ -897,20 +2857,6 @@ static void ffmpeg_mux_stop(void *data)
 	deactivate(stream);
 }
 
-static void signal_failure(struct ffmpeg_muxer *stream)
-{
-	int ret = deactivate(stream);
-	int code;
-
-	switch (ret) {
-	case FFM_UNSUPPORTED:          code = OBS_OUTPUT_UNSUPPORTED; break;
-	default:                       code = OBS_OUTPUT_ERROR;
-	}
-
-	obs_output_signal_stop(stream->output, code);
-	stream->capturing = false;
-}
-
 static bool write_packet(struct ffmpeg_muxer *stream, os_process_pipe_t *pipe,
 		struct encoder_packet *packet)
 {
@@ -925,29 +2871,35 @@ static bool write_packet(struct ffmpeg_muxer *stream, os_process_pipe_t *pipe,
 	info.type = is_video ? FFM_PACKET_VIDEO : FFM_PACKET_AUDIO;
 	info.keyframe = packet->keyframe;
 
-	if (packet->tracked_id)
-		blog(LOG_INFO, "writing tracked packet %lld (%lld)", packet->pts,
-				packet->tracked_id);
-
 	ret = os_process_pipe_write(pipe, (const uint8_t*)&info,
 			sizeof(info));
 	if (ret != sizeof(info)) {
 		warn("os_process_pipe_write for info structure failed");
-		signal_failure(stream);
 		return false;
 	}
 
 	ret = os_process_pipe_write(pipe, packet->data, packet->size);
 	if (ret != packet->size) {
 		warn("os_process_pipe_write for packet data failed");
-		signal_failure(stream);
 		return false;
 	}
 
 	return true;
 }
 
-static void gather_video_headers(struct ffmpeg_muxer *stream)
+static void add_header_packet(packets_segment &headers,
+		const encoder_packet &packet)
+{
+	/* extra data is owned by the encoder, so it has to be copied into a
+	 * refcounted packet before it can be stored with the other packets */
+	encoder_packet instance;
+	obs_encoder_packet_create_instance(&instance, &packet);
+	headers.AddPacket(instance);
+	obs_encoder_packet_release(&instance);
+}
+
+static void gather_video_headers(struct ffmpeg_muxer *stream,
+		packets_segment &headers)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
 
@@ -957,10 +2909,10 @@ static void gather_video_headers(struct ffmpeg_muxer *stream)
 
 	obs_encoder_get_extra_data(vencoder, &packet.data, &packet.size);
 
-	stream->encoder_headers.AddPacket(packet);
+	add_header_packet(headers, packet);
 }
 
-static void gather_audio_headers(struct ffmpeg_muxer *stream,
+static void gather_audio_headers(packets_segment &headers,
 		obs_encoder_t *aencoder, size_t idx)
 {
 	struct encoder_packet packet{};
@@ -970,7 +2922,7 @@ static void gather_audio_headers(struct ffmpeg_muxer *stream,
 
 	obs_encoder_get_extra_data(aencoder, &packet.data, &packet.size);
 
-	stream->encoder_headers.AddPacket(packet);
+	add_header_packet(headers, packet);
 }
 
 static void gather_headers(struct ffmpeg_muxer *stream)
@@ -978,140 +2930,237 @@ static void gather_headers(struct ffmpeg_muxer *stream)
 	obs_encoder_t *aencoder;
 	size_t idx = 0;
 
-	gather_video_headers(stream);
+	/* outputs that are still saving keep using the old headers */
+	auto headers = make_shared<packets_segment>();
+
+	gather_video_headers(stream, *headers);
 
 	do {
 		aencoder = obs_output_get_audio_encoder(stream->output, idx);
 		if (aencoder) {
-			gather_audio_headers(stream, aencoder, idx);
+			gather_audio_headers(*headers, aencoder, idx);
 			idx++;
 		}
 	} while (aencoder);
 
-	stream->encoder_headers.Finalize();
+	headers->Finalize();
+	stream->store->encoder_headers = move(headers);
 }
 
 /*static bool send_headers(ffmpeg_muxer *stream)
 {
-	stream->encoder_headers.Finalize();
-
-	for (auto &pkt : stream->encoder_headers.pkts)
+	for (auto &pkt : stream->store->encoder_headers->pkts)
 		if (!write_packet(stream, &pkt))
 			return false;
 
 	return true;
 }*/
 
-static double interval(const packets_segment &oldest, const packets_segment &youngest)
+static void prune_old_segments(ffmpeg_muxer *stream)
 {
-	return youngest.last_pts - oldest.first_pts;
+	auto &segments = stream->store->payload_data;
+	if (segments.empty())
+		return;
+
+	/* drop every segment that starts more than buffer_length before
+	 * the segment that was just completed, using the longest
+	 * buffer_length of all outputs attached to the store */
+	auto oldest_kept = first_segment_starting_after(segments,
+			stream->store->current_segment->first_pts -
+			stream->store->BufferLength());
+
+	stream->store->EraseSegments(oldest_kept);
 }
 
-static void prune_old_segments(ffmpeg_muxer *stream)
+static void evict_segments(ffmpeg_muxer *stream)
 {
-	if (stream->payload_data.empty())
+	auto &store = *stream->store;
+	if (!store.memory_budget)
 		return;
 
-	if (interval(*stream->payload_data.front(), *stream->current_segment)
-			- stream->current_segment->Length() < stream->buffer_length)
+	if (store.memory_bytes <= store.memory_budget) {
+		store.evicting = false;
 		return;
+	}
+
+	if (!store.evicting)
+		warn("Buffer exceeds its memory budget of %llu bytes, "
+				"dropping oldest segments",
+				(unsigned long long)store.memory_budget);
+	store.evicting = true;
+
+	/* always keep the newest segment, otherwise there would be nothing
+	 * left to save */
+	auto &segments = store.payload_data;
+	auto last = begin(segments);
+	uint64_t bytes = store.memory_bytes;
+	while (bytes > store.memory_budget && last + 1 < end(segments)) {
+		auto seg_bytes = (*last)->MemoryBytes();
+		bytes -= seg_bytes;
+		store.evicted_segments += 1;
+		store.evicted_bytes += seg_bytes;
+		last++;
+	}
 
-	stream->payload_data.pop_front();
+	store.EraseSegments(last);
 }
 
-template <typename T, typename D, typename ... Ts>
-static shared_ptr<T> make_shared_deleter(D &&d, Ts &&... ts)
+static shared_ptr<packets_segment> create_segment(ffmpeg_muxer *stream)
 {
-	return {new T{forward<Ts>(ts)...}, forward<D>(d)};
+	auto seg = stream->store->pool->Create();
+	seg->byte_offset = stream->store->total_bytes;
+	return seg;
 }
 
-static void push_buffer(ffmpeg_muxer *stream, packets_segment::data_t &&data)
+static void start_premux(ffmpeg_muxer *stream)
 {
-	if (!data.capacity())
+	mux_params params;
+	if (!gather_mux_params(stream, params)) {
+		warn("Failed to gather muxer parameters, not pre-muxing "
+				"segments");
+		return;
+	}
+
+	auto init = make_shared<vector<uint8_t>>();
+	stream->store->fragments.reset(new fragment_muxer{stream});
+	if (!stream->store->fragments->Open(params, *stream->store->encoder_headers, *init)) {
+		warn("Failed to create segment muxer, not pre-muxing "
+				"segments");
+		stream->store->fragments.reset();
 		return;
+	}
+
+	stream->store->fragment_init = init;
+}
 
-	data.clear();
+static void stop_premux(ffmpeg_muxer *stream)
+{
+	if (!stream->store->fragments)
+		return;
 
-	LOCK(stream->buffers_mutex);
-	stream->buffers.emplace_back(move(data));
+	/* segments without packet data can't be written by anything but
+	 * the fragment writer of this session */
+	stream->store->fragments.reset();
+	stream->store->fragment_init.reset();
+	stream->store->ClearSegments();
+	stream->store->current_segment = create_segment(stream);
 }
 
-static packets_segment::data_t pop_buffer(ffmpeg_muxer *stream)
+static void flush_fragments(ffmpeg_muxer *stream)
 {
-	LOCK(stream->buffers_mutex);
-	if (stream->buffers.empty())
-		return {};
+	if (!stream->store->fragments || !stream->store->current_segment)
+		return;
 
-	auto buffer = move(stream->buffers.back());
-	stream->buffers.pop_back();
+	if (!stream->store->fragments->Flush(*stream->store->current_segment)) {
+		warn("Failed to flush pre-muxed fragment, dropping buffer");
+		stop_premux(stream);
+	}
+}
+
+static void premux_packet(ffmpeg_muxer *stream, encoder_packet &packet)
+{
+	if (!stream->store->fragments)
+		return;
 
-	return buffer;
+	if (!stream->store->fragments->WritePacket(packet)) {
+		warn("Failed to pre-mux packet, dropping buffer");
+		stop_premux(stream);
+	}
 }
 
-static shared_ptr<packets_segment> create_segment(ffmpeg_muxer *stream)
+static void move_to_disk(ffmpeg_muxer *stream, packets_segment &seg)
 {
-	auto seg = make_shared_deleter<packets_segment>([&, stream](packets_segment *seg)
-	{
-		push_buffer(stream, move(seg->data));
-		delete seg;
-	});
+	if (seg.MoveTo(*stream->store->ring)) {
+		stream->store->ring_full = false;
+		return;
+	}
 
-	seg->data = pop_buffer(stream);
+	if (!stream->store->ring_full)
+		warn("Disk buffer is full, keeping segments in memory until "
+				"space becomes available");
 
-	return seg;
+	stream->store->ring_full = true;
 }
 
 static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 {
 	auto stream = static_cast<ffmpeg_muxer*>(data);
 
+	LOCK(stream->store->buffer_mutex);
+
 	if (!stream->active)
 		return;
 
-	LOCK(stream->buffer_mutex);
+	/* packet timestamps include per output offsets, so only one of the
+	 * outputs attached to a store can add packets to it */
+	if (!stream->store->feeder)
+		take_over_feeder(stream);
+	else if (stream->store->feeder != stream)
+		return;
+
+	encoder_packet pkt = *packet;
+	if (!rebase_packet(stream, pkt))
+		return;
+
+	packet = &pkt;
 
-	if (!stream->have_headers) {
+	if (!stream->store->have_headers) {
 		gather_headers(stream);
 
-		stream->have_headers = true;
+		if (stream->store->premux)
+			start_premux(stream);
+
+		stream->store->have_headers = true;
+		stream->store->Publish();
 	}
 
-	if (!stream->current_segment)
-		stream->current_segment = create_segment(stream);
+	if (!stream->store->current_segment)
+		stream->store->current_segment = create_segment(stream);
+
+	adopt_outputs(*stream->store);
 
 	if (packet->keyframe) {
 		prune_old_segments(stream);
+		flush_fragments(stream);
+
+		/* outputs and snapshots only ever see finalized segments,
+		 * so the writer threads never modify them */
+		auto &seg = *stream->store->current_segment;
+		seg.Finalize();
+
+		if (stream->store->ring && !seg.pkts.empty())
+			move_to_disk(stream, seg);
 
-		for (auto &output : stream->outputs)
-			output->AppendSegment(stream->current_segment);
+		for (auto &output : stream->store->outputs)
+			output->AppendSegment(stream->store->current_segment);
 
-		if (!stream->current_segment->pkts.empty())
-			stream->payload_data.emplace_back(move(stream->current_segment));
+		if (!stream->store->current_segment->pkts.empty())
+			stream->store->PushSegment(move(stream->store->current_segment));
 
-		stream->current_segment = create_segment(stream);
+		evict_segments(stream);
+		stream->store->Publish();
+		stream->store->pool->Trim();
+
+		stream->store->current_segment = create_segment(stream);
 	}
 
-	stream->current_segment->AddPacket(*packet);
+	stream->store->current_segment->AddPacket(*packet, !stream->store->fragments);
+	stream->store->total_bytes += packet->size;
+	premux_packet(stream, *packet);
 
-	for (size_t i = 0; i < stream->outputs.size();) {
-		auto &output = stream->outputs[i];
-		if (!output->NewPacket(*packet, *stream->current_segment)) {
-			stream->complete_outputs.emplace_back(move(output));
-			stream->outputs.erase(begin(stream->outputs) + i);
+	for (size_t i = 0; i < stream->store->outputs.size();) {
+		auto &output = stream->store->outputs[i];
+		if (!output->NewPacket(*packet, *stream->store->current_segment)) {
+			stream->store->complete_outputs.emplace_back(move(output));
+			stream->store->outputs.erase(begin(stream->store->outputs) + i);
 		} else
 			i += 1;
 	}
 
-	for (size_t i = 0; i < stream->complete_outputs.size();) {
-		if (stream->complete_outputs[i]->thread_finished) {
-			auto &out = stream->complete_outputs[i];
-			if (out->buffer_id_valid) {
-				auto it = stream->interruptible_buffers.find(out->buffer_id);
-				if (it != end(stream->interruptible_buffers))
-					stream->interruptible_buffers.erase(it);
-			}
-			stream->complete_outputs.erase(
-					begin(stream->complete_outputs) + i);
+	for (size_t i = 0; i < stream->store->complete_outputs.size();) {
+		if (stream->store->complete_outputs[i]->thread_finished) {
+			stream->store->complete_outputs.erase(
+					begin(stream->store->complete_outputs) + i);
 		} else
 			i += 1;
 	}
@@ -1132,6 +3181,13 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 static void ffmpeg_mux_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_double(settings, settings_buffer_length_name, 60.);
+	obs_data_set_default_bool(settings, settings_in_process_muxing_name,
+			true);
+	obs_data_set_default_int(settings, settings_writer_threads_name, 2);
+	obs_data_set_default_bool(settings, settings_premux_segments_name,
+			false);
+	obs_data_set_default_string(settings, settings_shared_store_name, "");
+	obs_data_set_default_int(settings, settings_memory_budget_name, 0);
 }
 
 extern "C" void register_recordingbuffer(void)
@@ -463,6 +463,9 @@ static int send_packet(struct rtmp_stream *stream,
 	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size, (int)idx);
 	bfree(data);
 
+	if (ret >= 0)
+		obs_frame_trace_mark(packet->tracked_id, OBS_FRAME_TRACE_SEND);
+
 	obs_free_encoder_packet(packet);
 
 	stream->total_bytes_sent += size;
@@ -205,14 +205,21 @@ static void draw_texture(struct dc_capture *capture, int id,
 	gs_technique_end(tech);
 }
 
-void dc_capture_render(struct dc_capture *capture, gs_effect_t *effect)
+static inline int get_last_tex(const struct dc_capture *capture)
 {
-	int last_tex = (capture->cur_tex > 0) ?
+	return (capture->cur_tex > 0) ?
 		capture->cur_tex-1 : capture->num_textures-1;
+}
 
-	if (!capture->valid)
-		return;
+void dc_capture_render(struct dc_capture *capture, gs_effect_t *effect)
+{
+	if (dc_capture_ready(capture))
+		draw_texture(capture, get_last_tex(capture), effect);
+}
 
-	if (capture->textures_written[last_tex])
-		draw_texture(capture, last_tex, effect);
+/* whether dc_capture_render currently draws anything */
+bool dc_capture_ready(const struct dc_capture *capture)
+{
+	return capture->valid &&
+		capture->textures_written[get_last_tex(capture)];
 }
@@ -36,3 +36,4 @@ extern void dc_capture_free(struct dc_capture *capture);
 
 extern void dc_capture_capture(struct dc_capture *capture, HWND window);
 extern void dc_capture_render(struct dc_capture *capture, gs_effect_t *effect);
+extern bool dc_capture_ready(const struct dc_capture *capture);
@@ -162,6 +162,13 @@ static void duplicator_capture_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
+static bool duplicator_capture_is_opaque(void *data)
+{
+	struct duplicator_capture *capture = data;
+	return capture->duplicator &&
+		gs_duplicator_get_texture(capture->duplicator) != NULL;
+}
+
 static uint32_t duplicator_capture_width(void *data)
 {
 	struct duplicator_capture *capture = data;
@@ -283,7 +290,8 @@ static obs_properties_t *duplicator_capture_properties(void *unused)
 struct obs_source_info duplicator_capture_info = {
 	.id             = "monitor_capture",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.get_name       = duplicator_capture_getname,
 	.create         = duplicator_capture_create,
 	.destroy        = duplicator_capture_destroy,
@@ -293,5 +301,6 @@ struct obs_source_info duplicator_capture_info = {
 	.get_width      = duplicator_capture_width,
 	.get_height     = duplicator_capture_height,
 	.get_defaults   = duplicator_capture_defaults,
-	.get_properties = duplicator_capture_properties
+	.get_properties = duplicator_capture_properties,
+	.is_opaque      = duplicator_capture_is_opaque
 };
@@ -1897,6 +1897,13 @@ static void game_capture_render(void *data, gs_effect_t *effect)
 	}
 }
 
+/* the cursor is drawn within the game's area */
+static bool game_capture_is_opaque(void *data)
+{
+	struct game_capture *gc = data;
+	return gc->active && gc->texture && !gc->config.allow_transparency;
+}
+
 static uint32_t game_capture_width(void *data)
 {
 	struct game_capture *gc = data;
@@ -2142,7 +2149,8 @@ static obs_properties_t *game_capture_properties(void *data)
 struct obs_source_info game_capture_info = {
 	.id = "game_capture",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                OBS_SOURCE_OPAQUE,
 	.get_name = game_capture_name,
 	.create = game_capture_create,
 	.destroy = game_capture_destroy,
@@ -2152,5 +2160,6 @@ struct obs_source_info game_capture_info = {
 	.get_properties = game_capture_properties,
 	.update = game_capture_update,
 	.video_tick = game_capture_tick,
-	.video_render = game_capture_render
+	.video_render = game_capture_render,
+	.is_opaque = game_capture_is_opaque
 };
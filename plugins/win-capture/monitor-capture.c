@@ -153,6 +153,12 @@ static void monitor_capture_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static bool monitor_capture_is_opaque(void *data)
+{
+	struct monitor_capture *capture = data;
+	return dc_capture_ready(&capture->data);
+}
+
 static uint32_t monitor_capture_width(void *data)
 {
 	struct monitor_capture *capture = data;
@@ -232,7 +238,8 @@ static obs_properties_t *monitor_capture_properties(void *unused)
 struct obs_source_info monitor_capture_info = {
 	.id             = "monitor_capture",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.get_name       = monitor_capture_getname,
 	.create         = monitor_capture_create,
 	.destroy        = monitor_capture_destroy,
@@ -242,5 +249,6 @@ struct obs_source_info monitor_capture_info = {
 	.get_width      = monitor_capture_width,
 	.get_height     = monitor_capture_height,
 	.get_defaults   = monitor_capture_defaults,
-	.get_properties = monitor_capture_properties
+	.get_properties = monitor_capture_properties,
+	.is_opaque      = monitor_capture_is_opaque
 };
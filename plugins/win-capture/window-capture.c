@@ -103,6 +103,12 @@ static void wc_update(void *data, obs_data_t *settings)
 	wc->window = NULL;
 }
 
+static bool wc_is_opaque(void *data)
+{
+	struct window_capture *wc = data;
+	return dc_capture_ready(&wc->capture);
+}
+
 static uint32_t wc_width(void *data)
 {
 	struct window_capture *wc = data;
@@ -228,7 +234,8 @@ static void wc_render(void *data, gs_effect_t *effect)
 struct obs_source_info window_capture_info = {
 	.id             = "window_capture",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.get_name       = wc_getname,
 	.create         = wc_create,
 	.destroy        = wc_destroy,
@@ -238,5 +245,6 @@ struct obs_source_info window_capture_info = {
 	.get_width      = wc_width,
 	.get_height     = wc_height,
 	.get_defaults   = wc_defaults,
-	.get_properties = wc_properties
+	.get_properties = wc_properties,
+	.is_opaque      = wc_is_opaque
 };
@@ -0,0 +1,309 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Runs every format conversion kernel at several resolutions with each
+ * instruction set the CPU supports, checks that the output of the wider
+ * implementations matches the SSE2/scalar output byte for byte, and reports
+ * the time per frame of each implementation.
+ *
+ * usage: format-conversion-test [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+#define GET_ALIGN(val, align) \
+	(((val) + (align-1)) & ~(align-1))
+
+struct resolution {
+	uint32_t cx;
+	uint32_t cy;
+};
+
+/* 1356 and 1364 are not multiples of the AVX2 width, to cover the tails */
+static const struct resolution resolutions[] = {
+	{1280, 720},
+	{1356, 762},
+	{1364, 768},
+	{1920, 1080},
+	{2560, 1440},
+	{3840, 2160},
+};
+
+#define NUM_RESOLUTIONS (sizeof(resolutions) / sizeof(resolutions[0]))
+
+enum kernel {
+	KERNEL_UYVX_TO_I420,
+	KERNEL_UYVX_TO_NV12,
+	KERNEL_UYVX_TO_I444,
+	KERNEL_DECOMPRESS_420,
+	KERNEL_DECOMPRESS_NV12,
+	KERNEL_DECOMPRESS_422_Y,
+	KERNEL_DECOMPRESS_422_U,
+	KERNEL_COUNT
+};
+
+static const char *kernel_names[KERNEL_COUNT] = {
+	"compress_uyvx_to_i420",
+	"compress_uyvx_to_nv12",
+	"convert_uyvx_to_i444",
+	"decompress_420",
+	"decompress_nv12",
+	"decompress_422 (Y)",
+	"decompress_422 (U)",
+};
+
+static const char *simd_names[] = {"SSE2", "AVX2"};
+
+/* planes are allocated with slack, some of the decompression kernels read
+ * and write up to a full line past the end of the planes */
+struct frame_buffers {
+	uint8_t  *input[3];
+	uint32_t in_linesize[3];
+	size_t   in_size[3];
+
+	uint8_t  *output[3];
+	uint32_t out_linesize[3];
+	size_t   out_size[3];
+};
+
+static uint8_t *alloc_plane(size_t size, bool randomize)
+{
+	uint8_t *plane = bzalloc(size);
+	if (randomize) {
+		for (size_t i = 0; i < size; i++)
+			plane[i] = (uint8_t)rand();
+	}
+	return plane;
+}
+
+static void init_buffers(struct frame_buffers *buf, enum kernel kernel,
+		uint32_t cx, uint32_t cy)
+{
+	memset(buf, 0, sizeof(*buf));
+
+	switch (kernel) {
+	case KERNEL_UYVX_TO_I420:
+	case KERNEL_UYVX_TO_NV12:
+	case KERNEL_UYVX_TO_I444:
+		buf->in_linesize[0] = GET_ALIGN(cx * 4, 32);
+		buf->in_size[0] = buf->in_linesize[0] * cy;
+
+		for (size_t i = 0; i < 3; i++) {
+			bool full = kernel == KERNEL_UYVX_TO_I444 || i == 0;
+			if (kernel == KERNEL_UYVX_TO_NV12 && i == 2)
+				break;
+
+			buf->out_linesize[i] = kernel == KERNEL_UYVX_TO_NV12 ||
+				full ? cx : cx / 2;
+			buf->out_size[i] = buf->out_linesize[i] *
+				(full ? cy : cy / 2);
+		}
+		break;
+
+	case KERNEL_DECOMPRESS_420:
+	case KERNEL_DECOMPRESS_NV12:
+		buf->in_linesize[0] = cx;
+		buf->in_linesize[1] = kernel == KERNEL_DECOMPRESS_NV12 ?
+			cx : cx / 2;
+		buf->in_linesize[2] = kernel == KERNEL_DECOMPRESS_NV12 ?
+			0 : cx / 2;
+		for (size_t i = 0; i < 3; i++)
+			buf->in_size[i] = buf->in_linesize[i] * (i ? cy / 2 : cy);
+
+		buf->out_linesize[0] = cx * 4;
+		buf->out_size[0] = buf->out_linesize[0] * cy;
+		break;
+
+	case KERNEL_DECOMPRESS_422_Y:
+	case KERNEL_DECOMPRESS_422_U:
+		buf->in_linesize[0] = cx * 2;
+		buf->in_size[0] = buf->in_linesize[0] * (cy + 1);
+
+		/* every input dword becomes two output dwords */
+		buf->out_linesize[0] = cx * 8;
+		buf->out_size[0] = buf->out_linesize[0] * cy;
+		break;
+
+	case KERNEL_COUNT:
+		break;
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		if (buf->in_size[i])
+			buf->input[i] = alloc_plane(buf->in_size[i] + 64, true);
+		if (buf->out_size[i])
+			buf->output[i] = alloc_plane(buf->out_size[i] + 64,
+					false);
+	}
+}
+
+static void free_buffers(struct frame_buffers *buf)
+{
+	for (size_t i = 0; i < 3; i++) {
+		bfree(buf->input[i]);
+		bfree(buf->output[i]);
+	}
+}
+
+static void run_kernel(struct frame_buffers *buf, enum kernel kernel,
+		uint32_t cy)
+{
+	switch (kernel) {
+	case KERNEL_UYVX_TO_I420:
+		compress_uyvx_to_i420(buf->input[0], buf->in_linesize[0],
+				0, cy, buf->output, buf->out_linesize);
+		break;
+	case KERNEL_UYVX_TO_NV12:
+		compress_uyvx_to_nv12(buf->input[0], buf->in_linesize[0],
+				0, cy, buf->output, buf->out_linesize);
+		break;
+	case KERNEL_UYVX_TO_I444:
+		convert_uyvx_to_i444(buf->input[0], buf->in_linesize[0],
+				0, cy, buf->output, buf->out_linesize);
+		break;
+	case KERNEL_DECOMPRESS_420:
+		decompress_420((const uint8_t *const *)buf->input,
+				buf->in_linesize, 0, cy,
+				buf->output[0], buf->out_linesize[0]);
+		break;
+	case KERNEL_DECOMPRESS_NV12:
+		decompress_nv12((const uint8_t *const *)buf->input,
+				buf->in_linesize, 0, cy,
+				buf->output[0], buf->out_linesize[0]);
+		break;
+	case KERNEL_DECOMPRESS_422_Y:
+	case KERNEL_DECOMPRESS_422_U:
+		decompress_422(buf->input[0], buf->in_linesize[0], 0, cy,
+				buf->output[0], buf->out_linesize[0],
+				kernel == KERNEL_DECOMPRESS_422_Y);
+		break;
+	case KERNEL_COUNT:
+		break;
+	}
+}
+
+static uint8_t *copy_output(struct frame_buffers *buf, size_t *size)
+{
+	uint8_t *copy, *ptr;
+
+	*size = 0;
+	for (size_t i = 0; i < 3; i++)
+		*size += buf->out_size[i] + 64;
+
+	copy = ptr = bmalloc(*size);
+	for (size_t i = 0; i < 3; i++) {
+		if (!buf->output[i])
+			continue;
+		memcpy(ptr, buf->output[i], buf->out_size[i] + 64);
+		memset(buf->output[i], 0, buf->out_size[i] + 64);
+		ptr += buf->out_size[i] + 64;
+	}
+
+	*size = ptr - copy;
+	return copy;
+}
+
+static double time_kernel(struct frame_buffers *buf, enum kernel kernel,
+		uint32_t cy, int iterations)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < iterations; i++)
+		run_kernel(buf, kernel, cy);
+
+	return (double)(os_gettime_ns() - start) / iterations / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	enum conversion_simd supported;
+	int iterations = argc > 1 ? atoi(argv[1]) : 100;
+	int failures = 0;
+
+	if (iterations <= 0)
+		iterations = 100;
+
+	supported = format_conversion_set_max_simd(CONVERSION_SIMD_AVX2);
+	printf("widest supported instruction set: %s\n",
+			simd_names[supported]);
+	printf("%-24s %-11s", "kernel", "resolution");
+	for (int simd = 0; simd <= (int)supported; simd++)
+		printf(" %9s ms", simd_names[simd]);
+	printf("  result\n");
+
+	for (int k = 0; k < KERNEL_COUNT; k++) {
+		for (size_t r = 0; r < NUM_RESOLUTIONS; r++) {
+			uint32_t cx = resolutions[r].cx;
+			uint32_t cy = resolutions[r].cy;
+			struct frame_buffers buf;
+			uint8_t *reference = NULL;
+			size_t reference_size = 0;
+			bool match = true;
+			char res_str[32];
+
+			init_buffers(&buf, (enum kernel)k, cx, cy);
+
+			snprintf(res_str, sizeof(res_str), "%ux%u", cx, cy);
+			printf("%-24s %-11s", kernel_names[k], res_str);
+
+			for (int simd = 0; simd <= (int)supported; simd++) {
+				uint8_t *result;
+				size_t size;
+				double ms;
+
+				format_conversion_set_max_simd(
+						(enum conversion_simd)simd);
+
+				run_kernel(&buf, (enum kernel)k, cy);
+				result = copy_output(&buf, &size);
+				ms = time_kernel(&buf, (enum kernel)k, cy,
+						iterations);
+
+				if (!reference) {
+					reference = result;
+					reference_size = size;
+				} else {
+					if (size != reference_size ||
+					    memcmp(result, reference, size))
+						match = false;
+					bfree(result);
+				}
+
+				printf(" %12.3f", ms);
+				fflush(stdout);
+			}
+
+			printf("  %s\n", match ? "ok" : "MISMATCH");
+			if (!match)
+				failures++;
+
+			bfree(reference);
+			free_buffers(&buf);
+		}
+	}
+
+	format_conversion_set_max_simd(CONVERSION_SIMD_AVX2);
+
+	if (failures)
+		printf("%d kernel/resolution combinations did not match\n",
+				failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,803 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Feeds synthetic encoder packets into the recording buffer output and
+ * fires overlapping saves at it, then reports the per packet ingest cost,
+ * save latencies and the peak RSS of the process.
+ *
+ * The output's callbacks are static, so the output source is compiled into
+ * this program directly; the output itself is hosted by a dummy encoded
+ * output that owns the encoders, proc handler and signal handler. */
+
+#include "obs-ffmpeg-recordingbuffer.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern "C" const char *obs_module_text(const char *lookup_string)
+{
+	return lookup_string;
+}
+
+/* the output isn't loaded from a module, so there's no ffmpeg-mux to find
+ * and clips are always muxed in process */
+extern "C" obs_module_t *obs_current_module(void)
+{
+	return nullptr;
+}
+
+namespace {
+
+struct bench_options {
+	int         video_bitrate = 6000;
+	int         audio_bitrate = 160;
+	int         audio_tracks = 1;
+	int         fps = 60;
+	int         width = 1280;
+	int         height = 720;
+	double      gop = 2.;
+	double      duration = 300.;
+	bool        realtime = false;
+
+	double      buffer_length = 60.;
+	int         writer_threads = 2;
+	const char  *disk_buffer_path = "";
+	int         disk_buffer_size = 0;
+	bool        premux = false;
+	int         memory_budget = 0;
+
+	double      precise_interval = 20.;
+	double      precise_duration = 30.;
+	double      keep_interval = 45.;
+	double      keep_duration = 10.;
+	double      interruptible_interval = 60.;
+	double      interrupt_after = 15.;
+	bool        progressive = false;
+
+	const char  *output_dir = ".";
+	const char  *extension = "mp4";
+	bool        keep_files = false;
+#ifdef _WIN32
+	const char  *graphics_module = DL_D3D11;
+#else
+	const char  *graphics_module = DL_OPENGL;
+#endif
+};
+
+struct save_stats {
+	int              requested = 0;
+	int              finished = 0;
+	int              failed = 0;
+	vector<double>   open_latency;
+	vector<double>   save_latency;
+};
+
+struct bench_state {
+	bench_options     options;
+
+	mutex             stats_mutex;
+	map<string, save_stats> saves;
+	int               fragments = 0;
+	int               save_count = 0;
+};
+
+/* ------------------------------------------------------------------------ */
+/* synthetic encoders, only used for their settings and headers             */
+
+const uint8_t video_header[] = {
+	0x01, 0x42, 0xc0, 0x1f, 0xff, 0xe0, 0x00, 0x01, 0x00
+};
+
+const uint8_t audio_header[] = {
+	0x11, 0x90
+};
+
+const char *bench_encoder_name(void *)
+{
+	return "recordingbuffer bench encoder";
+}
+
+void *bench_encoder_create(obs_data_t *, obs_encoder_t *encoder)
+{
+	return encoder;
+}
+
+void bench_encoder_destroy(void *)
+{
+}
+
+bool bench_encoder_encode(void *, encoder_frame *, encoder_packet *,
+		bool *received_packet)
+{
+	*received_packet = false;
+	return true;
+}
+
+size_t bench_audio_frame_size(void *)
+{
+	return 1024;
+}
+
+bool bench_video_extra_data(void *, uint8_t **extra_data, size_t *size)
+{
+	*extra_data = const_cast<uint8_t*>(video_header);
+	*size = sizeof(video_header);
+	return true;
+}
+
+bool bench_audio_extra_data(void *, uint8_t **extra_data, size_t *size)
+{
+	*extra_data = const_cast<uint8_t*>(audio_header);
+	*size = sizeof(audio_header);
+	return true;
+}
+
+void register_bench_encoders()
+{
+	obs_encoder_info video{};
+	video.id             = "recordingbuffer_bench_video";
+	video.type           = OBS_ENCODER_VIDEO;
+	video.codec          = "h264";
+	video.get_name       = bench_encoder_name;
+	video.create         = bench_encoder_create;
+	video.destroy        = bench_encoder_destroy;
+	video.encode         = bench_encoder_encode;
+	video.get_extra_data = bench_video_extra_data;
+	obs_register_encoder(&video);
+
+	obs_encoder_info audio{};
+	audio.id             = "recordingbuffer_bench_audio";
+	audio.type           = OBS_ENCODER_AUDIO;
+	audio.codec          = "AAC";
+	audio.get_name       = bench_encoder_name;
+	audio.create         = bench_encoder_create;
+	audio.destroy        = bench_encoder_destroy;
+	audio.encode         = bench_encoder_encode;
+	audio.get_frame_size = bench_audio_frame_size;
+	audio.get_extra_data = bench_audio_extra_data;
+	obs_register_encoder(&audio);
+}
+
+/* ------------------------------------------------------------------------ */
+/* host output                                                              */
+
+const char *bench_output_name(void *)
+{
+	return "recordingbuffer bench host";
+}
+
+void *bench_output_create(obs_data_t *, obs_output_t *output)
+{
+	return output;
+}
+
+void bench_output_destroy(void *)
+{
+}
+
+bool bench_output_start(void *)
+{
+	return false;
+}
+
+void bench_output_stop(void *)
+{
+}
+
+void bench_output_packet(void *, encoder_packet *)
+{
+}
+
+void register_bench_output()
+{
+	obs_output_info info{};
+	info.id             = "recordingbuffer_bench_host";
+	info.flags          = OBS_OUTPUT_AV |
+	                      OBS_OUTPUT_ENCODED |
+	                      OBS_OUTPUT_MULTI_TRACK;
+	info.get_name       = bench_output_name;
+	info.create         = bench_output_create;
+	info.destroy        = bench_output_destroy;
+	info.start          = bench_output_start;
+	info.stop           = bench_output_stop;
+	info.encoded_packet = bench_output_packet;
+	obs_register_output(&info);
+}
+
+/* ------------------------------------------------------------------------ */
+/* results                                                                  */
+
+uint64_t peak_rss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+				sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+template <typename T>
+T percentile(vector<T> &values, double p)
+{
+	if (values.empty())
+		return T();
+
+	auto idx = static_cast<size_t>(p * (values.size() - 1) + .5);
+	nth_element(begin(values), begin(values) + idx, end(values));
+	return values[idx];
+}
+
+void print_ingest(const char *name, vector<uint64_t> &costs)
+{
+	if (costs.empty())
+		return;
+
+	printf("  %-10s %8d packets, p50 %7.2f us, p90 %7.2f us, "
+			"p99 %7.2f us, p99.9 %7.2f us, max %9.2f us\n",
+			name, static_cast<int>(costs.size()),
+			percentile(costs, .5) / 1000.,
+			percentile(costs, .9) / 1000.,
+			percentile(costs, .99) / 1000.,
+			percentile(costs, .999) / 1000.,
+			*max_element(begin(costs), end(costs)) / 1000.);
+}
+
+void print_saves(bench_state &state)
+{
+	LOCK(state.stats_mutex);
+
+	for (auto &kind : state.saves) {
+		auto &stats = kind.second;
+		printf("  %-14s %4d requested, %4d finished, %4d failed",
+				kind.first.c_str(), stats.requested,
+				stats.finished, stats.failed);
+
+		if (!stats.save_latency.empty())
+			printf(", open p50 %.3f s, save p50 %.3f s, "
+					"p99 %.3f s, max %.3f s",
+					percentile(stats.open_latency, .5),
+					percentile(stats.save_latency, .5),
+					percentile(stats.save_latency, .99),
+					*max_element(begin(stats.save_latency),
+						end(stats.save_latency)));
+		printf("\n");
+	}
+
+	if (state.fragments)
+		printf("  %d progressive fragments\n", state.fragments);
+}
+
+/* ------------------------------------------------------------------------ */
+/* saves                                                                    */
+
+string save_kind(const char *filename)
+{
+	auto name = strrchr(filename, '/');
+	name = name ? name + 1 : filename;
+
+	auto dash = strrchr(name, '-');
+	return dash ? string(name, dash) : string(name);
+}
+
+void save_finished(void *param, calldata_t *calldata)
+{
+	auto state = static_cast<bench_state*>(param);
+	auto filename = calldata_string(calldata, "filename");
+
+	{
+		LOCK(state->stats_mutex);
+		auto &stats = state->saves[save_kind(filename)];
+		stats.finished += 1;
+		stats.open_latency.push_back(
+				calldata_float(calldata, "open_latency"));
+		stats.save_latency.push_back(
+				calldata_float(calldata, "save_latency"));
+	}
+
+	if (!state->options.keep_files)
+		os_unlink(filename);
+}
+
+void save_failed(void *param, calldata_t *calldata)
+{
+	auto state = static_cast<bench_state*>(param);
+
+	LOCK(state->stats_mutex);
+	state->saves[save_kind(calldata_string(calldata, "filename"))]
+		.failed += 1;
+}
+
+void fragment_written(void *param, calldata_t *)
+{
+	auto state = static_cast<bench_state*>(param);
+
+	LOCK(state->stats_mutex);
+	state->fragments += 1;
+}
+
+struct pending_interrupt {
+	double   time;
+	int64_t  buffer_id;
+};
+
+/* fires the save kind if its interval elapsed, returns the tracked frame
+ * id that has to be attached to the next video packet */
+video_tracked_frame_id request_save(bench_state &state, proc_handler_t *proc,
+		const char *kind, double duration,
+		vector<pending_interrupt> &interrupts, double now)
+{
+	auto &options = state.options;
+
+	DStr filename;
+	{
+		LOCK(state.stats_mutex);
+		dstr_printf(filename, "%s/%s-%d.%s", options.output_dir, kind,
+				state.save_count++, options.extension);
+		state.saves[kind].requested += 1;
+	}
+
+	calldata_t data{};
+	calldata_init(&data);
+	calldata_set_string(&data, "filename", filename);
+	calldata_set_bool(&data, "progressive", options.progressive);
+
+	if (strcmp(kind, "precise") == 0) {
+		calldata_set_float(&data, "save_duration", duration);
+		proc_handler_call(proc, "output_precise_buffer", &data);
+
+	} else if (strcmp(kind, "keep") == 0) {
+		calldata_set_float(&data, "extra_recording_duration", duration);
+		proc_handler_call(proc,
+				"output_precise_buffer_and_keep_recording",
+				&data);
+
+	} else {
+		calldata_set_float(&data, "maximum_recording_duration",
+				duration * 2.);
+		proc_handler_call(proc, "output_interruptible_future_buffer",
+				&data);
+		interrupts.push_back({now + duration,
+				calldata_int(&data, "buffer_id")});
+	}
+
+	auto id = static_cast<video_tracked_frame_id>(
+			calldata_int(&data, "tracked_frame_id"));
+	calldata_free(&data);
+	return id;
+}
+
+/* ------------------------------------------------------------------------ */
+
+void usage()
+{
+	printf("usage: recordingbuffer-bench [options]\n"
+		"  --video-bitrate <kbps>       (6000)\n"
+		"  --audio-bitrate <kbps>       (160)\n"
+		"  --audio-tracks <count>       (1)\n"
+		"  --fps <fps>                  (60)\n"
+		"  --gop <seconds>              (2)\n"
+		"  --duration <seconds>         stream length (300)\n"
+		"  --realtime                   feed packets in real time\n"
+		"  --buffer-length <seconds>    (60)\n"
+		"  --writer-threads <count>     (2)\n"
+		"  --disk-buffer <dir> <MB>\n"
+		"  --premux\n"
+		"  --memory-budget <MB>\n"
+		"  --precise <interval> <save duration>       (20 30)\n"
+		"  --keep <interval> <extra duration>         (45 10)\n"
+		"  --interruptible <interval> <interrupt after> (60 15)\n"
+		"      an interval of 0 disables that kind of save\n"
+		"  --progressive\n"
+		"  --output-dir <dir>           (.)\n"
+		"  --extension <ext>            (mp4)\n"
+		"  --keep-files\n"
+		"  --graphics-module <module>   required for saves, an empty\n"
+		"                               name only measures ingestion\n");
+}
+
+bool parse_options(int argc, char *argv[], bench_options &options)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		int left = argc - i - 1;
+
+#define OPTION(name, count) (strcmp(arg, name) == 0 && left >= count)
+		if (OPTION("--video-bitrate", 1))
+			options.video_bitrate = atoi(argv[++i]);
+		else if (OPTION("--audio-bitrate", 1))
+			options.audio_bitrate = atoi(argv[++i]);
+		else if (OPTION("--audio-tracks", 1))
+			options.audio_tracks = atoi(argv[++i]);
+		else if (OPTION("--fps", 1))
+			options.fps = atoi(argv[++i]);
+		else if (OPTION("--gop", 1))
+			options.gop = atof(argv[++i]);
+		else if (OPTION("--duration", 1))
+			options.duration = atof(argv[++i]);
+		else if (OPTION("--realtime", 0))
+			options.realtime = true;
+		else if (OPTION("--buffer-length", 1))
+			options.buffer_length = atof(argv[++i]);
+		else if (OPTION("--writer-threads", 1))
+			options.writer_threads = atoi(argv[++i]);
+		else if (OPTION("--disk-buffer", 2)) {
+			options.disk_buffer_path = argv[++i];
+			options.disk_buffer_size = atoi(argv[++i]);
+		} else if (OPTION("--premux", 0))
+			options.premux = true;
+		else if (OPTION("--memory-budget", 1))
+			options.memory_budget = atoi(argv[++i]);
+		else if (OPTION("--precise", 2)) {
+			options.precise_interval = atof(argv[++i]);
+			options.precise_duration = atof(argv[++i]);
+		} else if (OPTION("--keep", 2)) {
+			options.keep_interval = atof(argv[++i]);
+			options.keep_duration = atof(argv[++i]);
+		} else if (OPTION("--interruptible", 2)) {
+			options.interruptible_interval = atof(argv[++i]);
+			options.interrupt_after = atof(argv[++i]);
+		} else if (OPTION("--progressive", 0))
+			options.progressive = true;
+		else if (OPTION("--output-dir", 1))
+			options.output_dir = argv[++i];
+		else if (OPTION("--extension", 1))
+			options.extension = argv[++i];
+		else if (OPTION("--keep-files", 0))
+			options.keep_files = true;
+		else if (OPTION("--graphics-module", 1))
+			options.graphics_module = argv[++i];
+		else
+			return false;
+#undef OPTION
+	}
+
+	return options.fps > 0 && options.gop > 0. &&
+		options.audio_tracks >= 0 && options.audio_tracks <= 6 &&
+		options.duration > 0.;
+}
+
+obs_data_t *create_output_settings(const bench_options &options)
+{
+	obs_data_t *settings = obs_data_create();
+	ffmpeg_mux_defaults(settings);
+
+	obs_data_set_double(settings, settings_buffer_length_name,
+			options.buffer_length);
+	obs_data_set_bool(settings, settings_in_process_muxing_name, true);
+	obs_data_set_int(settings, settings_writer_threads_name,
+			options.writer_threads);
+	obs_data_set_string(settings, settings_disk_buffer_path_name,
+			options.disk_buffer_path);
+	obs_data_set_int(settings, settings_disk_buffer_size_name,
+			options.disk_buffer_size);
+	obs_data_set_bool(settings, settings_premux_segments_name,
+			options.premux);
+	obs_data_set_int(settings, settings_memory_budget_name,
+			options.memory_budget);
+	return settings;
+}
+
+void run(bench_state &state, ffmpeg_muxer *stream, bool saves)
+{
+	auto &options = state.options;
+	auto proc = obs_output_get_proc_handler(stream->output);
+
+	/* keyframes are bigger than the other frames, but the bitrate is
+	 * the same over a whole GOP */
+	auto gop_frames = max(1, static_cast<int>(options.gop * options.fps));
+	auto frame_bytes = options.video_bitrate * 1000 / 8 / options.fps;
+	auto keyframe_bytes = gop_frames > 1 ? frame_bytes * 4 : frame_bytes;
+	auto delta_bytes = gop_frames > 1 ?
+		max(1, (frame_bytes * gop_frames - keyframe_bytes) /
+				(gop_frames - 1)) : frame_bytes;
+
+	const int audio_frames = 1024;
+	const int sample_rate = 48000;
+	auto audio_bytes = max(1, options.audio_bitrate * 1000 / 8 *
+			audio_frames / sample_rate);
+
+	vector<uint8_t> payload(max(keyframe_bytes, audio_bytes));
+	for (size_t i = 0; i < payload.size(); i++)
+		payload[i] = static_cast<uint8_t>(i * 31);
+
+	vector<uint64_t> video_costs, keyframe_costs, audio_costs;
+
+	/* saves stop early enough for the last ones to finish */
+	auto last_save = options.duration - max(options.keep_duration,
+			options.interrupt_after) - options.gop * 2;
+
+	double next_precise = options.precise_interval;
+	double next_keep = options.keep_interval;
+	double next_interruptible = options.interruptible_interval;
+	vector<pending_interrupt> interrupts;
+	video_tracked_frame_id next_tracked_id = 0;
+
+	int64_t frame = 0;
+	int64_t audio_packet = 0;
+	auto start_ns = os_gettime_ns();
+
+	for (;;) {
+		double video_time = static_cast<double>(frame) / options.fps;
+		double audio_time = static_cast<double>(audio_packet) *
+			audio_frames / sample_rate;
+		bool video = !options.audio_tracks || video_time <= audio_time;
+		double now = video ? video_time : audio_time;
+
+		if (now >= options.duration)
+			break;
+
+		if (options.realtime)
+			os_sleepto_ns(start_ns + static_cast<uint64_t>(
+						now * 1000000000.));
+
+		if (saves && now < last_save) {
+			auto fire = [&](double &next, double interval,
+					const char *kind, double duration)
+			{
+				if (interval <= 0. || now < next)
+					return;
+
+				next += interval;
+				auto id = request_save(state, proc, kind,
+						duration, interrupts, now);
+				if (id)
+					next_tracked_id = id;
+			};
+
+			fire(next_precise, options.precise_interval,
+					"precise", options.precise_duration);
+			fire(next_keep, options.keep_interval,
+					"keep", options.keep_duration);
+			fire(next_interruptible,
+					options.interruptible_interval,
+					"interruptible", options.interrupt_after);
+		}
+
+		for (size_t i = 0; i < interrupts.size();) {
+			if (interrupts[i].time > now) {
+				i++;
+				continue;
+			}
+
+			calldata_t data{};
+			calldata_init(&data);
+			calldata_set_int(&data, "buffer_id",
+					interrupts[i].buffer_id);
+			proc_handler_call(proc, "interrupt_buffer", &data);
+			calldata_free(&data);
+
+			interrupts.erase(begin(interrupts) + i);
+		}
+
+		encoder_packet packet{};
+		encoder_packet src{};
+		src.data = payload.data();
+
+		if (video) {
+			src.type         = OBS_ENCODER_VIDEO;
+			src.keyframe     = frame % gop_frames == 0;
+			src.size         = src.keyframe ? keyframe_bytes :
+				delta_bytes;
+			src.pts          = frame;
+			src.dts          = frame;
+			src.timebase_num = 1;
+			src.timebase_den = options.fps;
+			src.tracked_id   = next_tracked_id;
+			next_tracked_id  = 0;
+			frame++;
+		} else {
+			src.type         = OBS_ENCODER_AUDIO;
+			src.size         = audio_bytes;
+			src.pts          = audio_packet * audio_frames;
+			src.dts          = src.pts;
+			src.timebase_num = 1;
+			src.timebase_den = sample_rate;
+		}
+
+		src.dts_usec = static_cast<int64_t>(now * 1000000.);
+
+		size_t tracks = video ? 1 : options.audio_tracks;
+		for (size_t track = 0; track < tracks; track++) {
+			src.track_idx = track;
+
+			/* libobs hands refcounted packets to outputs, the cost
+			 * of creating them isn't part of the measurement */
+			obs_encoder_packet_create_instance(&packet, &src);
+
+			auto before = os_gettime_ns();
+			ffmpeg_mux_data(stream, &packet);
+			auto cost = os_gettime_ns() - before;
+
+			obs_encoder_packet_release(&packet);
+
+			if (!video)
+				audio_costs.push_back(cost);
+			else if (src.keyframe)
+				keyframe_costs.push_back(cost);
+			else
+				video_costs.push_back(cost);
+		}
+
+		if (!video)
+			audio_packet++;
+	}
+
+	auto elapsed = (os_gettime_ns() - start_ns) / 1000000000.;
+	printf("fed %.1f s of packets in %.2f s\n", options.duration,
+			elapsed);
+
+	printf("ingest cost (ffmpeg_mux_data):\n");
+	print_ingest("video", video_costs);
+	print_ingest("keyframe", keyframe_costs);
+	print_ingest("audio", audio_costs);
+
+	calldata_t data{};
+	calldata_init(&data);
+	proc_handler_call(proc, "get_buffer_stats", &data);
+	printf("buffer: %lld segments, %.1f MB in memory, %.1f MB pooled "
+			"(all outputs), %lld segments evicted\n",
+			calldata_int(&data, "segment_count"),
+			calldata_int(&data, "memory_bytes") / 1048576.,
+			calldata_int(&data, "process_pooled_bytes") / 1048576.,
+			calldata_int(&data, "evicted_segments"));
+	calldata_free(&data);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	bench_state state;
+	auto &options = state.options;
+
+	if (!parse_options(argc, argv, options)) {
+		usage();
+		return 1;
+	}
+
+	if (!obs_startup("en-US", nullptr, nullptr)) {
+		fprintf(stderr, "Couldn't start libobs\n");
+		return 1;
+	}
+
+	/* clip parameters come from the video and audio output, which needs
+	 * a graphics module; without one only packet ingestion is measured */
+	bool saves = false;
+	if (options.graphics_module && *options.graphics_module) {
+		obs_video_info ovi{};
+		ovi.graphics_module = options.graphics_module;
+		ovi.fps_num         = options.fps;
+		ovi.fps_den         = 1;
+		ovi.base_width      = options.width;
+		ovi.base_height     = options.height;
+
+		saves = obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+		if (!saves)
+			fprintf(stderr, "Couldn't initialize video with '%s', "
+					"only measuring packet ingestion\n",
+					options.graphics_module);
+	}
+
+	obs_audio_info oai{};
+	oai.samples_per_sec = 48000;
+	oai.speakers        = SPEAKERS_STEREO;
+	obs_reset_audio(&oai);
+
+	register_bench_encoders();
+	register_bench_output();
+
+	obs_data_t *settings = create_output_settings(options);
+	obs_output_t *output = obs_output_create("recordingbuffer_bench_host",
+			"recordingbuffer bench", settings, nullptr);
+
+	obs_data_t *video_settings = obs_data_create();
+	obs_data_set_int(video_settings, "bitrate", options.video_bitrate);
+	obs_encoder_t *vencoder = obs_video_encoder_create(
+			"recordingbuffer_bench_video", "bench video",
+			video_settings, nullptr);
+	obs_data_release(video_settings);
+
+	video_scale_info conversion{};
+	conversion.format = VIDEO_FORMAT_NV12;
+	conversion.width  = options.width;
+	conversion.height = options.height;
+	obs_encoder_set_video_conversion(vencoder, &conversion);
+	obs_encoder_set_video(vencoder, obs_get_video());
+	obs_output_set_video_encoder(output, vencoder);
+
+	vector<obs_encoder_t*> aencoders;
+	for (int i = 0; i < options.audio_tracks; i++) {
+		obs_data_t *audio_settings = obs_data_create();
+		obs_data_set_int(audio_settings, "bitrate",
+				options.audio_bitrate);
+
+		DStr name;
+		dstr_printf(name, "Track%d", i + 1);
+		obs_encoder_t *aencoder = obs_audio_encoder_create(
+				"recordingbuffer_bench_audio", name,
+				audio_settings, i, nullptr);
+		obs_data_release(audio_settings);
+
+		obs_encoder_set_audio(aencoder, obs_get_audio());
+		obs_output_set_audio_encoder(output, aencoder, i);
+		aencoders.push_back(aencoder);
+	}
+
+	if (saves && !obs_output_initialize_encoders(output, 0)) {
+		fprintf(stderr, "Couldn't initialize the bench encoders, "
+				"only measuring packet ingestion\n");
+		saves = false;
+	}
+
+	auto stream = static_cast<ffmpeg_muxer*>(
+			ffmpeg_mux_create(settings, output));
+
+	auto signal = obs_output_get_signal_handler(output);
+	signal_handler_connect(signal, "buffer_output_finished",
+			save_finished, &state);
+	signal_handler_connect(signal, "buffer_output_failed",
+			save_failed, &state);
+	signal_handler_connect(signal, "buffer_output_fragment",
+			fragment_written, &state);
+
+	/* the encoders never produce anything, packets are fed directly */
+	stream->active = true;
+
+	run(state, stream, saves);
+
+	/* cancels whatever is still waiting for packets and waits for the
+	 * writer threads to finish */
+	ffmpeg_mux_stop(stream);
+	ffmpeg_mux_destroy(stream);
+
+	printf("saves:\n");
+	print_saves(state);
+	printf("peak RSS: %.1f MB\n", peak_rss() / 1048576.);
+
+	signal_handler_disconnect(signal, "buffer_output_finished",
+			save_finished, &state);
+	signal_handler_disconnect(signal, "buffer_output_failed",
+			save_failed, &state);
+	signal_handler_disconnect(signal, "buffer_output_fragment",
+			fragment_written, &state);
+
+	for (auto aencoder : aencoders)
+		obs_encoder_release(aencoder);
+	obs_encoder_release(vencoder);
+	obs_output_release(output);
+	obs_data_release(settings);
+
+	obs_shutdown();
+	return 0;
+}
@@ -0,0 +1,277 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Renders a scene in which an opaque item completely covers one item and
+ * partly covers another, and a source that is currently not opaque and a
+ * disabled source cover two more, then checks that the scene skipped
+ * exactly the item beneath the opaque one.
+ *
+ * usage: scene-culling-test [graphics module] */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <graphics/vec2.h>
+#include <graphics/vec4.h>
+#include <obs.h>
+
+#define CANVAS_CX 1280
+#define CANVAS_CY 720
+#define FRAMES    5
+
+/* items from the bottom to the top of the scene */
+enum test_item {
+	ITEM_HIDDEN,
+	ITEM_PARTLY,
+	ITEM_BEHIND_TRANSLUCENT,
+	ITEM_BEHIND_DISABLED,
+	ITEM_COVER,
+	ITEM_TRANSLUCENT,
+	ITEM_DISABLED,
+	ITEM_COUNT
+};
+
+struct test_source {
+	uint32_t      cx;
+	uint32_t      cy;
+	bool          opaque;
+	volatile long renders;
+};
+
+static struct test_source *test_sources[ITEM_COUNT];
+
+static const char *test_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "culling test source";
+}
+
+static void *test_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct test_source *ts = bzalloc(sizeof(struct test_source));
+	ts->cx     = (uint32_t)obs_data_get_int(settings, "cx");
+	ts->cy     = (uint32_t)obs_data_get_int(settings, "cy");
+	ts->opaque = obs_data_get_bool(settings, "opaque");
+
+	test_sources[obs_data_get_int(settings, "item")] = ts;
+
+	UNUSED_PARAMETER(source);
+	return ts;
+}
+
+static void test_source_destroy(void *data)
+{
+	bfree(data);
+}
+
+static void test_source_render(void *data, gs_effect_t *effect)
+{
+	struct test_source *ts = data;
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+	struct vec4 value;
+
+	vec4_set(&value, 1.0f, 1.0f, 1.0f, ts->opaque ? 1.0f : 0.5f);
+	gs_effect_set_vec4(color, &value);
+
+	while (gs_effect_loop(solid, "Solid"))
+		gs_draw_sprite(NULL, 0, ts->cx, ts->cy);
+
+	os_atomic_inc_long(&ts->renders);
+
+	UNUSED_PARAMETER(effect);
+}
+
+static uint32_t test_source_width(void *data)
+{
+	struct test_source *ts = data;
+	return ts->cx;
+}
+
+static uint32_t test_source_height(void *data)
+{
+	struct test_source *ts = data;
+	return ts->cy;
+}
+
+static bool test_source_is_opaque(void *data)
+{
+	struct test_source *ts = data;
+	return ts->opaque;
+}
+
+static struct obs_source_info test_source_info = {
+	.id           = "culling_test_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                OBS_SOURCE_OPAQUE,
+	.get_name     = test_source_name,
+	.create       = test_source_create,
+	.destroy      = test_source_destroy,
+	.video_render = test_source_render,
+	.get_width    = test_source_width,
+	.get_height   = test_source_height,
+	.is_opaque    = test_source_is_opaque
+};
+
+static obs_source_t *add_item(obs_scene_t *scene, enum test_item item,
+		const char *name, float x, float y, uint32_t size, bool opaque)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *source;
+	struct vec2 pos;
+
+	obs_data_set_int(settings, "item", item);
+	obs_data_set_int(settings, "cx", size);
+	obs_data_set_int(settings, "cy", size);
+	obs_data_set_bool(settings, "opaque", opaque);
+
+	source = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+			"culling_test_source", name, settings, NULL);
+	obs_data_release(settings);
+
+	vec2_set(&pos, x, y);
+	obs_sceneitem_set_pos(obs_scene_add(scene, source), &pos);
+	return source;
+}
+
+static long get_renders(enum test_item item)
+{
+	return os_atomic_load_long(&test_sources[item]->renders);
+}
+
+/* draws the scene the way the main view does, onto a canvas sized target */
+static bool render_scene(obs_scene_t *scene)
+{
+	gs_texrender_t *texrender;
+	bool success = true;
+
+	obs_enter_graphics();
+
+	texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	for (int i = 0; i < FRAMES && success; i++) {
+		struct vec4 clear_color;
+
+		gs_texrender_reset(texrender);
+		if (!gs_texrender_begin(texrender, CANVAS_CX, CANVAS_CY)) {
+			success = false;
+			break;
+		}
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
+		gs_ortho(0.0f, (float)CANVAS_CX, 0.0f, (float)CANVAS_CY,
+				-100.0f, 100.0f);
+
+		obs_source_video_render(obs_scene_get_source(scene));
+
+		gs_texrender_end(texrender);
+	}
+
+	gs_texrender_destroy(texrender);
+
+	obs_leave_graphics();
+	return success;
+}
+
+static int check(const char *what, bool result)
+{
+	printf("%-44s %s\n", what, result ? "ok" : "FAILED");
+	return result ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct obs_video_info ovi = {0};
+	obs_source_t *sources[ITEM_COUNT];
+	obs_scene_t *scene;
+	uint32_t occluded = 0, off_canvas = 0;
+	int failures = 0;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't start libobs\n");
+		return 1;
+	}
+
+	ovi.graphics_module = argc > 1 ? argv[1] : DL_OPENGL;
+	ovi.fps_num         = 30;
+	ovi.fps_den         = 1;
+	ovi.base_width      = CANVAS_CX;
+	ovi.base_height     = CANVAS_CY;
+
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Couldn't initialize video with '%s'\n",
+				ovi.graphics_module);
+		obs_shutdown();
+		return 1;
+	}
+
+	obs_register_source(&test_source_info);
+
+	scene = obs_scene_create("culling test scene");
+	sources[ITEM_HIDDEN] = add_item(scene, ITEM_HIDDEN, "hidden",
+			50.0f, 50.0f, 100, true);
+	sources[ITEM_PARTLY] = add_item(scene, ITEM_PARTLY, "partly",
+			150.0f, 150.0f, 100, true);
+	sources[ITEM_BEHIND_TRANSLUCENT] = add_item(scene,
+			ITEM_BEHIND_TRANSLUCENT, "behind translucent",
+			550.0f, 50.0f, 100, true);
+	sources[ITEM_BEHIND_DISABLED] = add_item(scene,
+			ITEM_BEHIND_DISABLED, "behind disabled",
+			950.0f, 50.0f, 100, true);
+	sources[ITEM_COVER] = add_item(scene, ITEM_COVER, "cover",
+			0.0f, 0.0f, 200, true);
+	sources[ITEM_TRANSLUCENT] = add_item(scene, ITEM_TRANSLUCENT,
+			"translucent", 500.0f, 0.0f, 200, false);
+	sources[ITEM_DISABLED] = add_item(scene, ITEM_DISABLED, "disabled",
+			900.0f, 0.0f, 200, true);
+	obs_source_set_enabled(sources[ITEM_DISABLED], false);
+
+	if (!render_scene(scene)) {
+		fprintf(stderr, "Couldn't render the scene\n");
+		failures++;
+	}
+
+	obs_scene_get_culled_items(scene, &occluded, &off_canvas);
+
+	failures += check("covered item isn't rendered",
+			get_renders(ITEM_HIDDEN) == 0);
+	failures += check("partly covered item is rendered",
+			get_renders(ITEM_PARTLY) == FRAMES);
+	failures += check("item beneath a translucent source is rendered",
+			get_renders(ITEM_BEHIND_TRANSLUCENT) == FRAMES);
+	failures += check("item beneath a disabled source is rendered",
+			get_renders(ITEM_BEHIND_DISABLED) == FRAMES);
+	failures += check("disabled source isn't rendered",
+			get_renders(ITEM_DISABLED) == 0);
+	failures += check("covering items are rendered",
+			get_renders(ITEM_COVER) == FRAMES &&
+			get_renders(ITEM_TRANSLUCENT) == FRAMES);
+	failures += check("one item reported as occluded",
+			occluded == 1 && off_canvas == 0);
+
+	for (size_t i = 0; i < ITEM_COUNT; i++)
+		obs_source_release(sources[i]);
+	obs_scene_release(scene);
+	obs_shutdown();
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}